@@ -92,6 +92,16 @@
 #include "ds/ColorPassDescriptorSet.h"
 #include "ds/TypedUniformBuffer.h"
 #include "vulkan/utils/Spirv.h"
+#include "PipelineStateCache.hpp"
+#include <utils/Hash.h>
+#include <utils/Invocable.h>
+#include <array>
+#include <bit>
+#include <cstdio>
+#include <type_traits>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
 #include <filameshio/MeshReader.h>
 #include <fcntl.h>
 #if !defined(WIN32)
@@ -185,6 +195,65 @@ void main(in  PSInput  PSIn,
  extern filament::math::mat4f g_LightMat;
 
  extern utils::Entity g_FilamentSun;
+
+ // Programs handed over by the engine's render thread. They're created on the main thread, which
+ // owns the GL context and the pipeline state used by Render(). Destructions and compilePrograms()
+ // go through the same queue, so that they're processed in command order (the handle ids are
+ // reused, and the programs before a compilePrograms() must exist when it calls back).
+ struct PendingProgram
+ {
+	 filament::backend::HandleBase::HandleId Id;
+	 std::optional<filament::backend::Program> Program;	// empty when the program is destroyed
+	 utils::Invocable<void()> Ready;						// set for compilePrograms()
+ };
+ static std::mutex g_PendingProgramsLock;
+ static std::vector<PendingProgram> g_PendingPrograms;
+
+ // Backend objects of the engine's vertex buffer infos and descriptor set layouts, indexed by the
+ // id of their handle. The engine deduplicates them, so each entry is a distinct layout. They're
+ // written by the engine's render thread, the main thread only reads them after flushAndWait().
+ template <typename T>
+ class BackendObjectTable
+ {
+ public:
+	 void Set(filament::backend::HandleBase::HandleId Id, T&& Object)
+	 {
+		 if (Id >= m_Objects.size()) {
+			 m_Objects.resize(Id + 1);
+		 }
+		 m_Objects[Id] = std::move(Object);
+	 }
+
+	 void Remove(filament::backend::HandleBase::HandleId Id)
+	 {
+		 m_Objects[Id] = {};
+	 }
+
+	 const T& Get(filament::backend::HandleBase::HandleId Id) const { return m_Objects[Id]; }
+
+ private:
+	 std::vector<T> m_Objects;
+ };
+
+ static BackendObjectTable<InputLayout> g_InputLayouts;
+ static BackendObjectTable<ResourceSignatureLayout> g_ResourceSignatureLayouts;
+ // layout of each descriptor set, only accessed by the render thread
+ static BackendObjectTable<filament::backend::HandleBase::HandleId> g_DescriptorSetLayouts;
+
+ // Buffer and descriptor set commands handed over by the engine's render thread. Like the programs,
+ // they're applied on the main thread, which owns the immediate context, in command order (see
+ // ApplyPendingCommands()).
+ class Tutorial00App;
+ using PendingCommand = utils::Invocable<void(Tutorial00App&)>;
+ static std::mutex g_PendingCommandsLock;
+ static std::vector<PendingCommand> g_PendingCommands;
+
+ static void PushPendingCommand(PendingCommand&& Command)
+ {
+	 std::lock_guard<std::mutex> Lock(g_PendingCommandsLock);
+	 g_PendingCommands.push_back(std::move(Command));
+ }
+
  namespace filament {
 	 extern FScene g_scene;
 	 CameraInfo computeCameraInfo(FEngine& engine);
@@ -203,10 +272,23 @@ void main(in  PSInput  PSIn,
 		 mUserEpoch(std::chrono::steady_clock::now())
      {
 		 g_mColorPassDescriptorSet = &mColorPassDescriptorSet;
+		 // dumping the generated shaders is opt-in
+		 m_ShaderDumpDir = getenv("FILAMENT_SHADER_DUMP_DIR");
+		 // FILAMENT_SPIRV_STRIP=0 turns the stripping off, to measure against
+		 if (const char* strip = getenv("FILAMENT_SPIRV_STRIP")) {
+			 m_StripSpirvDeadCode = strcmp(strip, "0") != 0;
+		 }
      }
  
      ~Tutorial00App()
      {
+         // the numbers to compare with and without FILAMENT_SPIRV_STRIP=0
+         std::cout << "SPIR-V: " << m_SpirvStripStats.modules << " modules stripped, "
+                   << m_SpirvStripStats.bytesIn << " -> " << m_SpirvStripStats.bytesOut << " bytes in "
+                   << m_SpirvStripStats.seconds * 1000.0 << " ms, shaders created in "
+                   << m_ShaderCreateSeconds * 1000.0 << " ms" << std::endl;
+         if (m_VertexBufferInfo)
+             mEngine.getVertexBufferInfoFactory().destroy(mEngine.getDriverApi(), m_VertexBufferInfo);
          m_pImmediateContext->Flush();
      }
  
@@ -298,6 +380,15 @@ void main(in  PSInput  PSIn,
          }
 		 const auto& SCDesc2 = m_pSwapChain->GetDesc();
 		 m_pImGui = ImGuiImplWin32::Create(ImGuiDiligentCreateInfo{ m_pDevice, SCDesc2 }, hWnd);
+		 // serialized pipelines are backend specific
+		 const char* PSOCacheFile = nullptr;
+		 if (m_DeviceType == RENDER_DEVICE_TYPE_D3D12) {
+			 PSOCacheFile = "FilamentPSOCache_D3D12.bin";
+		 }
+		 else if (m_DeviceType == RENDER_DEVICE_TYPE_VULKAN) {
+			 PSOCacheFile = "FilamentPSOCache_VK.bin";
+		 }
+		 m_pPSOCache = std::make_unique<PipelineStateCache>(m_pDevice, PSOCacheFile);
          return true;
      }
  
@@ -589,6 +680,9 @@ void main(in  PSInput  PSIn,
 
 		 m_filament_ready = true;
 		 downcast(mi)->getMaterial()->prepareProgram(variant);
+		 // the program is built by the render thread, CreatePipelineState() needs its shaders
+		 mEngine.flushAndWait();
+		 CreatePendingPrograms();
 
 		 // Add light sources into the scene.
 		 //auto& em = utils::EntityManager::get();
@@ -888,31 +982,215 @@ void main(in  PSInput  PSIn,
 		 return { version, prolog, body };
 	 }
 
-	 static inline std::string to_string(bool b) noexcept { return b ? "true" : "false"; }
-	 static inline std::string to_string(int i) noexcept { return std::to_string(i); }
-	 static inline std::string to_string(float f) noexcept { return "float(" + std::to_string(f) + ")"; }
+	 // SPIR-V specialization patch tables, computed once per shader blob. A blob is identified by
+	 // its program's cache id and its stage.
+	 struct SpecConstantPatchTableKey
+	 {
+		 uint64_t CacheId;
+		 uint32_t Stage;
+		 bool operator==(SpecConstantPatchTableKey const& rhs) const noexcept {
+			 return CacheId == rhs.CacheId && Stage == rhs.Stage;
+		 }
+	 };
+
+	 struct SpecConstantPatchTableKeyHasher
+	 {
+		 size_t operator()(SpecConstantPatchTableKey const& key) const noexcept {
+			 return utils::hash::combine(size_t(key.CacheId), key.Stage);
+		 }
+	 };
+
+	 filament::backend::fvkutils::SpecConstantPatchTable const& getSpecConstantPatchTable(
+		 uint64_t cacheId, uint32_t stage, filament::backend::Program::ShaderBlob const& blob)
+	 {
+		 auto [pos, inserted] = mSpecConstantPatchTables.try_emplace({ cacheId, stage });
+		 if (inserted) {
+			 pos->second = filament::backend::fvkutils::analyzeSpecConstants(blob);
+		 }
+		 // the same cache id must always come with the same shaders
+		 assert_invariant(pos->second.spans.empty() || pos->second.spans.back().end == blob.size() / 4);
+		 return pos->second;
+	 }
+
+	 // The patch tables are dropped with the last live program using them.
+	 void releaseProgram(filament::backend::HandleBase::HandleId id)
+	 {
+		 auto const pos = mProgramCacheIds.find(id);
+		 if (pos == mProgramCacheIds.end()) {
+			 return;
+		 }
+		 uint64_t const cacheId = pos->second;
+		 mProgramCacheIds.erase(pos);
+		 auto const refs = mProgramCacheIdRefs.find(cacheId);
+		 assert_invariant(refs != mProgramCacheIdRefs.end() && refs->second > 0);
+		 if (--refs->second == 0) {
+			 mProgramCacheIdRefs.erase(refs);
+			 for (uint32_t stage = 0; stage < filament::backend::Program::SHADER_TYPE_COUNT; stage++) {
+				 mSpecConstantPatchTables.erase({ cacheId, stage });
+			 }
+		 }
+	 }
+
+	 // Formats "#define SPIRV_CROSS_CONSTANT_ID_<id> <value>\n" into dst (which can be null to
+	 // only measure), returns the number of characters, not counting the null terminator.
+	 static int formatSpecConstant(char* dst, size_t capacity,
+		 filament::backend::Program::SpecializationConstant const& sc) noexcept {
+		 constexpr const char* prefix = "#define SPIRV_CROSS_CONSTANT_ID_";
+		 return std::visit([&](auto const value) -> int {
+			 using T = std::decay_t<decltype(value)>;
+			 if constexpr (std::is_same_v<T, bool>) {
+				 return snprintf(dst, capacity, "%s%u %s\n", prefix, sc.id, value ? "true" : "false");
+			 } else if constexpr (std::is_same_v<T, float>) {
+				 return snprintf(dst, capacity, "%s%u float(%f)\n", prefix, sc.id, value);
+			 } else {
+				 return snprintf(dst, capacity, "%s%u %d\n", prefix, sc.id, int(value));
+			 }
+		 }, sc.value);
+	 }
+
+	 // Writes a generated shader to m_ShaderDumpDir, if set.
+	 void dumpShader(filament::backend::Program const& program, const char* extension,
+		 void const* data, size_t size) const noexcept {
+		 if (!m_ShaderDumpDir) {
+			 return;
+		 }
+		 char path[1024];
+		 snprintf(path, sizeof(path), "%s/%s_%016llx.%s", m_ShaderDumpDir,
+			 program.getName().c_str_safe(), (unsigned long long)program.getCacheId(), extension);
+		 if (FILE* fd = fopen(path, "wb")) {
+			 fwrite(data, 1, size, fd);
+			 fclose(fd);
+		 }
+	 }
+
+	 void CreatePendingPrograms()
+	 {
+		 std::vector<PendingProgram> Programs;
+		 {
+			 std::lock_guard<std::mutex> Lock(g_PendingProgramsLock);
+			 Programs.swap(g_PendingPrograms);
+		 }
+		 for (auto& Pending : Programs) {
+			 if (Pending.Ready) {
+				 Pending.Ready();
+			 } else if (Pending.Program) {
+				 uint64_t const cacheId = Pending.Program->getCacheId();
+				 mProgramCacheIds[Pending.Id] = cacheId;
+				 mProgramCacheIdRefs[cacheId]++;
+				 CreateFilamentProgram(std::move(*Pending.Program));
+			 } else {
+				 releaseProgram(Pending.Id);
+			 }
+		 }
+	 }
+
+	 void ApplyPendingCommands()
+	 {
+		 std::vector<PendingCommand> Commands;
+		 {
+			 std::lock_guard<std::mutex> Lock(g_PendingCommandsLock);
+			 Commands.swap(g_PendingCommands);
+		 }
+		 for (auto& Command : Commands) {
+			 Command(*this);
+		 }
+	 }
+
+	 // Backend objects of the engine's buffer objects, index buffers and descriptor sets, see
+	 // DiligentDriver.h.
+	 void CreateBuffer(filament::backend::HandleBase::HandleId Id, uint32_t ByteCount, BIND_FLAGS BindFlags)
+	 {
+		 BufferDesc Desc;
+		 Desc.Name = "Filament buffer";
+		 Desc.Size = ByteCount;
+		 // written with UpdateBuffer(), which needs the default usage
+		 Desc.Usage = USAGE_DEFAULT;
+		 Desc.BindFlags = BindFlags;
+		 if (BindFlags & BIND_UNORDERED_ACCESS) {
+			 Desc.BindFlags |= BIND_SHADER_RESOURCE;
+			 Desc.Mode = BUFFER_MODE_RAW;
+		 }
+		 RefCntAutoPtr<IBuffer> pBuffer;
+		 m_pDevice->CreateBuffer(Desc, nullptr, &pBuffer);
+		 m_Buffers[Id] = std::move(pBuffer);
+	 }
+
+	 void UpdateBuffer(filament::backend::HandleBase::HandleId Id, const filament::backend::BufferDescriptor& Data,
+					   uint32_t ByteOffset)
+	 {
+		 auto const pos = m_Buffers.find(Id);
+		 if (pos != m_Buffers.end() && pos->second) {
+			 m_pImmediateContext->UpdateBuffer(pos->second, ByteOffset, Data.size, Data.buffer,
+											   RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
+		 }
+	 }
+
+	 void DestroyBuffer(filament::backend::HandleBase::HandleId Id)
+	 {
+		 m_Buffers.erase(Id);
+	 }
+
+	 void CreateDescriptorSet(filament::backend::HandleBase::HandleId Id)
+	 {
+		 m_DescriptorSets[Id] = {};
+	 }
+
+	 void UpdateDescriptorSetBuffer(filament::backend::HandleBase::HandleId Id,
+									filament::backend::descriptor_binding_t Binding,
+									filament::backend::HandleBase::HandleId BufferId, uint32_t Offset, uint32_t Size)
+	 {
+		 m_DescriptorSets[Id][Binding] = { BufferId, Offset, Size };
+	 }
+
+	 void DestroyDescriptorSet(filament::backend::HandleBase::HandleId Id)
+	 {
+		 m_DescriptorSets.erase(Id);
+	 }
+
+	 // Sets the buffers of the descriptor set to the variables of the SRB with the same names in
+	 // the program of the pipeline. DynamicOffsets is indexed by binding.
+	 void BindDescriptorSet(filament::backend::HandleBase::HandleId Id, filament::backend::descriptor_set_t Set,
+							const std::array<uint32_t, filament::backend::MAX_DESCRIPTOR_COUNT>& DynamicOffsets)
+	 {
+		 auto const pos = m_DescriptorSets.find(Id);
+		 if (!m_SRB || pos == m_DescriptorSets.end() || Set >= m_PipelineDescriptors.size()) {
+			 return;
+		 }
+		 for (const filament::backend::Program::Descriptor& Descriptor : m_PipelineDescriptors[Set]) {
+			 const DescriptorSetBuffer& Buffer = pos->second[Descriptor.binding];
+			 auto const buffer = m_Buffers.find(Buffer.Id);
+			 if (buffer == m_Buffers.end() || !buffer->second) {
+				 continue;
+			 }
+			 const Uint64 Offset = Uint64(Buffer.Offset) + DynamicOffsets[Descriptor.binding];
+			 for (const SHADER_TYPE Stage : { SHADER_TYPE_VERTEX, SHADER_TYPE_PIXEL }) {
+				 // static variables aren't in the SRB, and a stage may not use the buffer
+				 if (IShaderResourceVariable* pVar = m_SRB->GetVariableByName(Stage, Descriptor.name.c_str_safe())) {
+					 pVar->SetBufferRange(buffer->second, Offset, Buffer.Size);
+				 }
+			 }
+		 }
+	 }
+
 	 void CreateFilamentProgram(filament::backend::Program&& program)
 	 {
 		 if (!m_filament_ready) {
 			 return;
 		 }
+		 // the program whose shaders are assembled below, CreatePipelineState() compiles them
+		 m_ShaderSourcesProgramId = program.getCacheId();
+		 m_ShaderSourcesDescriptors = program.getDescriptorBindings();
 		 using namespace filament::backend;
 		 if (m_DeviceType == RENDER_DEVICE_TYPE_GL) {
-			 Program::ShaderSource shadersSource = std::move(program.getShadersSource());
+			 Program::ShaderSource& shadersSource = program.getShadersSource();
 			 utils::FixedCapacityVector<Program::SpecializationConstant> const& specializationConstants = program.getSpecializationConstants();
 			 bool multiview = false;
 
-			 auto appendSpecConstantString = +[](std::string& s, Program::SpecializationConstant const& sc) {
-				 s += "#define SPIRV_CROSS_CONSTANT_ID_" + std::to_string(sc.id) + ' ';
-				 s += std::visit([](auto&& arg) { return to_string(arg); }, sc.value);
-				 s += '\n';
-				 return s;
-				 };
-
-			 std::string specializationConstantString;
+			 // the #define block is the same for all stages, measure it once
+			 size_t specializationConstantsSize = 0;
 			 int32_t numViews = 2;
 			 for (auto const& sc : specializationConstants) {
-				 appendSpecConstantString(specializationConstantString, sc);
+				 specializationConstantsSize += formatSpecConstant(nullptr, 0, sc);
 				 if (sc.id == 8) {
 					 // This constant must match
 					 // ReservedSpecializationConstants::CONFIG_STEREO_EYE_COUNT
@@ -921,29 +1199,16 @@ void main(in  PSInput  PSIn,
 					 numViews = std::get<int32_t>(sc.value);
 				 }
 			 }
-			 if (!specializationConstantString.empty()) {
-				 specializationConstantString += '\n';
+			 if (specializationConstantsSize) {
+				 specializationConstantsSize += 1; // empty line after the block
 			 }
 
 			 // build all shaders
 			for (size_t i = 0; i < Program::SHADER_TYPE_COUNT; i++) {
 				const ShaderStage stage = static_cast<ShaderStage>(i);
-	// 				 GLenum glShaderType{};
-	// 				 switch (stage) {
-	// 				 case ShaderStage::VERTEX:
-	// 					 glShaderType = GL_VERTEX_SHADER;
-	// 					 break;
-	// 				 case ShaderStage::FRAGMENT:
-	// 					 glShaderType = GL_FRAGMENT_SHADER;
-	// 					 break;
-	// 				 case ShaderStage::COMPUTE:
-	// #if defined(BACKEND_OPENGL_LEVEL_GLES31)
-	// 					 glShaderType = GL_COMPUTE_SHADER;
-	// #else
-	// 					 continue;
-	// #endif
-	// 					 break;
-	// 				 }
+				if (stage == ShaderStage::COMPUTE) {
+					continue;
+				}
 
 				if (!shadersSource[i].empty()) {
 					Program::ShaderBlob& shader = shadersSource[i];
@@ -964,53 +1229,41 @@ void main(in  PSInput  PSIn,
 					// split shader source, so we can insert the specialization constants and the packing
 					// functions
 					auto [version, prolog, body] = splitShaderSource({ shader_src, shader_len });
+					body = { body.data(), body.size() - 1 };  // null-terminated
 
 					// enable ESSL 3.10 if available
 	// 					 if (context.isAtLeastGLES<3, 1>()) {
 	// 						 version = "#version 310 es\n";
 	// 					 }
 
-					std::array<std::string_view, 5> sources = {
-						version,
-						prolog,
-						specializationConstantString,
-						packingFunctions,
-						{ body.data(), body.size() - 1 }  // null-terminated
+					// Assemble version, prolog, #define block, packing functions and body in a
+					// single pass, into a buffer sized upfront. The destination keeps its capacity
+					// across programs, so in the steady state this doesn't allocate.
+					std::string& outstring = (stage == ShaderStage::VERTEX) ? mVSSource : mPSSource;
+					outstring.resize(version.size() + prolog.size() + specializationConstantsSize +
+						packingFunctions.size() + body.size());
+
+					char* cursor = outstring.data();
+					auto append = [&cursor](std::string_view s) {
+						memcpy(cursor, s.data(), s.size());
+						cursor += s.size();
 					};
-
-					// Some of the sources may be zero-length. Remove them as to avoid passing lengths of
-					// zero to glShaderSource(). glShaderSource should work with lengths of zero, but some
-					// drivers instead interpret zero as a sentinel for a null-terminated string.
-					auto partitionPoint = std::stable_partition(
-						sources.begin(), sources.end(), [](std::string_view s) { return !s.empty(); });
-					size_t count = std::distance(sources.begin(), partitionPoint);
-
-					std::array<const char*, 5> shaderStrings;
-					std::array<int, 5> lengths;
-					for (size_t i = 0; i < count; i++) {
-						shaderStrings[i] = sources[i].data();
-						lengths[i] = sources[i].size();
+					append(version);
+					append(prolog);
+					for (auto const& sc : specializationConstants) {
+						// snprintf also writes a null terminator, which either lands on the next
+						// piece or on the string's own terminator
+						cursor += formatSpecConstant(cursor, outstring.data() + outstring.size() - cursor + 1, sc);
 					}
-					std::string* outstring;
-					FILE* fd = nullptr;
-					//std::ofstream file("D:\\Github\\kfengine-tech\\aiDefaultMat.vert", std::ios::out | std::ios::trunc);
-					if (stage == ShaderStage::VERTEX) {
-						fd = fopen("D:\\Github\\kfengine-tech\\aiDefaultMat.vert", "w+");
-						outstring = &mVSSource;
-					}
-					else if (stage == ShaderStage::FRAGMENT) {
-						fd = fopen("D:\\Github\\kfengine-tech\\aiDefaultMat.frag", "w+");
-						outstring = &mPSSource;
-					}
-					if (fd) {
-						for (auto& it : sources) {
-							if (!it.empty()) {
-								fwrite(it.data(), it.size(), 1, fd);
-								outstring->append(it.data(), it.size());
-							}
-						}
-						fclose(fd);
+					if (specializationConstantsSize) {
+						*cursor++ = '\n';
 					}
+					append(packingFunctions);
+					append(body);
+					assert_invariant(cursor == outstring.data() + outstring.size());
+
+					dumpShader(program, stage == ShaderStage::VERTEX ? "vert" : "frag",
+						outstring.data(), outstring.size());
 				}
 			}
 		} else if (m_DeviceType == RENDER_DEVICE_TYPE_VULKAN) {
@@ -1018,7 +1271,6 @@ void main(in  PSInput  PSIn,
 			 Program::ShaderSource const& blobs = program.getShadersSource();
 			 //auto& modules = mInfo->shaders;
 			 auto const& specializationConstants = program.getSpecializationConstants();
-			 std::vector<uint32_t> shader;
 
 			 static_assert(static_cast<ShaderStage>(0) == ShaderStage::VERTEX &&
 				 static_cast<ShaderStage>(1) == ShaderStage::FRAGMENT &&
@@ -1026,42 +1278,48 @@ void main(in  PSInput  PSIn,
 
 			 for (size_t i = 0; i < MAX_SHADER_MODULES; i++) {
 				 Program::ShaderBlob const& blob = blobs[i];
-
-				 uint32_t* data = (uint32_t*)blob.data();
-				 size_t dataSize = blob.size();
+				 const ShaderStage stage = static_cast<ShaderStage>(i);
+				 std::vector<uint32_t>& outdata = (stage == ShaderStage::VERTEX) ? mVSSourceVK : mPSSourceVK;
 
 				 if (!specializationConstants.empty()) {
-					 fvkutils::workaroundSpecConstant(blob, specializationConstants, shader);
-					 data = (uint32_t*)shader.data();
-					 dataSize = shader.size() * 4;
-				 }
-				 const ShaderStage stage = static_cast<ShaderStage>(i);
-				 std::vector<uint32_t>* outdata;
-				 FILE* fd = nullptr;
-				 if (stage == ShaderStage::VERTEX) {
-					 fd = fopen("D:\\Github\\kfengine-tech\\aiDefaultMat_vk.vert", "wb+");
-					 outdata = &mVSSourceVK;
-				 }
-				 else if (stage == ShaderStage::FRAGMENT) {
-					 fd = fopen("D:\\Github\\kfengine-tech\\aiDefaultMat_vk.frag", "wb+");
-					 outdata = &mPSSourceVK;
+					 // the patch table only depends on the blob, which is identified by the
+					 // program's cache id and the stage
+					 fvkutils::SpecConstantPatchTable const& table = getSpecConstantPatchTable(
+						 program.getCacheId(), uint32_t(i), blob);
+					 // the output keeps its capacity across programs, so this doesn't allocate
+					 // in the steady state
+					 outdata.resize(table.outputSize);
+					 fvkutils::workaroundSpecConstant(blob, table, specializationConstants, outdata.data());
+
+					 // with the constants folded, whole features are now statically dead
+					 if (m_StripSpirvDeadCode) {
+						 auto const start = std::chrono::steady_clock::now();
+						 size_t const sizeBefore = outdata.size() * sizeof(uint32_t);
+						 if (fvkutils::stripDeadCode(outdata)) {
+							 m_SpirvStripStats.bytesIn += sizeBefore;
+							 m_SpirvStripStats.bytesOut += outdata.size() * sizeof(uint32_t);
+							 m_SpirvStripStats.modules++;
+						 }
+						 m_SpirvStripStats.seconds += std::chrono::duration<double>(
+							 std::chrono::steady_clock::now() - start).count();
+					 }
 				 }
-				 if (fd) {
-					 std::span<uint32_t> temp(data, dataSize / 4);
-					 outdata->assign(temp.begin(), temp.end());
-					fwrite(outdata->data(), sizeof(uint32_t), outdata->size(), fd);
-					fclose(fd);
+				 else {
+					 std::span<uint32_t const> temp((uint32_t const*)blob.data(), blob.size() / 4);
+					 outdata.assign(temp.begin(), temp.end());
 				 }
+
+				 dumpShader(program, stage == ShaderStage::VERTEX ? "vert.spv" : "frag.spv",
+					 outdata.data(), outdata.size() * sizeof(uint32_t));
 			 }
 		 }
 	 }
 
-	 void CreatePipelineState()
+	 // Everything referenced by the create info must outlive an asynchronous creation, hence the
+	 // static storage.
+	 static void FillPipelineStateCreateInfo(GraphicsPipelineStateCreateInfo& PSOCreateInfo, const PipelineStateKey& Key,
+											 const InputLayout& Layout)
 	 {
-		 // Pipeline state object encompasses configuration of all GPU stages
-
-		 GraphicsPipelineStateCreateInfo PSOCreateInfo;
-
 		 // Pipeline state name is used by the engine to report issues.
 		 // It is always a good idea to give objects descriptive names.
 		 PSOCreateInfo.PSODesc.Name = "Cube PSO";
@@ -1069,28 +1327,165 @@ void main(in  PSInput  PSIn,
 		 // This is a graphics pipeline
 		 PSOCreateInfo.PSODesc.PipelineType = PIPELINE_TYPE_GRAPHICS;
 
-		 // clang-format off
-		 // This tutorial will render to a single render target
-		 PSOCreateInfo.GraphicsPipeline.NumRenderTargets = 1;
-		 // Set render target format which is the format of the swap chain's color buffer
-		 PSOCreateInfo.GraphicsPipeline.RTVFormats[0] = m_pSwapChain->GetDesc().ColorBufferFormat;
-		 // Set depth buffer format which is the format of the swap chain's back buffer
-		 PSOCreateInfo.GraphicsPipeline.DSVFormat = m_pSwapChain->GetDesc().DepthBufferFormat;
-		 // Primitive topology defines what kind of primitives will be rendered by this pipeline state
-		 PSOCreateInfo.GraphicsPipeline.PrimitiveTopology = PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-		 // Cull back faces
-		 PSOCreateInfo.GraphicsPipeline.RasterizerDesc.FrontCounterClockwise = True;
-		 if (m_DeviceType == RENDER_DEVICE_TYPE_GL) {
-			 PSOCreateInfo.GraphicsPipeline.RasterizerDesc.CullMode = CULL_MODE_BACK;
+		 PSOCreateInfo.GraphicsPipeline.NumRenderTargets = Key.NumRenderTargets;
+		 for (Uint32 i = 0; i < Key.NumRenderTargets; i++) {
+			 PSOCreateInfo.GraphicsPipeline.RTVFormats[i] = static_cast<TEXTURE_FORMAT>(Key.RTVFormats[i]);
 		 }
-		 else if (m_DeviceType == RENDER_DEVICE_TYPE_VULKAN) {
-			 PSOCreateInfo.GraphicsPipeline.RasterizerDesc.CullMode = CULL_MODE_FRONT;
+		 PSOCreateInfo.GraphicsPipeline.DSVFormat = static_cast<TEXTURE_FORMAT>(Key.DSVFormat);
+		 PSOCreateInfo.GraphicsPipeline.PrimitiveTopology = static_cast<PRIMITIVE_TOPOLOGY>(Key.PrimitiveTopology);
+		 PSOCreateInfo.GraphicsPipeline.SmplDesc.Count = Key.SampleCount;
+
+		 PSOCreateInfo.GraphicsPipeline.InputLayout = Layout.GetDesc();
+
+		 // Define variable type that will be used by default
+		 PSOCreateInfo.PSODesc.ResourceLayout.DefaultVariableType = SHADER_RESOURCE_VARIABLE_TYPE_STATIC;
+
+		 static const ShaderResourceVariableDesc Vars[] =
+		 {
+			 {SHADER_TYPE_PIXEL, "sampler0_ssao", SHADER_RESOURCE_VARIABLE_TYPE_MUTABLE},
+			 {SHADER_TYPE_PIXEL, "sampler0_iblDFG", SHADER_RESOURCE_VARIABLE_TYPE_MUTABLE},
+			 {SHADER_TYPE_PIXEL, "sampler0_iblSpecular", SHADER_RESOURCE_VARIABLE_TYPE_MUTABLE},
+		 };
+		 PSOCreateInfo.PSODesc.ResourceLayout.Variables = Vars;
+		 PSOCreateInfo.PSODesc.ResourceLayout.NumVariables = _countof(Vars);
+
+		 auto ClampSampler = [](FILTER_TYPE Min, FILTER_TYPE Mag, FILTER_TYPE Mip) {
+			 SamplerDesc Desc
+			 {
+				 Min, Mag, Mip,
+				 TEXTURE_ADDRESS_CLAMP, TEXTURE_ADDRESS_CLAMP, TEXTURE_ADDRESS_CLAMP
+			 };
+			 Desc.MinLOD = -1000;
+			 Desc.MaxLOD = 1000;
+			 return Desc;
+		 };
+		 static const ImmutableSamplerDesc ImtblSamplers[] =
+		 {
+			 {SHADER_TYPE_PIXEL, "sampler0_ssao", ClampSampler(FILTER_TYPE_POINT, FILTER_TYPE_POINT, FILTER_TYPE_POINT)},
+			 {SHADER_TYPE_PIXEL, "sampler0_iblDFG", ClampSampler(FILTER_TYPE_LINEAR, FILTER_TYPE_LINEAR, FILTER_TYPE_POINT)},
+			 {SHADER_TYPE_PIXEL, "sampler0_iblSpecular", ClampSampler(FILTER_TYPE_LINEAR, FILTER_TYPE_LINEAR, FILTER_TYPE_LINEAR)}
+		 };
+		 PSOCreateInfo.PSODesc.ResourceLayout.ImmutableSamplers = ImtblSamplers;
+		 PSOCreateInfo.PSODesc.ResourceLayout.NumImmutableSamplers = _countof(ImtblSamplers);
+	 }
+
+	 // The vertex format of the mesh. The render thread converts it into the InputLayout of the
+	 // pipelines, see DiligentCreateVertexBufferInfo().
+	 void CreateVertexBufferInfo()
+	 {
+		 using namespace filament::backend;
+		 AttributeArray Attributes;
+		 // position
+		 Attributes[0] = { 0, 8, 0, ElementType::HALF4, 0 };
+		 // tangent
+		 Attributes[1] = { 142280, 8, 1, ElementType::SHORT4, Attribute::FLAG_NORMALIZED };
+		 // color
+		 Attributes[2] = { 284560, 4, 2, ElementType::UBYTE4, Attribute::FLAG_NORMALIZED };
+		 // uv
+		 Attributes[3] = { 355700, 4, 3, ElementType::SHORT2, Attribute::FLAG_NORMALIZED };
+		 m_VertexBufferInfo = mEngine.getVertexBufferInfoFactory().create(mEngine.getDriverApi(), 4, 4, Attributes);
+	 }
+
+	 // The material's raster state, with the overrides of the instance applied.
+	 filament::backend::RasterState GetRasterState() const
+	 {
+		 const filament::FMaterialInstance* mi = downcast(m_MaterialInstance);
+		 filament::backend::RasterState rs = mi->getMaterial()->getRasterState();
+		 rs.culling = mi->getCullingMode();
+		 rs.colorWrite = mi->isColorWriteEnabled();
+		 rs.depthWrite = mi->isDepthWriteEnabled();
+		 rs.depthFunc = mi->getDepthFunc();
+		 return rs;
+	 }
+
+	 PipelineStateKey MakePipelineStateKey(filament::backend::RasterState rs) const
+	 {
+		 const SwapChainDesc& SCDesc = m_pSwapChain->GetDesc();
+		 PipelineStateKey Key;
+		 Key.ProgramId = m_ProgramId;
+		 Key.RasterState = rs.u;
+		 Key.InputLayoutHash = m_pInputLayout->Hash;
+		 Key.ResourceLayoutHash = m_ResourceLayoutHash;
+		 Key.NumRenderTargets = 1;
+		 Key.RTVFormats[0] = SCDesc.ColorBufferFormat;
+		 Key.DSVFormat = SCDesc.DepthBufferFormat;
+		 Key.PrimitiveTopology = PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+		 return Key;
+	 }
+
+	 // Returns a pipeline description for the cache, it only captures what it owns since it may
+	 // run on the cache's worker thread.
+	 PipelineStateCache::FillCallback MakeFillCallback(const PipelineStateKey& Key) const
+	 {
+		 filament::backend::RasterState rs;
+		 rs.u = Key.RasterState;
+		 // the Vulkan clip space is y-flipped, which flips the winding of the faces
+		 const bool FlipWinding = m_DeviceType == RENDER_DEVICE_TYPE_VULKAN;
+		 return [Key, rs, FlipWinding, pVS = m_pVS, pPS = m_pPS,
+				 pInputLayout = m_pInputLayout](GraphicsPipelineStateCreateInfo& PSOCreateInfo) mutable {
+			 FillPipelineStateCreateInfo(PSOCreateInfo, Key, *pInputLayout);
+			 ApplyRasterState(rs, FlipWinding, PSOCreateInfo.GraphicsPipeline);
+			 PSOCreateInfo.pVS = pVS;
+			 PSOCreateInfo.pPS = pPS;
+		 };
+	 }
+
+	 PipelineStateCache::InitCallback MakeInitCallback() const
+	 {
+		 return [PerRenderable = m_PerRenderableConstants, PerView = m_PerViewConstants,
+				 MaterialParam = m_PSMaterialParam](IPipelineState* pPSO) mutable {
+			 pPSO->GetStaticVariableByName(SHADER_TYPE_VERTEX, "ObjectUniforms")->Set(PerRenderable);
+			 pPSO->GetStaticVariableByName(SHADER_TYPE_PIXEL, "ObjectUniforms")->Set(PerRenderable);
+			 pPSO->GetStaticVariableByName(SHADER_TYPE_VERTEX, "FrameUniforms")->Set(PerView);
+			 pPSO->GetStaticVariableByName(SHADER_TYPE_PIXEL, "FrameUniforms")->Set(PerView);
+			 pPSO->GetStaticVariableByName(SHADER_TYPE_PIXEL, "MaterialParams")->Set(MaterialParam);
+		 };
+	 }
+
+	 void BindPipelineState(IPipelineState* pPSO)
+	 {
+		 if (pPSO == m_pPSO) {
+			 return;
 		 }
-		 // Enable depth testing
-		 PSOCreateInfo.GraphicsPipeline.DepthStencilDesc.DepthEnable = True;
-		 PSOCreateInfo.GraphicsPipeline.DepthStencilDesc.DepthFunc = COMPARISON_FUNC_GREATER_EQUAL;
-		 // clang-format on
+		 // pipelines of the same material share their resource layout, so does the binding
+		 const bool Compatible = m_pPSO && m_SRB && pPSO->IsCompatibleWith(m_pPSO);
+		 m_pPSO = pPSO;
+		 if (!Compatible) {
+			 // Create a shader resource binding object and bind all static resources in it
+			 m_SRB.Release();
+			 m_pPSO->CreateShaderResourceBinding(&m_SRB, true);
+			 if (m_TextureSRV_ssao) {
+				 m_SRB->GetVariableByName(SHADER_TYPE_PIXEL, "sampler0_ssao")->Set(m_TextureSRV_ssao);
+			 }
+			 if (m_TextureSRV_iblDFG) {
+				 m_SRB->GetVariableByName(SHADER_TYPE_PIXEL, "sampler0_iblDFG")->Set(m_TextureSRV_iblDFG);
+			 }
+			 if (m_TextureSRV_iblSpecular) {
+				 m_SRB->GetVariableByName(SHADER_TYPE_PIXEL, "sampler0_iblSpecular")->Set(m_TextureSRV_iblSpecular);
+			 }
+		 }
+	 }
+
+	 // Follows raster state changes of the material instance. Known pipelines are found without
+	 // locking; a missing one is created in the background while the current one keeps being used.
+	 void UpdatePipelineState()
+	 {
+		 const PipelineStateKey Key = MakePipelineStateKey(GetRasterState());
+		 if (Key == m_PSOKey) {
+			 return;
+		 }
+		 IPipelineState* pPSO = m_pPSOCache->Get(Key);
+		 if (!pPSO) {
+			 pPSO = m_pPSOCache->GetOrCreateAsync(Key, MakeFillCallback(Key), MakeInitCallback());
+		 }
+		 if (pPSO) {
+			 BindPipelineState(pPSO);
+			 m_PSOKey = Key;
+		 }
+	 }
 
+	 void CreatePipelineState()
+	 {
 		 ShaderCreateInfo ShaderCI;
 		 // Tell the system that the shader source code is in HLSL.
 		 // For OpenGL, the engine will convert this into GLSL under the hood.
@@ -1131,7 +1526,12 @@ void main(in  PSInput  PSIn,
 				 ShaderCI.ByteCode = mVSSourceVK.data();
 				 ShaderCI.ByteCodeSize = mVSSourceVK.size() * sizeof(uint32_t);
 			 }
-			 m_pDevice->CreateShader(ShaderCI, &pVS);
+			 {
+				 auto const start = std::chrono::steady_clock::now();
+				 m_pDevice->CreateShader(ShaderCI, &pVS);
+				 m_ShaderCreateSeconds += std::chrono::duration<double>(
+					 std::chrono::steady_clock::now() - start).count();
+			 }
 			 // Create dynamic uniform buffer that will store our transformation matrix
 			 // Dynamic buffers can be frequently updated by the CPU
 			 uint32_t mRenderableUBOSize = 0;// uint32_t(16 * sizeof(filament::PerRenderableData));
@@ -1168,7 +1568,12 @@ void main(in  PSInput  PSIn,
 				 ShaderCI.ByteCode = mPSSourceVK.data();
 				 ShaderCI.ByteCodeSize = mPSSourceVK.size() * sizeof(uint32_t);
 			 }
-			 m_pDevice->CreateShader(ShaderCI, &pPS);
+			 {
+				 auto const start = std::chrono::steady_clock::now();
+				 m_pDevice->CreateShader(ShaderCI, &pPS);
+				 m_ShaderCreateSeconds += std::chrono::duration<double>(
+					 std::chrono::steady_clock::now() - start).count();
+			 }
 
 			 BufferDesc lightDesc;
 			 lightDesc.Name = "LightsUniforms";
@@ -1188,90 +1593,24 @@ void main(in  PSInput  PSIn,
 			 m_pDevice->CreateBuffer(materialDesc, nullptr, &m_PSMaterialParam);
 		 }
 
-		 // clang-format off
-		 // Define vertex shader input layout
-// 		 LayoutElement LayoutElems[] =
-// 		 {
-// 			 // Attribute 0 - vertex position
-// 			 LayoutElement{0, 0, 3, VT_FLOAT32, False},
-// 			 // Attribute 1 - vertex color
-// 			 LayoutElement{1, 0, 4, VT_FLOAT32, False}
-// 		 };
-		 LayoutElement LayoutElems[] =
-		 {
-			 // Attribute 0 - vertex position
-			 LayoutElement{0, 0, 4, VT_FLOAT16, False/*, 0, 8*/},
-			 // Attribute 1 - vertex tangent
-			 LayoutElement{1, 1, 4, VT_INT16, True/*, 142280, 8*/},
-			 // Attribute 2 - vertex color
-			 LayoutElement{2, 2, 4, VT_UINT8, True/*, 284560, 4*/},
-			 // Attribute 3 - vertex uv
-			 LayoutElement{3, 3, 2, VT_INT16, True/*, 355700, 4*/}
-		 };
-		 // clang-format on
-		 PSOCreateInfo.GraphicsPipeline.InputLayout.LayoutElements = LayoutElems;
-		 PSOCreateInfo.GraphicsPipeline.InputLayout.NumElements = _countof(LayoutElems);
-
-		 PSOCreateInfo.pVS = pVS;
-		 PSOCreateInfo.pPS = pPS;
-
-		 // Define variable type that will be used by default
-		 PSOCreateInfo.PSODesc.ResourceLayout.DefaultVariableType = SHADER_RESOURCE_VARIABLE_TYPE_STATIC;
-
-		 ShaderResourceVariableDesc Vars[] =
-		 {
-			 {SHADER_TYPE_PIXEL, "sampler0_ssao", SHADER_RESOURCE_VARIABLE_TYPE_MUTABLE},
-			 {SHADER_TYPE_PIXEL, "sampler0_iblDFG", SHADER_RESOURCE_VARIABLE_TYPE_MUTABLE},
-			 {SHADER_TYPE_PIXEL, "sampler0_iblSpecular", SHADER_RESOURCE_VARIABLE_TYPE_MUTABLE},
-		 };
-		 PSOCreateInfo.PSODesc.ResourceLayout.Variables = Vars;
-		 PSOCreateInfo.PSODesc.ResourceLayout.NumVariables = _countof(Vars);
-
-		 SamplerDesc ssaoSamplerDesc
-		 {
-			 FILTER_TYPE_POINT, FILTER_TYPE_POINT, FILTER_TYPE_POINT,
-			 TEXTURE_ADDRESS_CLAMP, TEXTURE_ADDRESS_CLAMP, TEXTURE_ADDRESS_CLAMP
-		 };
-		 ssaoSamplerDesc.MinLOD = -1000;
-		 ssaoSamplerDesc.MaxLOD = 1000;
-		 SamplerDesc iblDFGSamplerDesc
-		 {
-			 FILTER_TYPE_LINEAR, FILTER_TYPE_LINEAR, FILTER_TYPE_POINT,
-			 TEXTURE_ADDRESS_CLAMP, TEXTURE_ADDRESS_CLAMP, TEXTURE_ADDRESS_CLAMP
-		 };
-		 iblDFGSamplerDesc.MinLOD = -1000;
-		 iblDFGSamplerDesc.MaxLOD = 1000;
-		 SamplerDesc iblSpecularSamplerDesc
-		 {
-			 FILTER_TYPE_LINEAR, FILTER_TYPE_LINEAR, FILTER_TYPE_LINEAR,
-			 TEXTURE_ADDRESS_CLAMP, TEXTURE_ADDRESS_CLAMP, TEXTURE_ADDRESS_CLAMP
-		 };
-		 iblSpecularSamplerDesc.MinLOD = -1000;
-		 iblSpecularSamplerDesc.MaxLOD = 1000;
-		 ImmutableSamplerDesc ImtblSamplers[] =
-		 {
-			 {SHADER_TYPE_PIXEL, "sampler0_ssao", ssaoSamplerDesc},
-			 {SHADER_TYPE_PIXEL, "sampler0_iblDFG", iblDFGSamplerDesc},
-			 {SHADER_TYPE_PIXEL, "sampler0_iblSpecular", iblSpecularSamplerDesc}
-		 };
-		 PSOCreateInfo.PSODesc.ResourceLayout.ImmutableSamplers = ImtblSamplers;
-		 PSOCreateInfo.PSODesc.ResourceLayout.NumImmutableSamplers = _countof(ImtblSamplers);
-
-		 m_pDevice->CreateGraphicsPipelineState(PSOCreateInfo, &m_pPSO);
-
-		 auto pSRV = m_pPSO->GetStaticVariableByName(SHADER_TYPE_VERTEX, "ObjectUniforms");
-		 pSRV->Set(m_PerRenderableConstants);
-		 pSRV = m_pPSO->GetStaticVariableByName(SHADER_TYPE_PIXEL, "ObjectUniforms");
-		 pSRV->Set(m_PerRenderableConstants);
-		 pSRV = m_pPSO->GetStaticVariableByName(SHADER_TYPE_VERTEX, "FrameUniforms");
-		 pSRV->Set(m_PerViewConstants);
-		 pSRV = m_pPSO->GetStaticVariableByName(SHADER_TYPE_PIXEL, "FrameUniforms");
-		 pSRV->Set(m_PerViewConstants);
-		 pSRV = m_pPSO->GetStaticVariableByName(SHADER_TYPE_PIXEL, "MaterialParams");
-		 pSRV->Set(m_PSMaterialParam);
-
-		 // Create a shader resource binding object and bind all static resources in it
-		 m_pPSO->CreateShaderResourceBinding(&m_SRB, true);
+		 m_pVS = pVS;
+		 m_pPS = pPS;
+		 // identifies these shaders in the pipeline cache, later programs don't replace them
+		 m_ProgramId = m_ShaderSourcesProgramId;
+		 m_PipelineDescriptors = m_ShaderSourcesDescriptors;
+
+		 // The engine's layouts were converted by the render thread when it executed their
+		 // creation, it's idle once flushAndWait() returns.
+		 CreateVertexBufferInfo();
+		 mEngine.flushAndWait();
+		 m_pInputLayout = std::make_shared<const InputLayout>(g_InputLayouts.Get(m_VertexBufferInfo.getId()));
+		 const filament::FMaterial* pMaterial = downcast(m_MaterialInstance)->getMaterial();
+		 m_ResourceLayoutHash =
+			 g_ResourceSignatureLayouts.Get(pMaterial->getDescriptorSetLayout().getHandle().getId()).Hash;
+
+		 // the first pipeline is needed right away, later ones are built in the background
+		 m_PSOKey = MakePipelineStateKey(GetRasterState());
+		 BindPipelineState(m_pPSOCache->GetOrCreate(m_PSOKey, MakeFillCallback(m_PSOKey), MakeInitCallback()));
 	 }
 	 void UpdateUniform()
 	 {
@@ -1302,12 +1641,19 @@ void main(in  PSInput  PSIn,
  
 	 void Render()
 	 {
+		 CreatePendingPrograms();
+		 // the engine's buffer uploads and descriptor set binds executed since the last frame
+		 ApplyPendingCommands();
+		 // commits the material instances modified since the last frame
+		 mEngine.prepare();
+
 		 IDeviceContext* pCtx = m_pImmediateContext;// GetImmediateContext();
 		 pCtx->ClearStats();
 
 		 ITextureView* pRTV = m_pSwapChain->GetCurrentBackBufferRTV();
 		 ITextureView* pDSV = m_pSwapChain->GetDepthBufferDSV();
 		 pCtx->SetRenderTargets(1, &pRTV, pDSV, RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
+		 mEngine.beginRenderPass();
 
 // 		 ITextureView* pRTV = m_pSwapChain->GetCurrentBackBufferRTV();
 // 		 ITextureView* pDSV = m_pSwapChain->GetDepthBufferDSV();
@@ -1336,7 +1682,9 @@ void main(in  PSInput  PSIn,
 		 m_pImmediateContext->SetIndexBuffer(m_CubeIndexBuffer, 0, RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
 
 		 // Set the pipeline state
+		 UpdatePipelineState();
 		 m_pImmediateContext->SetPipelineState(m_pPSO);
+		 mEngine.bindPipeline();
 		 // Commit shader resources. RESOURCE_STATE_TRANSITION_MODE_TRANSITION mode
 		 // makes sure that resources are transitioned to required states.
 		 m_pImmediateContext->CommitShaderResources(m_SRB, RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
@@ -1404,6 +1752,34 @@ void main(in  PSInput  PSIn,
 			 ImGui::Text("counter = %d", counter);
 
 			 ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
+			 if (m_SpirvStripStats.modules) {
+				 ImGui::Text("SPIR-V stripping: %zu modules, %zu -> %zu bytes in %.1f ms",
+					 m_SpirvStripStats.modules, m_SpirvStripStats.bytesIn, m_SpirvStripStats.bytesOut,
+					 m_SpirvStripStats.seconds * 1000.0);
+			 }
+			 if (m_pPSOCache) {
+				 const PipelineStateCache::Stats PSOStats = m_pPSOCache->GetStats();
+				 ImGui::Text("PSO cache: %u created, %u pending, %u/%u hits, %zu bytes loaded",
+					 PSOStats.Created, PSOStats.Pending, PSOStats.Hits, PSOStats.Lookups,
+					 PSOStats.DiskBytesLoaded);
+			 }
+			 {
+				 const filament::DescriptorSetCache::Stats DSStats =
+					 mEngine.getDescriptorSetLayoutFactory().getDescriptorSetCache().getStats();
+				 ImGui::Text("Descriptor set cache: %u/%u hits, %u sets, %u binds skipped",
+					 DSStats.hits, DSStats.lookups, DSStats.sets, DSStats.bindsSkipped);
+			 }
+			 {
+				 // the last frame's, see Config::commandBufferSizeMB
+				 const filament::FEngine::FlushStats& FlushStats = mEngine.getFlushStats();
+				 const filament::backend::CommandStream::Usage Usage = mEngine.getCommandStreamUsage();
+				 ImGui::Text("Commands: %zu KiB recorded, %zu KiB staging, %u flushes (%u over %zu KiB)",
+					 Usage.ring / 1024, Usage.staging / 1024, FlushStats.count, FlushStats.budgetCount,
+					 FlushStats.flushThreshold / 1024);
+				 ImGui::Text("Command buffer: %zu KiB largest flush, %zu KiB high watermark, %u idle, %.2f ms stalled",
+					 FlushStats.largest / 1024, FlushStats.highWatermark / 1024, FlushStats.idleCount,
+					 std::chrono::duration<double, std::milli>(FlushStats.stallTime).count());
+			 }
 			 ImGui::End();
 		 }
 	 }
@@ -1411,6 +1787,7 @@ void main(in  PSInput  PSIn,
      void Present()
      {
          m_pSwapChain->Present();
+         mEngine.endFrame();
      }
  
      void WindowResize(Uint32 Width, Uint32 Height)
@@ -1426,6 +1803,27 @@ void main(in  PSInput  PSIn,
      RefCntAutoPtr<IDeviceContext> m_pImmediateContext;
      RefCntAutoPtr<ISwapChain>     m_pSwapChain;
      RefCntAutoPtr<IPipelineState> m_pPSO;
+	 RefCntAutoPtr<IShader>        m_pVS;
+	 RefCntAutoPtr<IShader>        m_pPS;
+	 std::unique_ptr<PipelineStateCache> m_pPSOCache;
+	 PipelineStateKey              m_PSOKey;
+	 uint64_t                      m_ProgramId = 0;          // program of m_pVS and m_pPS
+	 uint64_t                      m_ShaderSourcesProgramId = 0; // program of mVSSource(VK), mPSSource(VK)
+	 // descriptor names of these programs, by set, BindDescriptorSet() binds buffers by name
+	 filament::backend::Program::DescriptorSetInfo m_PipelineDescriptors;
+	 filament::backend::Program::DescriptorSetInfo m_ShaderSourcesDescriptors;
+	 struct DescriptorSetBuffer
+	 {
+		 filament::backend::HandleBase::HandleId Id = filament::backend::HandleBase::nullid;
+		 uint32_t Offset = 0;
+		 uint32_t Size = 0;
+	 };
+	 std::unordered_map<filament::backend::HandleBase::HandleId, RefCntAutoPtr<IBuffer>> m_Buffers;
+	 std::unordered_map<filament::backend::HandleBase::HandleId,
+		 std::array<DescriptorSetBuffer, filament::backend::MAX_DESCRIPTOR_COUNT>> m_DescriptorSets;
+	 filament::backend::VertexBufferInfoHandle m_VertexBufferInfo;
+	 std::shared_ptr<const InputLayout> m_pInputLayout; // shared with the pipelines being built
+	 uint32_t                      m_ResourceLayoutHash = 0;
 	 RENDER_DEVICE_TYPE            m_DeviceType = RENDER_DEVICE_TYPE_D3D11;
 	 //
 	 RefCntAutoPtr<IBuffer>                m_CubeVertexBuffer;
@@ -1451,20 +1849,142 @@ void main(in  PSInput  PSIn,
 	 mutable filament::TypedUniformBuffer<filament::PerViewUib> mUniforms;
 	 mutable filament::ColorPassDescriptorSet mColorPassDescriptorSet;
 	 filament::FEngine& mEngine;
+	 const char* m_ShaderDumpDir = nullptr;
 	 std::string mVSSource;
 	 std::string mPSSource;
 	 std::vector<uint32_t> mVSSourceVK;
 	 std::vector<uint32_t> mPSSourceVK;
+	 std::unordered_map<SpecConstantPatchTableKey, filament::backend::fvkutils::SpecConstantPatchTable,
+		 SpecConstantPatchTableKeyHasher> mSpecConstantPatchTables;
+	 // live programs, and how many of them use each cache id
+	 std::unordered_map<filament::backend::HandleBase::HandleId, uint64_t> mProgramCacheIds;
+	 std::unordered_map<uint64_t, uint32_t> mProgramCacheIdRefs;
+	 // post-specialization SPIR-V dead-code stripping, when available
+	 bool m_StripSpirvDeadCode = true;
+	 struct {
+		 size_t modules = 0;
+		 size_t bytesIn = 0;
+		 size_t bytesOut = 0;
+		 double seconds = 0.0;
+	 } m_SpirvStripStats;
+	 // time spent by the device creating (compiling) the shaders
+	 double m_ShaderCreateSeconds = 0.0;
 	 std::unique_ptr<ImGuiImplDiligent> m_pImGui;
  };
  
  std::unique_ptr<Tutorial00App> g_pTheApp;
 
- void DiligentCreateProgram(filament::backend::Program&& program)
+ void DiligentCreateProgram(filament::backend::HandleBase::HandleId id, filament::backend::Program&& program)
+ {
+	 std::lock_guard<std::mutex> Lock(g_PendingProgramsLock);
+	 g_PendingPrograms.push_back({ id, std::move(program) });
+ }
+
+ void DiligentDestroyProgram(filament::backend::HandleBase::HandleId id)
+ {
+	 std::lock_guard<std::mutex> Lock(g_PendingProgramsLock);
+	 g_PendingPrograms.push_back({ id, std::nullopt });
+ }
+
+ void DiligentCompilePrograms(utils::Invocable<void()>&& ready)
+ {
+	 std::lock_guard<std::mutex> Lock(g_PendingProgramsLock);
+	 g_PendingPrograms.push_back({ filament::backend::HandleBase::nullid, std::nullopt, std::move(ready) });
+ }
+
+ void DiligentCreateBuffer(filament::backend::HandleBase::HandleId id, uint32_t byteCount,
+	 filament::backend::BufferObjectBinding bindingType, filament::backend::BufferUsage)
+ {
+	 using filament::backend::BufferObjectBinding;
+	 const BIND_FLAGS BindFlags =
+		 bindingType == BufferObjectBinding::VERTEX  ? BIND_VERTEX_BUFFER :
+		 bindingType == BufferObjectBinding::UNIFORM ? BIND_UNIFORM_BUFFER : BIND_UNORDERED_ACCESS;
+	 PushPendingCommand([id, byteCount, BindFlags](Tutorial00App& App) {
+		 App.CreateBuffer(id, byteCount, BindFlags);
+	 });
+ }
+
+ void DiligentCreateIndexBuffer(filament::backend::HandleBase::HandleId id, uint32_t byteCount,
+	 filament::backend::BufferUsage)
  {
-	 if (g_pTheApp) {
-		 g_pTheApp->CreateFilamentProgram(std::move(program));
+	 PushPendingCommand([id, byteCount](Tutorial00App& App) {
+		 App.CreateBuffer(id, byteCount, BIND_INDEX_BUFFER);
+	 });
+ }
+
+ void DiligentUpdateBuffer(filament::backend::HandleBase::HandleId id,
+	 filament::backend::BufferDescriptor&& data, uint32_t byteOffset)
+ {
+	 // the descriptor's callback releases the data once it's uploaded
+	 PushPendingCommand([id, Data = std::move(data), byteOffset](Tutorial00App& App) {
+		 App.UpdateBuffer(id, Data, byteOffset);
+	 });
+ }
+
+ void DiligentDestroyBuffer(filament::backend::HandleBase::HandleId id)
+ {
+	 PushPendingCommand([id](Tutorial00App& App) { App.DestroyBuffer(id); });
+ }
+
+ void DiligentCreateDescriptorSet(filament::backend::HandleBase::HandleId id,
+	 filament::backend::HandleBase::HandleId layoutId)
+ {
+	 g_DescriptorSetLayouts.Set(id, filament::backend::HandleBase::HandleId(layoutId));
+	 PushPendingCommand([id](Tutorial00App& App) { App.CreateDescriptorSet(id); });
+ }
+
+ void DiligentUpdateDescriptorSetBuffer(filament::backend::HandleBase::HandleId id,
+	 filament::backend::descriptor_binding_t binding, filament::backend::HandleBase::HandleId bufferId,
+	 uint32_t offset, uint32_t size)
+ {
+	 PushPendingCommand([id, binding, bufferId, offset, size](Tutorial00App& App) {
+		 App.UpdateDescriptorSetBuffer(id, binding, bufferId, offset, size);
+	 });
+ }
+
+ void DiligentDestroyDescriptorSet(filament::backend::HandleBase::HandleId id)
+ {
+	 PushPendingCommand([id](Tutorial00App& App) { App.DestroyDescriptorSet(id); });
+ }
+
+ void DiligentBindDescriptorSet(filament::backend::HandleBase::HandleId id,
+	 filament::backend::descriptor_set_t set, uint32_t const* dynamicOffsets)
+ {
+	 // The offsets are in the order of the layout's dynamic bindings, which only the render thread
+	 // reads, so they're spread by binding here.
+	 std::array<uint32_t, filament::backend::MAX_DESCRIPTOR_COUNT> Offsets{};
+	 if (dynamicOffsets) {
+		 const ResourceSignatureLayout& Layout = g_ResourceSignatureLayouts.Get(g_DescriptorSetLayouts.Get(id));
+		 size_t i = 0;
+		 for (uint64_t Mask = Layout.DynamicBindings; Mask; Mask &= Mask - 1) {
+			 Offsets[std::countr_zero(Mask)] = dynamicOffsets[i++];
+		 }
 	 }
+	 PushPendingCommand([id, set, Offsets](Tutorial00App& App) {
+		 App.BindDescriptorSet(id, set, Offsets);
+	 });
+ }
+
+ void DiligentCreateVertexBufferInfo(filament::backend::HandleBase::HandleId id,
+	 uint8_t bufferCount, uint8_t attributeCount, filament::backend::AttributeArray const& attributes)
+ {
+	 g_InputLayouts.Set(id, ConvertVertexBufferInfo(attributeCount, attributes));
+ }
+
+ void DiligentDestroyVertexBufferInfo(filament::backend::HandleBase::HandleId id)
+ {
+	 g_InputLayouts.Remove(id);
+ }
+
+ void DiligentCreateDescriptorSetLayout(filament::backend::HandleBase::HandleId id,
+	 filament::backend::DescriptorSetLayout&& info)
+ {
+	 g_ResourceSignatureLayouts.Set(id, ConvertDescriptorSetLayout(info));
+ }
+
+ void DiligentDestroyDescriptorSetLayout(filament::backend::HandleBase::HandleId id)
+ {
+	 g_ResourceSignatureLayouts.Remove(id);
  }
 
  class Timer
@@ -1582,6 +2102,8 @@ void main(in  PSInput  PSIn,
      }
  
      g_pTheApp.reset();
+	 filament::FEngine::destroy(g_FilamentEngine);
+	 g_FilamentEngine = nullptr;
 
 	 //FreeConsole();
      
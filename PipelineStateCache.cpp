@@ -0,0 +1,592 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "PipelineStateCache.hpp"
+
+#include "Primitives/interface/DataBlob.h"
+#include "Primitives/interface/Errors.hpp"
+
+#include <utils/Hash.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+using namespace Diligent;
+using namespace filament::backend;
+
+namespace
+{
+
+CULL_MODE ToCullMode(CullingMode Mode) noexcept
+{
+    switch (Mode)
+    {
+        case CullingMode::NONE: return CULL_MODE_NONE;
+        case CullingMode::FRONT: return CULL_MODE_FRONT;
+        case CullingMode::BACK: return CULL_MODE_BACK;
+        // no equivalent, handled by the caller
+        case CullingMode::FRONT_AND_BACK: return CULL_MODE_BACK;
+    }
+    return CULL_MODE_BACK;
+}
+
+COMPARISON_FUNCTION ToComparisonFunc(SamplerCompareFunc Func) noexcept
+{
+    switch (Func)
+    {
+        case SamplerCompareFunc::LE: return COMPARISON_FUNC_LESS_EQUAL;
+        case SamplerCompareFunc::GE: return COMPARISON_FUNC_GREATER_EQUAL;
+        case SamplerCompareFunc::L: return COMPARISON_FUNC_LESS;
+        case SamplerCompareFunc::G: return COMPARISON_FUNC_GREATER;
+        case SamplerCompareFunc::E: return COMPARISON_FUNC_EQUAL;
+        case SamplerCompareFunc::NE: return COMPARISON_FUNC_NOT_EQUAL;
+        case SamplerCompareFunc::A: return COMPARISON_FUNC_ALWAYS;
+        case SamplerCompareFunc::N: return COMPARISON_FUNC_NEVER;
+    }
+    return COMPARISON_FUNC_ALWAYS;
+}
+
+BLEND_OPERATION ToBlendOperation(BlendEquation Equation) noexcept
+{
+    switch (Equation)
+    {
+        case BlendEquation::ADD: return BLEND_OPERATION_ADD;
+        case BlendEquation::SUBTRACT: return BLEND_OPERATION_SUBTRACT;
+        case BlendEquation::REVERSE_SUBTRACT: return BLEND_OPERATION_REV_SUBTRACT;
+        case BlendEquation::MIN: return BLEND_OPERATION_MIN;
+        case BlendEquation::MAX: return BLEND_OPERATION_MAX;
+    }
+    return BLEND_OPERATION_ADD;
+}
+
+BLEND_FACTOR ToBlendFactor(BlendFunction Function) noexcept
+{
+    switch (Function)
+    {
+        case BlendFunction::ZERO: return BLEND_FACTOR_ZERO;
+        case BlendFunction::ONE: return BLEND_FACTOR_ONE;
+        case BlendFunction::SRC_COLOR: return BLEND_FACTOR_SRC_COLOR;
+        case BlendFunction::ONE_MINUS_SRC_COLOR: return BLEND_FACTOR_INV_SRC_COLOR;
+        case BlendFunction::DST_COLOR: return BLEND_FACTOR_DEST_COLOR;
+        case BlendFunction::ONE_MINUS_DST_COLOR: return BLEND_FACTOR_INV_DEST_COLOR;
+        case BlendFunction::SRC_ALPHA: return BLEND_FACTOR_SRC_ALPHA;
+        case BlendFunction::ONE_MINUS_SRC_ALPHA: return BLEND_FACTOR_INV_SRC_ALPHA;
+        case BlendFunction::DST_ALPHA: return BLEND_FACTOR_DEST_ALPHA;
+        case BlendFunction::ONE_MINUS_DST_ALPHA: return BLEND_FACTOR_INV_DEST_ALPHA;
+        case BlendFunction::SRC_ALPHA_SATURATE: return BLEND_FACTOR_SRC_ALPHA_SAT;
+    }
+    return BLEND_FACTOR_ONE;
+}
+
+VALUE_TYPE ToValueType(ElementType Type, Uint32& NumComponents) noexcept
+{
+    switch (Type)
+    {
+        // clang-format off
+        case ElementType::BYTE:    NumComponents = 1; return VT_INT8;
+        case ElementType::BYTE2:   NumComponents = 2; return VT_INT8;
+        case ElementType::BYTE3:   NumComponents = 3; return VT_INT8;
+        case ElementType::BYTE4:   NumComponents = 4; return VT_INT8;
+        case ElementType::UBYTE:   NumComponents = 1; return VT_UINT8;
+        case ElementType::UBYTE2:  NumComponents = 2; return VT_UINT8;
+        case ElementType::UBYTE3:  NumComponents = 3; return VT_UINT8;
+        case ElementType::UBYTE4:  NumComponents = 4; return VT_UINT8;
+        case ElementType::SHORT:   NumComponents = 1; return VT_INT16;
+        case ElementType::SHORT2:  NumComponents = 2; return VT_INT16;
+        case ElementType::SHORT3:  NumComponents = 3; return VT_INT16;
+        case ElementType::SHORT4:  NumComponents = 4; return VT_INT16;
+        case ElementType::USHORT:  NumComponents = 1; return VT_UINT16;
+        case ElementType::USHORT2: NumComponents = 2; return VT_UINT16;
+        case ElementType::USHORT3: NumComponents = 3; return VT_UINT16;
+        case ElementType::USHORT4: NumComponents = 4; return VT_UINT16;
+        case ElementType::INT:     NumComponents = 1; return VT_INT32;
+        case ElementType::UINT:    NumComponents = 1; return VT_UINT32;
+        case ElementType::FLOAT:   NumComponents = 1; return VT_FLOAT32;
+        case ElementType::FLOAT2:  NumComponents = 2; return VT_FLOAT32;
+        case ElementType::FLOAT3:  NumComponents = 3; return VT_FLOAT32;
+        case ElementType::FLOAT4:  NumComponents = 4; return VT_FLOAT32;
+        case ElementType::HALF:    NumComponents = 1; return VT_FLOAT16;
+        case ElementType::HALF2:   NumComponents = 2; return VT_FLOAT16;
+        case ElementType::HALF3:   NumComponents = 3; return VT_FLOAT16;
+        case ElementType::HALF4:   NumComponents = 4; return VT_FLOAT16;
+        // clang-format on
+    }
+    NumComponents = 4;
+    return VT_FLOAT32;
+}
+
+SHADER_TYPE ToShaderStages(ShaderStageFlags Flags) noexcept
+{
+    SHADER_TYPE Stages = SHADER_TYPE_UNKNOWN;
+    if (uint8_t(Flags) & uint8_t(ShaderStageFlags::VERTEX))
+        Stages |= SHADER_TYPE_VERTEX;
+    if (uint8_t(Flags) & uint8_t(ShaderStageFlags::FRAGMENT))
+        Stages |= SHADER_TYPE_PIXEL;
+    if (uint8_t(Flags) & uint8_t(ShaderStageFlags::COMPUTE))
+        Stages |= SHADER_TYPE_COMPUTE;
+    return Stages;
+}
+
+SHADER_RESOURCE_TYPE ToResourceType(DescriptorType Type) noexcept
+{
+    switch (Type)
+    {
+        case DescriptorType::UNIFORM_BUFFER: return SHADER_RESOURCE_TYPE_CONSTANT_BUFFER;
+        case DescriptorType::SHADER_STORAGE_BUFFER: return SHADER_RESOURCE_TYPE_BUFFER_UAV;
+        case DescriptorType::SAMPLER:
+        case DescriptorType::SAMPLER_EXTERNAL: return SHADER_RESOURCE_TYPE_TEXTURE_SRV;
+        case DescriptorType::INPUT_ATTACHMENT: return SHADER_RESOURCE_TYPE_INPUT_ATTACHMENT;
+    }
+    return SHADER_RESOURCE_TYPE_UNKNOWN;
+}
+
+uint32_t RoundUpToPowerOfTwo(uint32_t Value) noexcept
+{
+    uint32_t Result = 16;
+    while (Result < Value)
+        Result <<= 1;
+    return Result;
+}
+
+} // namespace
+
+uint32_t ComputeInputLayoutHash(const InputLayoutDesc& Layout) noexcept
+{
+    // semantic names are only used by D3D, which always uses ATTRIB<n>
+    uint32_t Hash = Layout.NumElements;
+    for (Uint32 i = 0; i < Layout.NumElements; ++i)
+    {
+        const LayoutElement& Elem = Layout.LayoutElements[i];
+        const uint32_t       Words[] = {
+            Elem.InputIndex,
+            Elem.BufferSlot,
+            Elem.NumComponents,
+            uint32_t(Elem.ValueType),
+            uint32_t(Elem.IsNormalized),
+            Elem.RelativeOffset,
+            Elem.Stride,
+            uint32_t(Elem.Frequency),
+            Elem.InstanceDataStepRate,
+        };
+        Hash = utils::hash::murmurSlow(reinterpret_cast<const uint8_t*>(Words), sizeof(Words), Hash);
+    }
+    return Hash;
+}
+
+InputLayout ConvertVertexBufferInfo(uint32_t AttributeCount, const AttributeArray& Attributes)
+{
+    InputLayout Layout;
+    Layout.Elements.reserve(AttributeCount);
+    for (Uint32 i = 0; i < Attributes.size(); ++i)
+    {
+        const Attribute& Attrib = Attributes[i];
+        if (Attrib.buffer == Attribute::BUFFER_UNUSED)
+            continue;
+
+        LayoutElement Elem;
+        Elem.InputIndex   = i;
+        Elem.BufferSlot   = i;
+        Elem.ValueType    = ToValueType(Attrib.type, Elem.NumComponents);
+        Elem.IsNormalized = (Attrib.flags & Attribute::FLAG_NORMALIZED) != 0;
+        Elem.Stride       = Attrib.stride;
+        Layout.Elements.push_back(Elem);
+    }
+    Layout.Hash = ComputeInputLayoutHash(Layout.GetDesc());
+    return Layout;
+}
+
+ResourceSignatureLayout ConvertDescriptorSetLayout(const DescriptorSetLayout& Layout)
+{
+    ResourceSignatureLayout Signature;
+    Signature.Resources.reserve(Layout.bindings.size());
+    Signature.Bindings.reserve(Layout.bindings.size());
+    uint32_t Hash = uint32_t(Layout.bindings.size());
+    for (const DescriptorSetLayoutBinding& Binding : Layout.bindings)
+    {
+        const bool DynamicOffset =
+            (uint8_t(Binding.flags) & uint8_t(DescriptorFlags::DYNAMIC_OFFSET)) != 0;
+
+        PIPELINE_RESOURCE_FLAGS Flags = PIPELINE_RESOURCE_FLAG_NONE;
+        if (Binding.type == DescriptorType::SAMPLER || Binding.type == DescriptorType::SAMPLER_EXTERNAL)
+            Flags |= PIPELINE_RESOURCE_FLAG_COMBINED_SAMPLER;
+        else if (Binding.type == DescriptorType::UNIFORM_BUFFER && !DynamicOffset)
+            Flags |= PIPELINE_RESOURCE_FLAG_NO_DYNAMIC_BUFFERS;
+
+        // descriptor sets are updated between draws
+        Signature.Resources.emplace_back(ToShaderStages(Binding.stageFlags), nullptr,
+                                         std::max<Uint32>(Binding.count, 1), ToResourceType(Binding.type),
+                                         SHADER_RESOURCE_VARIABLE_TYPE_MUTABLE, Flags);
+        Signature.Bindings.push_back(Binding.binding);
+        if (DynamicOffset)
+            Signature.DynamicBindings |= uint64_t(1) << Binding.binding;
+
+        const PipelineResourceDesc& Res     = Signature.Resources.back();
+        const uint32_t              Words[] = {
+            uint32_t(Res.ShaderStages),
+            Res.ArraySize,
+            uint32_t(Res.ResourceType),
+            uint32_t(Res.VarType),
+            uint32_t(Res.Flags),
+            Binding.binding,
+        };
+        Hash = utils::hash::murmurSlow(reinterpret_cast<const uint8_t*>(Words), sizeof(Words), Hash);
+    }
+    Signature.Hash = Hash;
+    return Signature;
+}
+
+void ApplyRasterState(RasterState RS, bool FlipWinding, GraphicsPipelineDesc& Desc) noexcept
+{
+    RasterizerStateDesc& Rasterizer = Desc.RasterizerDesc;
+    Rasterizer.CullMode              = ToCullMode(RS.culling);
+    Rasterizer.FrontCounterClockwise = RS.inverseFrontFaces == FlipWinding;
+    Rasterizer.DepthClipEnable       = !RS.depthClamp;
+
+    DepthStencilStateDesc& DepthStencil = Desc.DepthStencilDesc;
+    // filament expresses "no depth test" as ALWAYS without writes
+    DepthStencil.DepthEnable      = !(RS.depthFunc == SamplerCompareFunc::A && !RS.depthWrite);
+    DepthStencil.DepthWriteEnable = RS.depthWrite;
+    DepthStencil.DepthFunc        = ToComparisonFunc(RS.depthFunc);
+
+    BlendStateDesc& Blend       = Desc.BlendDesc;
+    Blend.AlphaToCoverageEnable = RS.alphaToCoverage;
+    Blend.IndependentBlendEnable = False;
+
+    RenderTargetBlendDesc& RT = Blend.RenderTargets[0];
+    RT.BlendEnable           = RS.hasBlending();
+    RT.BlendOp               = ToBlendOperation(RS.blendEquationRGB);
+    RT.BlendOpAlpha          = ToBlendOperation(RS.blendEquationAlpha);
+    RT.SrcBlend              = ToBlendFactor(RS.blendFunctionSrcRGB);
+    RT.DestBlend             = ToBlendFactor(RS.blendFunctionDstRGB);
+    RT.SrcBlendAlpha         = ToBlendFactor(RS.blendFunctionSrcAlpha);
+    RT.DestBlendAlpha        = ToBlendFactor(RS.blendFunctionDstAlpha);
+    RT.RenderTargetWriteMask = RS.colorWrite ? COLOR_MASK_ALL : COLOR_MASK_NONE;
+
+    if (RS.culling == CullingMode::FRONT_AND_BACK)
+    {
+        // Diligent can't cull both faces, instead let the geometry through without any effect
+        DepthStencil.DepthWriteEnable = False;
+        RT.RenderTargetWriteMask      = COLOR_MASK_NONE;
+    }
+}
+
+PipelineStateCache::PipelineStateCache(IRenderDevice* pDevice, const char* FilePath, uint32_t Capacity) :
+    m_pDevice{pDevice},
+    m_FilePath{FilePath ? FilePath : ""}
+{
+    const uint32_t SlotCount = RoundUpToPowerOfTwo(Capacity);
+    m_Slots.reset(new std::atomic<Entry*>[SlotCount]);
+    for (uint32_t i = 0; i < SlotCount; ++i)
+        m_Slots[i].store(nullptr, std::memory_order_relaxed);
+    m_Mask = SlotCount - 1;
+
+    const RenderDeviceInfo& DeviceInfo = m_pDevice->GetDeviceInfo();
+
+    // only D3D12 and Vulkan have driver-level pipeline caches
+    if (DeviceInfo.Type == RENDER_DEVICE_TYPE_D3D12 || DeviceInfo.Type == RENDER_DEVICE_TYPE_VULKAN)
+    {
+        std::vector<uint8_t> Data;
+        if (!m_FilePath.empty())
+        {
+            if (FILE* File = fopen(m_FilePath.c_str(), "rb"))
+            {
+                fseek(File, 0, SEEK_END);
+                const long Size = ftell(File);
+                fseek(File, 0, SEEK_SET);
+                if (Size > 0)
+                {
+                    Data.resize(size_t(Size));
+                    if (fread(Data.data(), 1, Data.size(), File) != Data.size())
+                        Data.clear();
+                }
+                fclose(File);
+            }
+        }
+
+        PipelineStateCacheCreateInfo CacheCI;
+        CacheCI.Desc.Name = "Filament PSO cache";
+        CacheCI.Desc.Mode = PSO_CACHE_MODE_LOAD_STORE;
+        // a stale or foreign blob is validated and discarded by the driver
+        CacheCI.pCacheData    = Data.empty() ? nullptr : Data.data();
+        CacheCI.CacheDataSize = static_cast<Uint32>(Data.size());
+        m_pDevice->CreatePipelineStateCache(CacheCI, &m_pCache);
+        if (m_pCache)
+            m_DiskBytesLoaded = Data.size();
+    }
+
+    // GL contexts are bound to a thread, pipelines are then created on the caller's thread
+    m_Async = DeviceInfo.Features.MultithreadedResourceCreation == DEVICE_FEATURE_STATE_ENABLED;
+    if (m_Async)
+        m_Worker = std::thread{&PipelineStateCache::WorkerLoop, this};
+}
+
+PipelineStateCache::~PipelineStateCache()
+{
+    if (m_Worker.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> Lock{m_QueueLock};
+            m_Exit = true;
+        }
+        m_QueueCondition.notify_one();
+        m_Worker.join();
+    }
+
+    // the worker finishes the pipeline it's building, the ones still queued are cancelled
+    if (!m_Queue.empty())
+    {
+        LOG_INFO_MESSAGE("PipelineStateCache: cancelled ", m_Queue.size(), " pending pipelines");
+        for (Entry* pEntry : m_Queue)
+        {
+            pEntry->Fill = nullptr;
+            pEntry->Init = nullptr;
+            pEntry->Status.store(State::Failed, std::memory_order_relaxed);
+        }
+        m_Pending.fetch_sub(static_cast<uint32_t>(m_Queue.size()), std::memory_order_relaxed);
+        m_Queue.clear();
+    }
+
+    Save();
+
+    for (size_t i = 0; i <= m_Mask; ++i)
+        delete m_Slots[i].load(std::memory_order_relaxed);
+}
+
+size_t PipelineStateCache::HashKey(const PipelineStateKey& Key) noexcept
+{
+    return utils::hash::murmurSlow(reinterpret_cast<const uint8_t*>(&Key), sizeof(Key), 0);
+}
+
+PipelineStateCache::Entry* PipelineStateCache::Find(const PipelineStateKey& Key, size_t Hash) const noexcept
+{
+    for (size_t i = Hash & m_Mask, Probes = 0; Probes <= m_Mask; i = (i + 1) & m_Mask, ++Probes)
+    {
+        Entry* const pEntry = m_Slots[i].load(std::memory_order_acquire);
+        if (pEntry == nullptr)
+            return nullptr;
+        if (pEntry->Hash == Hash && pEntry->Key == Key)
+            return pEntry;
+    }
+    return nullptr;
+}
+
+PipelineStateCache::Entry* PipelineStateCache::FindOverflow(const PipelineStateKey& Key, size_t Hash) const noexcept
+{
+    auto Pos = std::find_if(m_Overflow.begin(), m_Overflow.end(), [&](const std::unique_ptr<Entry>& pOther) {
+        return pOther->Hash == Hash && pOther->Key == Key;
+    });
+    return Pos != m_Overflow.end() ? Pos->get() : nullptr;
+}
+
+PipelineStateCache::Entry* PipelineStateCache::Insert(const PipelineStateKey& Key, size_t Hash,
+                                                      FillCallback&& Fill, InitCallback&& Init, bool& Inserted)
+{
+    std::lock_guard<std::mutex> Lock{m_InsertLock};
+
+    // another thread may have inserted it since our lookup
+    Inserted = false;
+    if (Entry* pEntry = Find(Key, Hash))
+        return pEntry;
+
+    auto pEntry  = std::make_unique<Entry>();
+    pEntry->Key  = Key;
+    pEntry->Hash = Hash;
+    pEntry->Fill = std::move(Fill);
+    pEntry->Init = std::move(Init);
+    Inserted     = true;
+
+    // keep probe sequences short, past 3/4 the remaining pipelines go to the slow list
+    if (m_Count + 1 > (m_Mask + 1) * 3 / 4)
+    {
+        if (Entry* pOther = FindOverflow(Key, Hash))
+        {
+            Inserted = false;
+            return pOther;
+        }
+        if (m_Overflow.empty())
+            LOG_WARNING_MESSAGE("PipelineStateCache: table is full, consider increasing its capacity (", m_Mask + 1, ")");
+        m_OverflowCount.fetch_add(1, std::memory_order_relaxed);
+        m_Overflow.push_back(std::move(pEntry));
+        return m_Overflow.back().get();
+    }
+
+    size_t i = Hash & m_Mask;
+    while (m_Slots[i].load(std::memory_order_relaxed) != nullptr)
+        i = (i + 1) & m_Mask;
+    m_Count++;
+    // publishes the fully constructed entry to lock-free readers
+    m_Slots[i].store(pEntry.get(), std::memory_order_release);
+    return pEntry.release();
+}
+
+RefCntAutoPtr<IPipelineState> PipelineStateCache::Create(const FillCallback& Fill, const InitCallback& Init)
+{
+    GraphicsPipelineStateCreateInfo CI;
+    Fill(CI);
+    CI.pPSOCache = m_pCache;
+
+    RefCntAutoPtr<IPipelineState> pPSO;
+    m_pDevice->CreateGraphicsPipelineState(CI, &pPSO);
+    if (pPSO && Init)
+        Init(pPSO);
+    return pPSO;
+}
+
+void PipelineStateCache::Build(Entry* pEntry)
+{
+    RefCntAutoPtr<IPipelineState> pPSO = Create(pEntry->Fill, pEntry->Init);
+    if (!pPSO)
+        LOG_ERROR_MESSAGE("PipelineStateCache: failed to create pipeline for program ", pEntry->Key.ProgramId);
+
+    pEntry->pPSO = std::move(pPSO);
+    // the callbacks hold on to shaders, release them now
+    pEntry->Fill = nullptr;
+    pEntry->Init = nullptr;
+    m_Created.fetch_add(1, std::memory_order_relaxed);
+
+    {
+        std::lock_guard<std::mutex> Lock{m_QueueLock};
+        pEntry->Status.store(pEntry->pPSO ? State::Ready : State::Failed, std::memory_order_release);
+    }
+    m_ReadyCondition.notify_all();
+}
+
+void PipelineStateCache::WorkerLoop()
+{
+    for (;;)
+    {
+        Entry* pEntry = nullptr;
+        {
+            std::unique_lock<std::mutex> Lock{m_QueueLock};
+            m_QueueCondition.wait(Lock, [this] { return m_Exit || !m_Queue.empty(); });
+            if (m_Exit)
+                return;
+            pEntry = m_Queue.front();
+            m_Queue.pop_front();
+        }
+        Build(pEntry);
+        m_Pending.fetch_sub(1, std::memory_order_relaxed);
+    }
+}
+
+PipelineStateCache::Entry* PipelineStateCache::Acquire(const PipelineStateKey& Key, FillCallback&& Fill, InitCallback&& Init)
+{
+    const size_t Hash = HashKey(Key);
+    if (Entry* pEntry = Find(Key, Hash))
+        return pEntry;
+
+    bool   Inserted = false;
+    Entry* pEntry   = Insert(Key, Hash, std::move(Fill), std::move(Init), Inserted);
+    if (Inserted)
+    {
+        if (m_Async)
+        {
+            m_Pending.fetch_add(1, std::memory_order_relaxed);
+            {
+                std::lock_guard<std::mutex> Lock{m_QueueLock};
+                m_Queue.push_back(pEntry);
+            }
+            m_QueueCondition.notify_one();
+        }
+        else
+        {
+            Build(pEntry);
+        }
+    }
+    return pEntry;
+}
+
+IPipelineState* PipelineStateCache::Get(const PipelineStateKey& Key) const noexcept
+{
+    m_Lookups.fetch_add(1, std::memory_order_relaxed);
+    const size_t Hash   = HashKey(Key);
+    Entry*       pEntry = Find(Key, Hash);
+    if (pEntry == nullptr && m_OverflowCount.load(std::memory_order_relaxed) != 0)
+    {
+        // only once the table is full, the slow path takes the insertion lock
+        std::lock_guard<std::mutex> Lock{m_InsertLock};
+        pEntry = FindOverflow(Key, Hash);
+    }
+    if (pEntry == nullptr || pEntry->Status.load(std::memory_order_acquire) != State::Ready)
+        return nullptr;
+    m_Hits.fetch_add(1, std::memory_order_relaxed);
+    return pEntry->pPSO;
+}
+
+IPipelineState* PipelineStateCache::GetOrCreateAsync(const PipelineStateKey& Key, FillCallback Fill, InitCallback Init)
+{
+    Entry* const pEntry = Acquire(Key, std::move(Fill), std::move(Init));
+    return pEntry->Status.load(std::memory_order_acquire) == State::Ready ? pEntry->pPSO.RawPtr() : nullptr;
+}
+
+IPipelineState* PipelineStateCache::GetOrCreate(const PipelineStateKey& Key, FillCallback Fill, InitCallback Init)
+{
+    Entry* const pEntry = Acquire(Key, std::move(Fill), std::move(Init));
+    if (pEntry->Status.load(std::memory_order_acquire) == State::Pending)
+    {
+        std::unique_lock<std::mutex> Lock{m_QueueLock};
+        // if the worker didn't get to it yet, don't wait behind the other pipelines
+        auto Pos = std::find(m_Queue.begin(), m_Queue.end(), pEntry);
+        if (Pos != m_Queue.end())
+        {
+            m_Queue.erase(Pos);
+            Lock.unlock();
+            Build(pEntry);
+            m_Pending.fetch_sub(1, std::memory_order_relaxed);
+        }
+        else
+        {
+            m_ReadyCondition.wait(Lock, [pEntry] {
+                return pEntry->Status.load(std::memory_order_relaxed) != State::Pending;
+            });
+        }
+    }
+    return pEntry->Status.load(std::memory_order_acquire) == State::Ready ? pEntry->pPSO.RawPtr() : nullptr;
+}
+
+void PipelineStateCache::Save()
+{
+    if (!m_pCache || m_FilePath.empty())
+        return;
+
+    RefCntAutoPtr<IDataBlob> pData;
+    m_pCache->GetData(&pData);
+    if (!pData || pData->GetSize() == 0)
+        return;
+
+    if (FILE* File = fopen(m_FilePath.c_str(), "wb"))
+    {
+        fwrite(pData->GetConstDataPtr(), 1, pData->GetSize(), File);
+        fclose(File);
+    }
+    else
+    {
+        LOG_WARNING_MESSAGE("PipelineStateCache: can't write ", m_FilePath);
+    }
+}
+
+PipelineStateCache::Stats PipelineStateCache::GetStats() const
+{
+    Stats Result;
+    Result.Lookups         = m_Lookups.load(std::memory_order_relaxed);
+    Result.Hits            = m_Hits.load(std::memory_order_relaxed);
+    Result.Created         = m_Created.load(std::memory_order_relaxed);
+    Result.Pending         = m_Pending.load(std::memory_order_relaxed);
+    Result.Overflow        = m_OverflowCount.load(std::memory_order_relaxed);
+    Result.DiskBytesLoaded = m_DiskBytesLoaded;
+    return Result;
+}
@@ -0,0 +1,212 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "Graphics/GraphicsEngine/interface/RenderDevice.h"
+#include "Graphics/GraphicsEngine/interface/PipelineState.h"
+#include "Graphics/GraphicsEngine/interface/PipelineStateCache.h"
+#include "Graphics/GraphicsEngine/interface/PipelineResourceSignature.h"
+#include "Common/interface/RefCntAutoPtr.hpp"
+
+#include <backend/DriverEnums.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Everything that selects a distinct graphics pipeline for a draw. The key is plain data without
+// padding, so it is hashed and compared as bytes.
+struct PipelineStateKey
+{
+    uint64_t ProgramId       = 0; // backend::Program::getCacheId()
+    uint32_t RasterState     = 0; // backend::RasterState::u
+    uint32_t InputLayoutHash = 0; // InputLayout::Hash, see ComputeInputLayoutHash()
+    uint32_t ResourceLayoutHash = 0; // ResourceSignatureLayout::Hash of the material's layout
+    uint16_t RTVFormats[Diligent::MAX_RENDER_TARGETS] = {};
+    uint16_t DSVFormat         = 0;
+    uint8_t  NumRenderTargets  = 0;
+    uint8_t  PrimitiveTopology = 0;
+    uint8_t  SampleCount       = 1;
+    uint8_t  Reserved[7]       = {};
+
+    bool operator==(const PipelineStateKey& rhs) const noexcept
+    {
+        return memcmp(this, &rhs, sizeof(*this)) == 0;
+    }
+};
+static_assert(std::has_unique_object_representations_v<PipelineStateKey>,
+              "PipelineStateKey must not have padding");
+
+uint32_t ComputeInputLayoutHash(const Diligent::InputLayoutDesc& Layout) noexcept;
+
+// Backend object of a filament VertexBufferInfo. Each attribute has its own buffer slot, the
+// attribute's offset is applied when the buffer is bound.
+struct InputLayout
+{
+    std::vector<Diligent::LayoutElement> Elements;
+    uint32_t                             Hash = 0; // ComputeInputLayoutHash() of the layout
+
+    Diligent::InputLayoutDesc GetDesc() const noexcept
+    {
+        return Diligent::InputLayoutDesc{Elements.data(), static_cast<Diligent::Uint32>(Elements.size())};
+    }
+};
+
+InputLayout ConvertVertexBufferInfo(uint32_t AttributeCount, const filament::backend::AttributeArray& Attributes);
+
+// Backend object of a filament DescriptorSetLayout: the resources of a pipeline resource
+// signature, in binding order. Resource names aren't part of the layout, they're filled from the
+// program's descriptor bindings when the signature is created.
+struct ResourceSignatureLayout
+{
+    std::vector<Diligent::PipelineResourceDesc> Resources;
+    std::vector<uint8_t>                        Bindings; // filament binding of each resource
+    uint64_t                                    DynamicBindings = 0; // bindings with a dynamic offset
+    uint32_t                                    Hash = 0; // identifies the layout in PSO keys
+};
+
+ResourceSignatureLayout ConvertDescriptorSetLayout(const filament::backend::DescriptorSetLayout& Layout);
+
+// Translates a filament RasterState into the rasterizer, depth-stencil and blend states of a
+// Diligent pipeline. FlipWinding accounts for backends whose clip space is y-flipped relative
+// to the one the shaders were written for.
+void ApplyRasterState(filament::backend::RasterState RS, bool FlipWinding,
+                      Diligent::GraphicsPipelineDesc& Desc) noexcept;
+
+// Cache of graphics pipelines keyed by PipelineStateKey.
+//
+// Lookups don't take any lock: the table is open-addressed with a fixed capacity and entries are
+// never removed or moved while the cache is alive. Inserts are serialized by a mutex. Pipelines
+// inserted once the table is full go to an overflow list, which lookups search under that mutex.
+//
+// Pipelines still queued when the cache is destroyed are cancelled.
+//
+// On a miss, GetOrCreateAsync() schedules the creation on a worker thread and returns null until
+// the pipeline is ready, so the caller can keep drawing with whatever it had. Backends that
+// can't create resources from another thread (GL) create synchronously instead.
+//
+// On D3D12 and Vulkan, creation goes through a Diligent IPipelineStateCache, which is loaded
+// from and saved to disk so that warm launches skip the driver's pipeline compilation.
+class PipelineStateCache
+{
+public:
+    // Fills the create info of the pipeline; pPSOCache is set by the cache afterwards.
+    // Called on the worker thread, so it must only use state it owns.
+    using FillCallback = std::function<void(Diligent::GraphicsPipelineStateCreateInfo& CI)>;
+    // Called once the pipeline is created, before it is published (e.g. to bind static variables).
+    using InitCallback = std::function<void(Diligent::IPipelineState* pPSO)>;
+
+    struct Stats
+    {
+        uint32_t Lookups  = 0; // number of Get() calls
+        uint32_t Hits     = 0; // Get() calls that found a ready pipeline
+        uint32_t Created  = 0; // pipelines created
+        uint32_t Pending  = 0; // pipelines currently being created
+        uint32_t Overflow = 0; // pipelines that didn't fit in the lock-free table
+        size_t   DiskBytesLoaded = 0;
+    };
+
+    // FilePath may be null, in which case nothing is persisted. Capacity is rounded up to a
+    // power of two.
+    PipelineStateCache(Diligent::IRenderDevice* pDevice, const char* FilePath, uint32_t Capacity = 1024);
+    ~PipelineStateCache();
+
+    PipelineStateCache(const PipelineStateCache&) = delete;
+    PipelineStateCache& operator=(const PipelineStateCache&) = delete;
+
+    // Returns the pipeline if it is ready, null otherwise. Lock-free unless the table overflowed.
+    Diligent::IPipelineState* Get(const PipelineStateKey& Key) const noexcept;
+
+    // Returns the pipeline if it is ready, null otherwise. On a miss the pipeline is scheduled
+    // for creation.
+    Diligent::IPipelineState* GetOrCreateAsync(const PipelineStateKey& Key, FillCallback Fill, InitCallback Init = {});
+
+    // Returns the pipeline, waiting for or performing its creation if needed.
+    Diligent::IPipelineState* GetOrCreate(const PipelineStateKey& Key, FillCallback Fill, InitCallback Init = {});
+
+    // Writes the serialized pipelines to disk, this is also done at destruction.
+    void Save();
+
+    Stats GetStats() const;
+
+private:
+    enum class State : uint32_t
+    {
+        Pending,
+        Ready,
+        Failed
+    };
+
+    struct Entry
+    {
+        PipelineStateKey                         Key;
+        size_t                                   Hash = 0;
+        Diligent::RefCntAutoPtr<Diligent::IPipelineState> pPSO;
+        std::atomic<State>                       Status{State::Pending};
+        FillCallback                             Fill; // released once the pipeline is built
+        InitCallback                             Init;
+    };
+
+    static size_t HashKey(const PipelineStateKey& Key) noexcept;
+
+    Entry* Find(const PipelineStateKey& Key, size_t Hash) const noexcept;
+    // m_InsertLock must be held
+    Entry* FindOverflow(const PipelineStateKey& Key, size_t Hash) const noexcept;
+    Entry* Acquire(const PipelineStateKey& Key, FillCallback&& Fill, InitCallback&& Init);
+    Entry* Insert(const PipelineStateKey& Key, size_t Hash, FillCallback&& Fill, InitCallback&& Init, bool& Inserted);
+    Diligent::RefCntAutoPtr<Diligent::IPipelineState> Create(const FillCallback& Fill, const InitCallback& Init);
+    void Build(Entry* pEntry);
+    void WorkerLoop();
+
+    Diligent::RefCntAutoPtr<Diligent::IRenderDevice>       m_pDevice;
+    Diligent::RefCntAutoPtr<Diligent::IPipelineStateCache> m_pCache;
+    std::string                                            m_FilePath;
+    bool                                                   m_Async = false;
+
+    std::unique_ptr<std::atomic<Entry*>[]> m_Slots;
+    size_t                                 m_Mask  = 0;
+    size_t                                 m_Count = 0; // guarded by m_InsertLock
+    mutable std::mutex                     m_InsertLock;
+
+    // pipelines that didn't fit in the table, searched linearly under m_InsertLock
+    std::deque<std::unique_ptr<Entry>> m_Overflow;
+
+    std::thread             m_Worker;
+    std::mutex              m_QueueLock;
+    std::condition_variable m_QueueCondition;
+    std::condition_variable m_ReadyCondition;
+    std::deque<Entry*>      m_Queue;
+    bool                    m_Exit = false;
+
+    mutable std::atomic<uint32_t> m_Lookups{0};
+    mutable std::atomic<uint32_t> m_Hits{0};
+    std::atomic<uint32_t> m_Created{0};
+    std::atomic<uint32_t> m_Pending{0};
+    std::atomic<uint32_t> m_OverflowCount{0};
+    size_t                m_DiskBytesLoaded = 0;
+};
@@ -30,7 +30,9 @@ public:
     //      This must be at least 2*requiredSize to avoid blocking on flush, however
     //      because sometimes the display can get ahead of the render() thread, it's good
     //      to set it to 3*requiredSize to avoid blocking the render thread (usually the UI thread).
-    explicit CircularBuffer(size_t bufferSize);
+    // mirror: whether to try mapping the buffer twice back to back, see alloc(). The buffer can
+    //      always fall back to the soft wrap, false forces it.
+    explicit CircularBuffer(size_t bufferSize, bool mirror = true);
 
     // can't be moved or copy-constructed
     CircularBuffer(CircularBuffer const& rhs) = delete;
@@ -42,6 +44,9 @@ public:
 
     static size_t getBlockSize() noexcept { return sPageSize; }
 
+    // Whether the buffer wraps without a copy, see alloc().
+    bool isMirrored() const noexcept { return mMemFd >= 0; }
+
     // Total size of circular buffer. This is a constant.
     size_t size() const noexcept { return mSize; }
 
@@ -72,12 +77,15 @@ public:
     Range getBuffer() noexcept;
 
 private:
-    void* alloc(size_t size) noexcept;
+    void* alloc(size_t size, bool mirror) noexcept;
     void dealloc() noexcept;
 
     // pointer to the beginning of the circular buffer (constant)
     void* mData = nullptr;
-    int mAshmemFd = -1;
+
+    // file descriptor of the memory mapped twice back to back, -1 when the buffer isn't
+    // mirrored (see alloc())
+    int mMemFd = -1;
 
     // size of the circular buffer (constant)
     size_t const mSize;
@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_FILAMENT_BACKEND_PRIVATE_COMMANDBUFFERQUEUE_H
+#define TNT_FILAMENT_BACKEND_PRIVATE_COMMANDBUFFERQUEUE_H
+
+#include "private/backend/CircularBuffer.h"
+
+#include <utils/Condition.h>
+#include <utils/Mutex.h>
+
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace filament::backend {
+
+/*
+ * A producer-consumer command queue that uses a CircularBuffer as main storage.
+ *
+ * The engine thread records commands into the circular buffer and flush() hands the recorded
+ * range to the render thread, which executes it and gives the space back with releaseBuffer().
+ * flush() blocks when less than `requiredSize` bytes are left for the next range.
+ */
+class CommandBufferQueue {
+    CircularBuffer mCircularBuffer;
+    size_t const mRequiredSize;
+
+    mutable utils::Mutex mLock;
+    mutable utils::Condition mCondition;
+    mutable std::vector<CircularBuffer::Range> mCommandBuffersToExecute;
+    size_t mFreeSpace = 0;
+    size_t mHighWatermark = 0;
+    std::chrono::steady_clock::duration mStallTime{};   // flushing thread only
+    uint32_t mIdleFlushCount = 0;                       // flushing thread only
+    uint32_t mExitRequested = 0;
+    bool mPaused = false;
+
+    static constexpr uint32_t EXIT_REQUESTED = 0x31415926;
+
+public:
+    // requiredSize: guaranteed available space after flush()
+    CommandBufferQueue(size_t requiredSize, size_t bufferSize, bool paused);
+    ~CommandBufferQueue();
+
+    CircularBuffer& getCircularBuffer() noexcept { return mCircularBuffer; }
+    CircularBuffer const& getCircularBuffer() const noexcept { return mCircularBuffer; }
+
+    size_t getCapacity() const noexcept { return mRequiredSize; }
+
+    // largest amount of buffer space in use so far
+    size_t getHighWatermark() const noexcept {
+        std::lock_guard<utils::Mutex> const lock(mLock);
+        return mHighWatermark;
+    }
+
+    // Time flush() spent waiting for the render thread to free space, and number of flushes that
+    // found the render thread done with all previous commands, since the last call.
+    // Must be called on the thread calling flush().
+    struct Stats {
+        std::chrono::steady_clock::duration stallTime{};
+        uint32_t idleFlushCount = 0;
+    };
+    Stats resetStats() noexcept;
+
+    // wait for commands to be available and returns an array containing these commands
+    std::vector<CircularBuffer::Range> waitForCommands() const;
+
+    // return the memory used by this command buffer to the circular buffer
+    // WARNING: releaseBuffer() must be called in sequence of the ranges returned by
+    // waitForCommands()
+    void releaseBuffer(CircularBuffer::Range const& buffer);
+
+    // all commands buffers written to this point are returned by waitForCommands(). This
+    // call blocks until the CircularBuffer has at least mRequiredSize bytes available.
+    void flush() noexcept;
+
+    // returns from waitForCommands() immediately.
+    void requestExit();
+
+    // suspend or unsuspend the queue.
+    bool isPaused() const noexcept;
+    void setPaused(bool paused);
+
+    bool isExitRequested() const;
+};
+
+} // namespace filament::backend
+
+#endif // TNT_FILAMENT_BACKEND_PRIVATE_COMMANDBUFFERQUEUE_H
@@ -18,8 +18,8 @@
 #define TNT_FILAMENT_BACKEND_PRIVATE_COMMANDSTREAM_H
 
 #include "private/backend/CircularBuffer.h"
-//#include "private/backend/Dispatcher.h"
 #include "private/backend/Driver.h"
+#include "private/backend/StagingHeap.h"
 
 #include <backend/BufferDescriptor.h>
 #include <backend/BufferObjectStreamDescriptor.h>
@@ -38,7 +38,7 @@
 #include <math/mathfwd.h>
 
 #include <cstddef>
-#include <functional>
+#include <new>
 #include <tuple>
 #include <type_traits>
 #include <utility>
@@ -54,9 +54,113 @@
 // Set to true to print every command out on log.d. This requires RTTI and DEBUG
 #define DEBUG_COMMAND_STREAM false
 
-extern void DiligentCreateProgram(filament::backend::Program&& program);
 namespace filament::backend {
 
+class CommandBase {
+    static constexpr size_t FILAMENT_OBJECT_ALIGNMENT = alignof(std::max_align_t);
+
+protected:
+    // Commands call the driver through its vtable, see Driver.h
+    using Execute = void(*)(Driver& driver, CommandBase* self, intptr_t* next);
+
+    constexpr explicit CommandBase(Execute execute) noexcept : mExecute(execute) {}
+
+public:
+    // alignment of all commands, all command sizes are a multiple of this
+    static constexpr size_t align(size_t v) {
+        return (v + (FILAMENT_OBJECT_ALIGNMENT - 1)) & -FILAMENT_OBJECT_ALIGNMENT;
+    }
+
+    // executes this command and returns the next one
+    inline CommandBase* execute(Driver& driver) {
+        // it is important to call mExecute with the object's address, not the address of
+        // the next command, because the command is destroyed by mExecute.
+        intptr_t next;
+        mExecute(driver, this, &next);
+        return reinterpret_cast<CommandBase*>(reinterpret_cast<intptr_t>(this) + next);
+    }
+
+    inline ~CommandBase() noexcept = default;
+
+private:
+    Execute mExecute;
+};
+
+// ------------------------------------------------------------------------------------------------
+
+template<typename T>
+struct CommandType;
+
+// A command recording the arguments of a driver method, the method is called on the render thread.
+template<typename... ARGS>
+struct CommandType<void (Driver::*)(ARGS...)> {
+    template<void(Driver::*METHOD)(ARGS...)>
+    class Command : public CommandBase {
+        std::tuple<std::remove_reference_t<ARGS>...> mArgs;
+
+        static void execute(Driver& driver, CommandBase* base, intptr_t* next) {
+            Command* const self = static_cast<Command*>(base);
+            *next = align(sizeof(Command));
+            std::apply([&driver](auto&&... args) {
+                (driver.*METHOD)(std::move(args)...);
+            }, std::move(self->mArgs));
+            self->~Command();
+        }
+
+    public:
+        // the arguments are the parameters of the recording method, they're moved from
+        template<typename... A>
+        explicit Command(A&&... args)
+                : CommandBase(&Command::execute), mArgs(std::move(args)...) {
+        }
+
+        // placement new declared as "throw" to avoid the compiler's null-check
+        inline void* operator new(std::size_t, void* ptr) {
+            assert_invariant(ptr);
+            return ptr;
+        }
+    };
+};
+
+// convert a method of "class Driver" into a Command<> type
+#define COMMAND_TYPE(method) CommandType<decltype(&Driver::method)>::Command<&Driver::method>
+
+// ------------------------------------------------------------------------------------------------
+
+// A closure stored in place in the command buffer, see CommandStream::queueCommand().
+template<typename F>
+class CustomCommand : public CommandBase {
+    static_assert(alignof(F) <= alignof(std::max_align_t),
+            "closures can't be more aligned than commands");
+    F mCommand;
+    static void execute(Driver&, CommandBase* base, intptr_t* next) {
+        *next = align(sizeof(CustomCommand));
+        CustomCommand* const self = static_cast<CustomCommand*>(base);
+        self->mCommand();
+        self->~CustomCommand();
+    }
+public:
+    template<typename T>
+    inline explicit CustomCommand(T&& cmd)
+            : CommandBase(execute), mCommand(std::forward<T>(cmd)) { }
+};
+
+// ------------------------------------------------------------------------------------------------
+
+// Skips to `next`, this is used to terminate a command buffer (next == nullptr) and to skip over
+// memory allocated in the stream.
+class NoopCommand : public CommandBase {
+    intptr_t mNext;
+    static void execute(Driver&, CommandBase* self, intptr_t* next) noexcept {
+        *next = static_cast<NoopCommand*>(self)->mNext;
+    }
+public:
+    inline explicit NoopCommand(void* next) noexcept
+            : CommandBase(execute), mNext(intptr_t((char *)next - (char *)this)) { }
+};
+
+// ------------------------------------------------------------------------------------------------
+
 class CommandStream {
     template<typename T>
     struct AutoExecute {
@@ -73,67 +177,57 @@ public:
 
     CircularBuffer const& getCircularBuffer() const noexcept { return mCurrentBuffer; }
 
-	bool isWorkaroundNeeded(Workaround) { return false; }
-	FeatureLevel getFeatureLevel() { return FeatureLevel::FEATURE_LEVEL_3; }
-	math::float2 getClipSpaceParams() { return math::float2{ 1.0f, 0.0f }; }
-	uint8_t getMaxDrawBuffers() {
-        return 16;// MRT::MAX_SUPPORTED_RENDER_TARGET_COUNT;
-	}
-	size_t getMaxUniformBufferSize() { return 65536/*16384u*/; }
-	size_t getMaxTextureSize(SamplerType target) {
-		// NoopDriver is being actively used for other purposes.  This needs to be resolved before we
-		// can change it to 2048. b/406832484
-		return 16384u;
-	}
-	size_t getMaxArrayTextureLayers() { return 256u; }
-	void updateIndexBuffer(Handle<HwIndexBuffer> ibh, BufferDescriptor&& p, uint32_t byteOffset) {}
-	void updateBufferObject(Handle<HwBufferObject> ibh, BufferDescriptor&& p, uint32_t byteOffset) {}
-	void destroyBufferObject(Handle<HwBufferObject> boh) {}
-	void destroyTexture(Handle<HwTexture> th) {}
-	void destroyProgram(Handle<HwProgram> ph) {}
-    backend::ProgramHandle createProgram(backend::Program&& program) { DiligentCreateProgram(std::move(program)); return {}; }
-    backend::BufferObjectHandle createBufferObject(
-        uint32_t byteCount,
-        backend::BufferObjectBinding bindingType,
-        backend::BufferUsage usage) { return {}; }
-    void setDebugTag(backend::HandleBase::HandleId handleId, utils::CString tag) {}
-	bool isStereoSupported() { return false; }
-	bool isParallelShaderCompileSupported() { return false; }
-	void compilePrograms(CompilerPriorityQueue priority, CallbackHandler* handler, CallbackHandler::Callback callback, void* user) {}
-    void registerBufferObjectStreams(Handle<HwBufferObject> boh, BufferObjectStreamDescriptor&& streams) {}
-
-    void updateDescriptorSetBuffer(
-        backend::DescriptorSetHandle dsh,
-        backend::descriptor_binding_t binding,
-        backend::BufferObjectHandle boh,
-        uint32_t offset,
-        uint32_t size
-    ) {}
-    void updateDescriptorSetTexture(
-        backend::DescriptorSetHandle dsh,
-        backend::descriptor_binding_t binding,
-        backend::TextureHandle th,
-        SamplerParams params
-    ) {}
-	backend::DescriptorSetHandle createDescriptorSet(backend::DescriptorSetLayoutHandle dslh) { return {}; }
-    void destroyDescriptorSet(backend::DescriptorSetHandle dsh) {}
-	void bindDescriptorSet(
-		backend::DescriptorSetHandle dsh,
-		backend::descriptor_set_t set,
-		backend::DescriptorSetOffsetArray&& offsets) {}
-	void destroyVertexBuffer(Handle<HwVertexBuffer> vbh) {}
-	void destroyIndexBuffer(Handle<HwIndexBuffer> ibh) {}
-    backend::IndexBufferHandle createIndexBuffer(
-        backend::ElementType elementType,
-        uint32_t indexCount,
-        backend::BufferUsage usage) { return {}; }
-    backend::VertexBufferHandle createVertexBuffer(
-        uint32_t vertexCount,
-        backend::VertexBufferInfoHandle vbih) { return {}; }
-    void setVertexBufferObject(
-        backend::VertexBufferHandle vbh,
-        uint32_t index,
-        backend::BufferObjectHandle bufferObject) {}
+    // payloads larger than this are allocated out of the CircularBuffer, see allocate()
+    static constexpr size_t STAGING_THRESHOLD = 16 * 1024;
+
+    struct Usage {
+        size_t ring = 0;        // bytes recorded in the CircularBuffer
+        size_t staging = 0;     // bytes allocated in the StagingHeap
+    };
+
+    // usage since the last call to resetUsage()
+    Usage getUsage() const noexcept { return mUsage; }
+
+    Usage resetUsage() noexcept { return std::exchange(mUsage, {}); }
+
+#if FILAMENT_DEBUG_COMMANDS > FILAMENT_DEBUG_COMMANDS_NONE
+#   define DEBUG_COMMAND_BEGIN(methodName, sync) mDriver.debugCommandBegin(this, sync, #methodName)
+#   define DEBUG_COMMAND_END(methodName, sync) mDriver.debugCommandEnd(this, sync, #methodName)
+#else
+#   define DEBUG_COMMAND_BEGIN(methodName, sync)
+#   define DEBUG_COMMAND_END(methodName, sync)
+#endif
+
+#define DECL_DRIVER_API(methodName, paramsDecl, params)                                         \
+    inline void methodName(paramsDecl) {                                                        \
+        DEBUG_COMMAND_BEGIN(methodName, false);                                                 \
+        using Cmd = COMMAND_TYPE(methodName);                                                   \
+        void* const p = allocateCommand(CommandBase::align(sizeof(Cmd)));                       \
+        new(p) Cmd(params);                                                                     \
+        DEBUG_COMMAND_END(methodName, false);                                                   \
+    }
+
+#define DECL_DRIVER_API_SYNCHRONOUS(RetType, methodName, paramsDecl, params)                    \
+    inline RetType methodName(paramsDecl) {                                                     \
+        DEBUG_COMMAND_BEGIN(methodName, true);                                                  \
+        AutoExecute callOnExit([=, this](){                                                     \
+            DEBUG_COMMAND_END(methodName, true);                                                \
+        });                                                                                     \
+        return mDriver.methodName(params);                                                      \
+    }
+
+#define DECL_DRIVER_API_RETURN(RetType, methodName, paramsDecl, params)                         \
+    inline RetType methodName(paramsDecl) {                                                     \
+        DEBUG_COMMAND_BEGIN(methodName, false);                                                 \
+        RetType result = mDriver.methodName##S();                                               \
+        using Cmd = COMMAND_TYPE(methodName##R);                                                \
+        void* const p = allocateCommand(CommandBase::align(sizeof(Cmd)));                       \
+        new(p) Cmd(RetType(result), params);                                                    \
+        DEBUG_COMMAND_END(methodName, false);                                                   \
+        return result;                                                                          \
+    }
+
+#include "DriverAPI.inc"
 
 public:
     // This is for debugging only. Currently, CircularBuffer can only be written from a
@@ -149,17 +243,27 @@ public:
 
     /*
      * queueCommand() allows to queue a lambda function as a command.
-     * This is much less efficient than using the Driver* API.
+     * The closure is moved into the command buffer, it's destroyed after it's called.
+     * Closures can't be larger than STAGING_THRESHOLD.
      */
-    void queueCommand(std::function<void()> command);
+    template<typename F, typename = std::enable_if_t<std::is_invocable_v<std::decay_t<F>&>>>
+    inline void queueCommand(F&& command);
 
     /*
      * Allocates memory associated to the current CommandStreamBuffer.
      * This memory will be automatically freed after this command buffer is processed.
+     * Allocations larger than STAGING_THRESHOLD come from the StagingHeap instead, they're
+     * reused after the next call to retireStaging() has been processed.
      * IMPORTANT: Destructors ARE NOT called
      */
     inline void* allocate(size_t size, size_t alignment = 8) noexcept;
 
+    /*
+     * Queues a command giving back the staging memory allocated so far. Must be called after the
+     * commands using it have been recorded, typically when the stream is flushed.
+     */
+    void retireStaging();
+
     /*
      * Helper to allocate an array of trivially destructible objects
      */
@@ -171,14 +275,16 @@ public:
 private:
     inline void* allocateCommand(size_t size) {
         assert_invariant(utils::ThreadUtils::isThisThread(mThreadId));
+        mUsage.ring += size;
         return mCurrentBuffer.allocate(size);
     }
 
-    // We use a copy of Dispatcher (instead of a pointer) because this removes one dereference
-    // when executing driver commands.
+    void* allocateStaging(size_t size, size_t alignment) noexcept;
+
     Driver& UTILS_RESTRICT mDriver;
     CircularBuffer& UTILS_RESTRICT mCurrentBuffer;
-    //Dispatcher mDispatcher;
+    StagingHeap mStagingHeap;
+    Usage mUsage;
 
 #ifndef NDEBUG
     // just for debugging...
@@ -192,7 +298,28 @@ void* CommandStream::allocate(size_t size, size_t alignment) noexcept {
     // make sure alignment is a power of two
     assert_invariant(alignment && !(alignment & alignment-1));
 
-    return (char*)allocateCommand(size);
+    if (UTILS_UNLIKELY(size > STAGING_THRESHOLD)) {
+        return allocateStaging(size, alignment);
+    }
+
+    // The memory is preceded by a NoopCommand which skips over it when the stream is executed.
+    // Commands are aligned to alignof(std::max_align_t), larger alignments need some padding.
+    constexpr size_t commandAlignment = CommandBase::align(1);
+    const size_t padding = alignment > commandAlignment ? alignment - commandAlignment : 0;
+    const size_t s = CommandBase::align(sizeof(NoopCommand) + padding + size);
+    char* const p = (char *)allocateCommand(s);
+    new(p) NoopCommand(p + s);
+    const uintptr_t data = (uintptr_t(p + sizeof(NoopCommand)) + alignment - 1) & ~(alignment - 1);
+    return reinterpret_cast<void*>(data);
+}
+
+template<typename F, typename>
+void CommandStream::queueCommand(F&& command) {
+    using Cmd = CustomCommand<std::decay_t<F>>;
+    // closures are always recorded in place, large captures belong in allocate()'d memory
+    static_assert(sizeof(Cmd) <= STAGING_THRESHOLD,
+            "closure too large for the command stream, capture a pointer to allocate()'d memory");
+    new(allocateCommand(CommandBase::align(sizeof(Cmd)))) Cmd(std::forward<F>(command));
 }
 
 template<typename PodType, typename>
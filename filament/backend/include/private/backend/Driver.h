@@ -17,18 +17,23 @@
 #ifndef TNT_FILAMENT_BACKEND_PRIVATE_DRIVER_H
 #define TNT_FILAMENT_BACKEND_PRIVATE_DRIVER_H
 
+#include <backend/BufferDescriptor.h>
+#include <backend/BufferObjectStreamDescriptor.h>
 #include <backend/CallbackHandler.h>
 #include <backend/DescriptorSetOffsetArray.h>
 #include <backend/DriverApiForward.h>
 #include <backend/DriverEnums.h>
 #include <backend/Handle.h>
 #include <backend/PipelineState.h>
+#include <backend/Program.h>
 // #include <backend/TargetBufferInfo.h>
 // #include <backend/AcquiredImage.h>
 
 #include <utils/CString.h>
 #include <utils/compiler.h>
 
+#include <math/mathfwd.h>
+
 #include <functional>
 
 #include <stddef.h>
@@ -54,9 +59,6 @@ class CallbackHandler;
 class PixelBufferDescriptor;
 class Program;
 
-template<typename T>
-class ConcreteDispatcher;
-class Dispatcher;
 class CommandStream;
 
 class Driver {
@@ -81,10 +83,6 @@ public:
     // interface with MSL.
     virtual ShaderLanguage getShaderLanguage() const noexcept = 0;
 
-    // Returns the dispatcher. This is only called once during initialization of the CommandStream,
-    // so it doesn't matter that it's virtual.
-    virtual Dispatcher getDispatcher() const noexcept = 0;
-
     // called from CommandStream::execute on the render-thread
     // the fn function will execute a batch of driver commands
     // this gives the driver a chance to wrap their execution in a meaningful manner
@@ -99,23 +97,24 @@ public:
             bool synchronous, const char* methodName) noexcept = 0;
 
     /*
-     * Asynchronous calls here only to provide a type to CommandStream. They must be non-virtual
-     * so that calling the concrete implementation won't go through a vtable.
+     * There is no Dispatcher in this backend: asynchronous calls are virtual and commands
+     * recorded in the CommandStream call the concrete implementation through the vtable, on the
+     * render thread.
      *
      * Synchronous calls are virtual and are called directly by CommandStream.
      */
 
 #define DECL_DRIVER_API(methodName, paramsDecl, params) \
-    void methodName(paramsDecl) {}
+    virtual void methodName(paramsDecl) = 0;
 
 #define DECL_DRIVER_API_SYNCHRONOUS(RetType, methodName, paramsDecl, params) \
     virtual RetType methodName(paramsDecl) = 0;
 
 #define DECL_DRIVER_API_RETURN(RetType, methodName, paramsDecl, params) \
     virtual RetType methodName##S() noexcept = 0; \
-    void methodName##R(RetType, paramsDecl) {}
+    virtual void methodName##R(RetType, paramsDecl) = 0;
 
-//#include "private/backend/DriverAPI.inc"
+#include "private/backend/DriverAPI.inc"
 };
 
 } // namespace filament::backend
@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_FILAMENT_BACKEND_PRIVATE_SECONDARYCOMMANDSTREAMS_H
+#define TNT_FILAMENT_BACKEND_PRIVATE_SECONDARYCOMMANDSTREAMS_H
+
+#include "private/backend/CircularBuffer.h"
+#include "private/backend/CommandStream.h"
+
+#include <utils/Condition.h>
+#include <utils/Mutex.h>
+
+#include <memory>
+#include <vector>
+
+#include <stddef.h>
+
+namespace filament::backend {
+
+class Driver;
+
+/*
+ * Command streams that jobs record into in parallel, each with its own CircularBuffer.
+ *
+ * Streams are identified by an index chosen by the caller (e.g. the index of a chunk of work),
+ * not by the thread recording them. submit() appends them to the primary stream in index order,
+ * so the commands execute in the same order regardless of how the jobs were scheduled.
+ *
+ * The secondary commands aren't copied: the primary stream gets a command that executes them in
+ * place on the render thread and gives their space back afterward.
+ */
+class SecondaryCommandStreams {
+public:
+    // requiredSize: space guaranteed to be available in a stream returned by acquire()
+    // bufferSize: size of each stream's CircularBuffer
+    SecondaryCommandStreams(Driver& driver, size_t requiredSize, size_t bufferSize);
+    ~SecondaryCommandStreams() noexcept;
+
+    SecondaryCommandStreams(SecondaryCommandStreams const& rhs) = delete;
+    SecondaryCommandStreams& operator=(SecondaryCommandStreams const& rhs) = delete;
+
+    // Returns the stream of `index`, waiting for the render thread to free enough space in it.
+    // Called on the engine thread, before the jobs are started. A stream must only be recorded
+    // by one thread at a time, which must call debugThreading() first.
+    CommandStream& acquire(size_t index);
+
+    // Appends all the recorded streams to `primary`, in index order. Called on the engine thread,
+    // once the jobs have finished. The primary stream must be flushed before the next acquire()
+    // of these streams, or that could wait forever.
+    void submit(CommandStream& primary);
+
+private:
+    struct Stream {
+        Stream(Driver& driver, size_t bufferSize);
+        CircularBuffer buffer;
+        CommandStream stream;
+        size_t inFlight = 0;    // submitted but not executed yet, guarded by mLock
+    };
+
+    void release(Stream& stream, size_t size) noexcept;
+
+    Driver& mDriver;
+    size_t const mRequiredSize;
+    size_t const mBufferSize;
+    std::vector<std::unique_ptr<Stream>> mStreams;
+
+    utils::Mutex mLock;
+    utils::Condition mCondition;
+};
+
+} // namespace filament::backend
+
+#endif // TNT_FILAMENT_BACKEND_PRIVATE_SECONDARYCOMMANDSTREAMS_H
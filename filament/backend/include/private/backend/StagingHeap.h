@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_FILAMENT_BACKEND_PRIVATE_STAGINGHEAP_H
+#define TNT_FILAMENT_BACKEND_PRIVATE_STAGINGHEAP_H
+
+#include <utils/compiler.h>
+#include <utils/Mutex.h>
+
+#include <vector>
+
+#include <stddef.h>
+
+namespace filament::backend {
+
+/*
+ * Memory for the command stream's payloads that are too large for the CircularBuffer.
+ *
+ * Allocations are carved linearly out of BLOCK_SIZE blocks; larger ones get a block of their own.
+ * The blocks used since the last retire() are handed to a command, which gives them back with
+ * recycle() on the render thread once the commands before it, and so the payloads, are consumed.
+ *
+ * allocate() and retire() must be called from the thread recording the commands.
+ */
+class StagingHeap {
+public:
+    static constexpr size_t BLOCK_SIZE = 1024 * 1024;
+
+    struct Block {
+        void* data;
+        size_t size;
+    };
+    using Blocks = std::vector<Block>;
+
+    StagingHeap() noexcept = default;
+    ~StagingHeap() noexcept;
+
+    StagingHeap(StagingHeap const& rhs) = delete;
+    StagingHeap& operator=(StagingHeap const& rhs) = delete;
+
+    void* allocate(size_t size, size_t alignment) noexcept;
+
+    // true if anything was allocated since the last retire()
+    bool empty() const noexcept { return mUsed.empty(); }
+
+    // detaches the blocks allocated since the last call
+    Blocks retire() noexcept;
+
+    // thread-safe, gives back blocks returned by retire()
+    void recycle(Blocks&& blocks) noexcept;
+
+private:
+    static Block alloc(size_t size) noexcept;
+    static void free(Block block) noexcept;
+
+    Blocks mUsed;               // the last one is the current block
+    size_t mOffset = 0;         // offset of the free space in the current block
+
+    utils::Mutex mLock;
+    Blocks mFree;               // only blocks of BLOCK_SIZE, guarded by mLock
+};
+
+} // namespace filament::backend
+
+#endif // TNT_FILAMENT_BACKEND_PRIVATE_STAGINGHEAP_H
@@ -0,0 +1,150 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "private/backend/CircularBuffer.h"
+
+#include <utils/compiler.h>
+#include <utils/debug.h>
+#include <utils/Log.h>
+#include <utils/Panic.h>
+
+#if !defined(WIN32) && !defined(__EMSCRIPTEN__)
+#    include <sys/mman.h>
+#    include <unistd.h>
+#    define HAS_MMAP 1
+#else
+#    define HAS_MMAP 0
+#endif
+
+#if defined(__linux__) && !defined(__ANDROID__)
+#    define HAS_MEMFD 1
+#else
+#    define HAS_MEMFD 0
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+namespace filament::backend {
+
+size_t CircularBuffer::sPageSize =
+#if HAS_MMAP
+        size_t(sysconf(_SC_PAGESIZE));
+#else
+        4096;
+#endif
+
+CircularBuffer::CircularBuffer(size_t size, bool mirror)
+        : mSize(size) {
+    mData = alloc(size, mirror);
+    mTail = mData;
+    mHead = mData;
+}
+
+CircularBuffer::~CircularBuffer() noexcept {
+    dealloc();
+}
+
+// On Linux, the buffer is a memfd mapped twice back to back: whatever is written past the end
+// of the first mapping shows up at the beginning of the buffer, so the ring wraps without a copy
+// and without wasting memory.
+//
+// Otherwise, if that fails or mirror is false, the buffer is "soft" circular: it is twice as large
+// as needed, so that a range that starts anywhere in the first half always fits. When the head
+// crosses into the second half, the next range starts over at the beginning (see getBuffer()).
+void* CircularBuffer::alloc(size_t size, UTILS_UNUSED bool mirror) noexcept {
+#if HAS_MEMFD
+    if (mirror) {
+        assert_invariant(!(size & (sPageSize - 1)));
+        int const fd = memfd_create("filament::CircularBuffer", MFD_CLOEXEC);
+        if (fd >= 0 && ftruncate(fd, off_t(size)) == 0) {
+            // reserve the address space of both copies and of the trailing guard page
+            void* const vaddr = mmap(nullptr, size * 2 + sPageSize,
+                    PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (vaddr != MAP_FAILED) {
+                void* const first = mmap(vaddr, size,
+                        PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0);
+                void* const second = mmap((char*)vaddr + size, size,
+                        PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0);
+                if (first == vaddr && second == (char*)vaddr + size) {
+                    mMemFd = fd;
+                    return vaddr;
+                }
+                munmap(vaddr, size * 2 + sPageSize);
+            }
+        }
+        if (fd >= 0) {
+            close(fd);
+        }
+        utils::slog.w << "CircularBuffer: couldn't mirror the command buffer, using soft wrap"
+                      << utils::io::endl;
+    }
+#endif
+
+#if HAS_MMAP
+    // the trailing guard page catches overflows of the stream
+    void* const data = mmap(nullptr, size * 2 + sPageSize,
+            PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    FILAMENT_CHECK_POSTCONDITION(data != MAP_FAILED)
+            << "couldn't allocate " << (size * 2 / 1024) << " KiB of memory for the command buffer";
+    UTILS_UNUSED_IN_RELEASE int const err =
+            mprotect((char*)data + size * 2, sPageSize, PROT_NONE);
+    assert_invariant(!err);
+    return data;
+#else
+    void* const data = ::malloc(size * 2);
+    FILAMENT_CHECK_POSTCONDITION(data)
+            << "couldn't allocate " << (size * 2 / 1024) << " KiB of memory for the command buffer";
+    return data;
+#endif
+}
+
+void CircularBuffer::dealloc() noexcept {
+#if HAS_MMAP
+    if (mData) {
+        munmap(mData, mSize * 2 + sPageSize);
+    }
+    if (mMemFd >= 0) {
+        close(mMemFd);
+        mMemFd = -1;
+    }
+#else
+    ::free(mData);
+#endif
+    mData = nullptr;
+}
+
+CircularBuffer::Range CircularBuffer::getBuffer() noexcept {
+    Range const range{ .tail = mTail, .head = mHead };
+
+    char* const pData = static_cast<char*>(mData);
+    char const* const pHead = static_cast<char const*>(mHead);
+    if (UTILS_UNLIKELY(pHead >= pData + mSize)) {
+        if (UTILS_LIKELY(mMemFd >= 0)) {
+            // the data past the end is mirrored at the beginning, wrap the head with it
+            mHead = pData + (pHead - (pData + mSize));
+        } else {
+            // the head crossed into the second half, restart at the beginning
+            mHead = mData;
+        }
+    }
+    mTail = mHead;
+
+    return range;
+}
+
+} // namespace filament::backend
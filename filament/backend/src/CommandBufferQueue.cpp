@@ -0,0 +1,150 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "private/backend/CommandBufferQueue.h"
+#include "private/backend/CircularBuffer.h"
+#include "private/backend/CommandStream.h"
+
+#include <utils/compiler.h>
+#include <utils/debug.h>
+#include <utils/Mutex.h>
+#include <utils/Panic.h>
+
+#include <algorithm>
+#include <chrono>
+#include <iterator>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+
+using namespace utils;
+
+namespace filament::backend {
+
+CommandBufferQueue::CommandBufferQueue(size_t requiredSize, size_t bufferSize, bool paused)
+        : mCircularBuffer(bufferSize),
+          mRequiredSize((requiredSize + (CircularBuffer::getBlockSize() - 1u)) &
+                  ~(CircularBuffer::getBlockSize() - 1u)),
+          mFreeSpace(mCircularBuffer.size()),
+          mPaused(paused) {
+    assert_invariant(mCircularBuffer.size() > requiredSize);
+}
+
+CommandBufferQueue::~CommandBufferQueue() {
+    assert_invariant(mCommandBuffersToExecute.empty());
+}
+
+void CommandBufferQueue::requestExit() {
+    std::lock_guard<utils::Mutex> const lock(mLock);
+    mExitRequested = EXIT_REQUESTED;
+    mCondition.notify_one();
+}
+
+bool CommandBufferQueue::isPaused() const noexcept {
+    std::lock_guard<utils::Mutex> const lock(mLock);
+    return mPaused;
+}
+
+void CommandBufferQueue::setPaused(bool paused) {
+    std::lock_guard<utils::Mutex> const lock(mLock);
+    if (paused) {
+        mPaused = true;
+    } else {
+        mPaused = false;
+        mCondition.notify_one();
+    }
+}
+
+bool CommandBufferQueue::isExitRequested() const {
+    std::lock_guard<utils::Mutex> const lock(mLock);
+    FILAMENT_CHECK_POSTCONDITION(!mExitRequested || mExitRequested == EXIT_REQUESTED)
+            << "mExitRequested is corrupted (value = 0x" << io::hex << mExitRequested << ")!";
+    return bool(mExitRequested);
+}
+
+void CommandBufferQueue::flush() noexcept {
+    CircularBuffer& circularBuffer = mCircularBuffer;
+    if (circularBuffer.empty()) {
+        return;
+    }
+
+    // add the terminating command
+    // always guaranteed to have enough space for the NoopCommand
+    new(circularBuffer.allocate(sizeof(NoopCommand))) NoopCommand(nullptr);
+
+    size_t const requiredSize = mRequiredSize;
+
+    // get the current buffer
+    auto const [tail, head] = circularBuffer.getBuffer();
+
+    assert_invariant(circularBuffer.empty());
+
+    // size of the current buffer
+    size_t const used = std::distance(
+            static_cast<char const*>(tail), static_cast<char const*>(head));
+
+    std::unique_lock<utils::Mutex> lock(mLock);
+
+    // circular buffer is too small, we corrupted the stream
+    FILAMENT_CHECK_POSTCONDITION(used <= mFreeSpace)
+            << "Backend CommandStream overflow. Commands are corrupted and unrecoverable.\n"
+               "Please increase minCommandBufferSizeMB inside the Config passed to Engine::create.\n"
+               "Space used at this time: " << used << " bytes, overflow: "
+            << used - mFreeSpace << " bytes";
+
+    // the render thread released everything, it's waiting for these commands
+    if (mFreeSpace == mCircularBuffer.size()) {
+        mIdleFlushCount++;
+    }
+
+    mCommandBuffersToExecute.push_back({ tail, head });
+    mCondition.notify_one();
+
+    // wait until there is enough space in the buffer
+    mFreeSpace -= used;
+    mHighWatermark = std::max(mHighWatermark, mCircularBuffer.size() - mFreeSpace);
+    if (UTILS_UNLIKELY(mFreeSpace < requiredSize)) {
+        auto const start = std::chrono::steady_clock::now();
+        mCondition.wait(lock, [this, requiredSize]() -> bool {
+            // TODO: on macOS, we need to call pumpEvents from time to time
+            return mFreeSpace >= requiredSize;
+        });
+        mStallTime += std::chrono::steady_clock::now() - start;
+    }
+}
+
+CommandBufferQueue::Stats CommandBufferQueue::resetStats() noexcept {
+    return { std::exchange(mStallTime, {}), std::exchange(mIdleFlushCount, 0) };
+}
+
+std::vector<CircularBuffer::Range> CommandBufferQueue::waitForCommands() const {
+    std::unique_lock<utils::Mutex> lock(mLock);
+    while ((mCommandBuffersToExecute.empty() || mPaused) && !mExitRequested) {
+        mCondition.wait(lock);
+    }
+    return std::move(mCommandBuffersToExecute);
+}
+
+void CommandBufferQueue::releaseBuffer(CircularBuffer::Range const& buffer) {
+    std::lock_guard<utils::Mutex> const lock(mLock);
+    mFreeSpace += uintptr_t(buffer.head) - uintptr_t(buffer.tail);
+    mCondition.notify_one();
+}
+
+} // namespace filament::backend
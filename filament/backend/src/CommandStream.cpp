@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "private/backend/CommandStream.h"
+
+#include "private/backend/CircularBuffer.h"
+#include "private/backend/Driver.h"
+#include "private/backend/StagingHeap.h"
+
+#include <utils/compiler.h>
+#include <utils/debug.h>
+#include <utils/ThreadUtils.h>
+
+#include <utility>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace filament::backend {
+
+CommandStream::CommandStream(Driver& driver, CircularBuffer& buffer) noexcept
+        : mDriver(driver),
+          mCurrentBuffer(buffer) {
+}
+
+void CommandStream::execute(void* buffer) {
+    Driver& UTILS_RESTRICT driver = mDriver;
+    driver.execute([&driver, buffer]() {
+        CommandBase* UTILS_RESTRICT base = static_cast<CommandBase*>(buffer);
+        while (UTILS_LIKELY(base)) {
+            base = base->execute(driver);
+        }
+    });
+}
+
+void* CommandStream::allocateStaging(size_t const size, size_t const alignment) noexcept {
+    assert_invariant(utils::ThreadUtils::isThisThread(mThreadId));
+    mUsage.staging += size;
+    return mStagingHeap.allocate(size, alignment);
+}
+
+void CommandStream::retireStaging() {
+    if (mStagingHeap.empty()) {
+        return;
+    }
+    queueCommand([this, blocks = mStagingHeap.retire()]() mutable {
+        mStagingHeap.recycle(std::move(blocks));
+    });
+}
+
+} // namespace filament::backend
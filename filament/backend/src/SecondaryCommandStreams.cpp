@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "private/backend/SecondaryCommandStreams.h"
+
+#include "private/backend/CircularBuffer.h"
+#include "private/backend/CommandStream.h"
+#include "private/backend/Driver.h"
+
+#include <utils/compiler.h>
+#include <utils/debug.h>
+#include <utils/Mutex.h>
+#include <utils/Panic.h>
+
+#include <memory>
+#include <mutex>
+#include <new>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace filament::backend {
+
+SecondaryCommandStreams::Stream::Stream(Driver& driver, size_t const bufferSize)
+        : buffer(bufferSize),
+          stream(driver, buffer) {
+}
+
+SecondaryCommandStreams::SecondaryCommandStreams(Driver& driver,
+        size_t const requiredSize, size_t const bufferSize)
+        : mDriver(driver),
+          mRequiredSize(requiredSize),
+          mBufferSize(bufferSize) {
+    assert_invariant(bufferSize > requiredSize);
+}
+
+SecondaryCommandStreams::~SecondaryCommandStreams() noexcept {
+#ifndef NDEBUG
+    for (auto const& stream : mStreams) {
+        assert_invariant(stream->buffer.empty() && !stream->inFlight);
+    }
+#endif
+}
+
+CommandStream& SecondaryCommandStreams::acquire(size_t const index) {
+    if (UTILS_UNLIKELY(index >= mStreams.size())) {
+        mStreams.resize(index + 1);
+    }
+    if (UTILS_UNLIKELY(!mStreams[index])) {
+        mStreams[index] = std::make_unique<Stream>(mDriver, mBufferSize);
+    }
+
+    Stream& stream = *mStreams[index];
+    size_t const available = mBufferSize - mRequiredSize;
+    std::unique_lock<utils::Mutex> lock(mLock);
+    mCondition.wait(lock, [&stream, available]() -> bool {
+        return stream.inFlight + stream.buffer.getUsed() <= available;
+    });
+    return stream.stream;
+}
+
+void SecondaryCommandStreams::submit(CommandStream& primary) {
+    for (auto const& item : mStreams) {
+        if (!item || item->buffer.empty()) {
+            continue;
+        }
+        Stream& stream = *item;
+
+        // the job is done with this stream, give its staging memory back once it's executed
+        stream.stream.debugThreading();
+        stream.stream.retireStaging();
+
+        // terminate the secondary commands, the primary stream resumes after them
+        CircularBuffer& buffer = stream.buffer;
+        new(buffer.allocate(sizeof(NoopCommand))) NoopCommand(nullptr);
+        auto const [tail, head] = buffer.getBuffer();
+        size_t const used = uintptr_t(head) - uintptr_t(tail);
+
+        {
+            std::lock_guard<utils::Mutex> const lock(mLock);
+            FILAMENT_CHECK_POSTCONDITION(stream.inFlight + used <= mBufferSize)
+                    << "Secondary CommandStream overflow. Commands are corrupted and "
+                       "unrecoverable. Space used: " << used << " bytes";
+            stream.inFlight += used;
+        }
+
+        primary.queueCommand([this, &stream, tail = tail, used]() {
+            stream.stream.execute(tail);
+            release(stream, used);
+        });
+    }
+}
+
+void SecondaryCommandStreams::release(Stream& stream, size_t const size) noexcept {
+    std::lock_guard<utils::Mutex> const lock(mLock);
+    assert_invariant(stream.inFlight >= size);
+    stream.inFlight -= size;
+    mCondition.notify_all();
+}
+
+} // namespace filament::backend
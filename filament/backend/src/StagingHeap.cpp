@@ -0,0 +1,118 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "private/backend/StagingHeap.h"
+
+#include <utils/compiler.h>
+#include <utils/debug.h>
+#include <utils/memalign.h>
+#include <utils/Mutex.h>
+#include <utils/Panic.h>
+
+#include <algorithm>
+#include <mutex>
+#include <utility>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace filament::backend {
+
+// large enough for any SIMD type, the address of each allocation is aligned individually
+static constexpr size_t BLOCK_ALIGNMENT = 64;
+
+StagingHeap::~StagingHeap() noexcept {
+    for (Block const& block : mUsed) {
+        free(block);
+    }
+    for (Block const& block : mFree) {
+        free(block);
+    }
+}
+
+StagingHeap::Block StagingHeap::alloc(size_t const size) noexcept {
+    void* const data = utils::aligned_alloc(size, BLOCK_ALIGNMENT);
+    FILAMENT_CHECK_POSTCONDITION(data)
+            << "couldn't allocate " << (size / 1024) << " KiB of staging memory";
+    return { data, size };
+}
+
+void StagingHeap::free(Block const block) noexcept {
+    utils::aligned_free(block.data);
+}
+
+void* StagingHeap::allocate(size_t const size, size_t const alignment) noexcept {
+    assert_invariant(alignment && !(alignment & (alignment - 1)));
+
+    if (UTILS_UNLIKELY(size + alignment > BLOCK_SIZE / 2)) {
+        // too large to share a block, insert it before the current block so we keep filling it
+        Block const block = alloc(std::max(size, size_t(1)) + std::max(alignment, BLOCK_ALIGNMENT));
+        mUsed.insert(mUsed.empty() ? mUsed.end() : mUsed.end() - 1, block);
+        if (mUsed.size() == 1) {
+            // there is no current block, make sure the next allocation doesn't carve this one
+            mOffset = block.size;
+        }
+        uintptr_t const p = (uintptr_t(block.data) + alignment - 1) & ~(alignment - 1);
+        return reinterpret_cast<void*>(p);
+    }
+
+    uintptr_t p = 0;
+    if (!mUsed.empty()) {
+        Block const& current = mUsed.back();
+        p = (uintptr_t(current.data) + mOffset + alignment - 1) & ~(alignment - 1);
+        if (UTILS_UNLIKELY(p + size > uintptr_t(current.data) + current.size)) {
+            p = 0;
+        }
+    }
+
+    if (UTILS_UNLIKELY(!p)) {
+        Block block{};
+        std::unique_lock<utils::Mutex> lock(mLock);
+        if (!mFree.empty()) {
+            block = mFree.back();
+            mFree.pop_back();
+            lock.unlock();
+        } else {
+            lock.unlock();
+            block = alloc(BLOCK_SIZE);
+        }
+        mUsed.push_back(block);
+        p = (uintptr_t(block.data) + alignment - 1) & ~(alignment - 1);
+    }
+
+    Block const& current = mUsed.back();
+    mOffset = p + size - uintptr_t(current.data);
+    return reinterpret_cast<void*>(p);
+}
+
+StagingHeap::Blocks StagingHeap::retire() noexcept {
+    mOffset = 0;
+    return std::exchange(mUsed, {});
+}
+
+void StagingHeap::recycle(Blocks&& blocks) noexcept {
+    std::lock_guard<utils::Mutex> const lock(mLock);
+    for (Block const& block : blocks) {
+        if (block.size == BLOCK_SIZE) {
+            mFree.push_back(block);
+        } else {
+            free(block);
+        }
+    }
+    blocks.clear();
+}
+
+} // namespace filament::backend
@@ -0,0 +1,321 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "DiligentDriver.h"
+
+#include "private/backend/CommandStream.h"
+
+#include <backend/BufferDescriptor.h>
+#include <backend/BufferObjectStreamDescriptor.h>
+#include <backend/CallbackHandler.h>
+#include <backend/DescriptorSetOffsetArray.h>
+#include <backend/DriverEnums.h>
+#include <backend/Handle.h>
+#include <backend/Program.h>
+
+#include <utils/CString.h>
+#include <utils/compiler.h>
+#include <utils/debug.h>
+#include <utils/Mutex.h>
+
+#include <math/vec2.h>
+
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace filament::backend {
+
+Driver* DiligentDriver::create() {
+    return new DiligentDriver();
+}
+
+DiligentDriver::DiligentDriver() noexcept = default;
+
+DiligentDriver::~DiligentDriver() noexcept = default;
+
+void DiligentDriver::purge() noexcept {
+    std::vector<std::pair<void*, CallbackHandler::Callback>> callbacks;
+    std::unique_lock<utils::Mutex> lock(mPurgeLock);
+    std::swap(callbacks, mServiceThreadCallbackQueue);
+    lock.unlock();
+    for (auto& item : callbacks) {
+        item.second(item.first);
+    }
+}
+
+ShaderModel DiligentDriver::getShaderModel() const noexcept {
+    return ShaderModel::DESKTOP;
+}
+
+ShaderLanguage DiligentDriver::getShaderLanguage() const noexcept {
+    return ShaderLanguage::ESSL3;
+}
+
+void DiligentDriver::debugCommandBegin(CommandStream*, bool, const char*) noexcept {
+}
+
+void DiligentDriver::debugCommandEnd(CommandStream*, bool, const char*) noexcept {
+}
+
+HandleBase::HandleId DiligentDriver::allocateHandle() noexcept {
+    std::lock_guard<utils::Mutex> const lock(mHandleLock);
+    if (!mFreeHandles.empty()) {
+        HandleBase::HandleId const id = mFreeHandles.back();
+        mFreeHandles.pop_back();
+        return id;
+    }
+    assert_invariant(mNextHandle != HandleBase::nullid);
+    return mNextHandle++;
+}
+
+void DiligentDriver::freeHandle(HandleBase::HandleId const id) noexcept {
+    if (id != HandleBase::nullid) {
+        std::lock_guard<utils::Mutex> const lock(mHandleLock);
+        mFreeHandles.push_back(id);
+    }
+}
+
+void DiligentDriver::scheduleCallback(CallbackHandler* handler, void* user,
+        CallbackHandler::Callback callback) {
+    if (handler) {
+        handler->post(user, callback);
+    } else {
+        std::lock_guard<utils::Mutex> const lock(mPurgeLock);
+        mServiceThreadCallbackQueue.emplace_back(user, callback);
+    }
+}
+
+// ------------------------------------------------------------------------------------------------
+// Creating driver objects
+// ------------------------------------------------------------------------------------------------
+
+BufferObjectHandle DiligentDriver::createBufferObjectS() noexcept {
+    return BufferObjectHandle{ allocateHandle() };
+}
+
+IndexBufferHandle DiligentDriver::createIndexBufferS() noexcept {
+    return IndexBufferHandle{ allocateHandle() };
+}
+
+VertexBufferInfoHandle DiligentDriver::createVertexBufferInfoS() noexcept {
+    return VertexBufferInfoHandle{ allocateHandle() };
+}
+
+VertexBufferHandle DiligentDriver::createVertexBufferS() noexcept {
+    return VertexBufferHandle{ allocateHandle() };
+}
+
+ProgramHandle DiligentDriver::createProgramS() noexcept {
+    return ProgramHandle{ allocateHandle() };
+}
+
+DescriptorSetLayoutHandle DiligentDriver::createDescriptorSetLayoutS() noexcept {
+    return DescriptorSetLayoutHandle{ allocateHandle() };
+}
+
+DescriptorSetHandle DiligentDriver::createDescriptorSetS() noexcept {
+    return DescriptorSetHandle{ allocateHandle() };
+}
+
+void DiligentDriver::createBufferObjectR(BufferObjectHandle boh,
+        uint32_t byteCount, BufferObjectBinding bindingType, BufferUsage usage) {
+    DiligentCreateBuffer(boh.getId(), byteCount, bindingType, usage);
+}
+
+void DiligentDriver::createIndexBufferR(IndexBufferHandle ibh,
+        ElementType elementType, uint32_t indexCount, BufferUsage usage) {
+    DiligentCreateIndexBuffer(ibh.getId(),
+            uint32_t(getElementTypeSize(elementType) * indexCount), usage);
+}
+
+void DiligentDriver::createVertexBufferInfoR(VertexBufferInfoHandle vbih,
+        uint8_t bufferCount, uint8_t attributeCount, AttributeArray attributes) {
+    DiligentCreateVertexBufferInfo(vbih.getId(), bufferCount, attributeCount, attributes);
+}
+
+void DiligentDriver::createVertexBufferR(VertexBufferHandle, uint32_t, VertexBufferInfoHandle) {
+}
+
+void DiligentDriver::createProgramR(ProgramHandle ph, Program&& program) {
+    DiligentCreateProgram(ph.getId(), std::move(program));
+}
+
+void DiligentDriver::createDescriptorSetLayoutR(DescriptorSetLayoutHandle dslh,
+        DescriptorSetLayout&& info) {
+    DiligentCreateDescriptorSetLayout(dslh.getId(), std::move(info));
+}
+
+void DiligentDriver::createDescriptorSetR(DescriptorSetHandle dsh, DescriptorSetLayoutHandle dslh) {
+    DiligentCreateDescriptorSet(dsh.getId(), dslh.getId());
+}
+
+// ------------------------------------------------------------------------------------------------
+// Destroying driver objects
+// ------------------------------------------------------------------------------------------------
+
+void DiligentDriver::destroyBufferObject(BufferObjectHandle boh) {
+    if (boh) {
+        DiligentDestroyBuffer(boh.getId());
+        freeHandle(boh.getId());
+    }
+}
+
+void DiligentDriver::destroyIndexBuffer(IndexBufferHandle ibh) {
+    if (ibh) {
+        DiligentDestroyBuffer(ibh.getId());
+        freeHandle(ibh.getId());
+    }
+}
+
+void DiligentDriver::destroyVertexBufferInfo(VertexBufferInfoHandle vbih) {
+    if (vbih) {
+        DiligentDestroyVertexBufferInfo(vbih.getId());
+        freeHandle(vbih.getId());
+    }
+}
+
+void DiligentDriver::destroyVertexBuffer(VertexBufferHandle vbh) {
+    freeHandle(vbh.getId());
+}
+
+void DiligentDriver::destroyProgram(ProgramHandle ph) {
+    if (ph) {
+        DiligentDestroyProgram(ph.getId());
+        freeHandle(ph.getId());
+    }
+}
+
+void DiligentDriver::destroyTexture(TextureHandle th) {
+    // textures aren't created through this driver yet, see updateDescriptorSetTexture()
+    freeHandle(th.getId());
+}
+
+void DiligentDriver::destroyDescriptorSetLayout(DescriptorSetLayoutHandle dslh) {
+    if (dslh) {
+        DiligentDestroyDescriptorSetLayout(dslh.getId());
+        freeHandle(dslh.getId());
+    }
+}
+
+void DiligentDriver::destroyDescriptorSet(DescriptorSetHandle dsh) {
+    if (dsh) {
+        DiligentDestroyDescriptorSet(dsh.getId());
+        freeHandle(dsh.getId());
+    }
+}
+
+// ------------------------------------------------------------------------------------------------
+// Synchronous APIs
+// ------------------------------------------------------------------------------------------------
+
+bool DiligentDriver::isWorkaroundNeeded(Workaround) {
+    return false;
+}
+
+FeatureLevel DiligentDriver::getFeatureLevel() {
+    return FeatureLevel::FEATURE_LEVEL_3;
+}
+
+math::float2 DiligentDriver::getClipSpaceParams() {
+    return math::float2{ 1.0f, 0.0f };
+}
+
+uint8_t DiligentDriver::getMaxDrawBuffers() {
+    return 16;// MRT::MAX_SUPPORTED_RENDER_TARGET_COUNT;
+}
+
+size_t DiligentDriver::getMaxUniformBufferSize() {
+    return 65536;
+}
+
+size_t DiligentDriver::getMaxTextureSize(SamplerType) {
+    return 16384u;
+}
+
+size_t DiligentDriver::getMaxArrayTextureLayers() {
+    return 256u;
+}
+
+bool DiligentDriver::isStereoSupported() {
+    return false;
+}
+
+bool DiligentDriver::isParallelShaderCompileSupported() {
+    // compilePrograms() calls back once the application has created the programs
+    return true;
+}
+
+// ------------------------------------------------------------------------------------------------
+// Updating driver objects
+// ------------------------------------------------------------------------------------------------
+
+void DiligentDriver::setDebugTag(HandleBase::HandleId, utils::CString) {
+}
+
+void DiligentDriver::compilePrograms(CompilerPriorityQueue, CallbackHandler* handler,
+        CallbackHandler::Callback callback, void* user) {
+    if (callback) {
+        // the application creates the shaders later, on its own thread
+        DiligentCompilePrograms([this, handler, user, callback]() {
+            scheduleCallback(handler, user, callback);
+        });
+    }
+}
+
+void DiligentDriver::registerBufferObjectStreams(BufferObjectHandle,
+        BufferObjectStreamDescriptor&&) {
+}
+
+void DiligentDriver::updateIndexBuffer(IndexBufferHandle ibh, BufferDescriptor&& data,
+        uint32_t byteOffset) {
+    // the application releases the BufferDescriptor once it's uploaded
+    DiligentUpdateBuffer(ibh.getId(), std::move(data), byteOffset);
+}
+
+void DiligentDriver::updateBufferObject(BufferObjectHandle boh, BufferDescriptor&& data,
+        uint32_t byteOffset) {
+    DiligentUpdateBuffer(boh.getId(), std::move(data), byteOffset);
+}
+
+void DiligentDriver::setVertexBufferObject(VertexBufferHandle, uint32_t, BufferObjectHandle) {
+}
+
+void DiligentDriver::updateDescriptorSetBuffer(DescriptorSetHandle dsh,
+        descriptor_binding_t binding, BufferObjectHandle boh, uint32_t offset, uint32_t size) {
+    DiligentUpdateDescriptorSetBuffer(dsh.getId(), binding, boh.getId(), offset, size);
+}
+
+void DiligentDriver::updateDescriptorSetTexture(DescriptorSetHandle, descriptor_binding_t,
+        TextureHandle, SamplerParams) {
+    // The driver API has no texture creation yet, the application binds its own textures (see
+    // HelloDiligent's LoadTexture()).
+}
+
+// ------------------------------------------------------------------------------------------------
+// Rendering operations
+// ------------------------------------------------------------------------------------------------
+
+void DiligentDriver::bindDescriptorSet(DescriptorSetHandle dsh, descriptor_set_t set,
+        DescriptorSetOffsetArray&& offsets) {
+    // the offsets live in the command stream, the application copies them
+    DiligentBindDescriptorSet(dsh.getId(), set, offsets.data());
+}
+
+} // namespace filament::backend
@@ -0,0 +1,132 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_FILAMENT_BACKEND_DILIGENT_DILIGENTDRIVER_H
+#define TNT_FILAMENT_BACKEND_DILIGENT_DILIGENTDRIVER_H
+
+#include "private/backend/Driver.h"
+
+#include <backend/BufferDescriptor.h>
+#include <backend/CallbackHandler.h>
+#include <backend/DriverEnums.h>
+#include <backend/Handle.h>
+#include <backend/Program.h>
+
+#include <utils/Invocable.h>
+#include <utils/Mutex.h>
+
+#include <utility>
+#include <vector>
+
+#include <stdint.h>
+
+// The Diligent objects are owned by the application, which implements these (see
+// HelloDiligent.cpp). They're called on the render thread, in command order.
+extern void DiligentCreateProgram(filament::backend::HandleBase::HandleId id,
+        filament::backend::Program&& program);
+extern void DiligentDestroyProgram(filament::backend::HandleBase::HandleId id);
+// Called by compilePrograms(), `ready` must be called once the programs passed to
+// DiligentCreateProgram() before it are created. It can be called from any thread.
+extern void DiligentCompilePrograms(utils::Invocable<void()>&& ready);
+extern void DiligentCreateVertexBufferInfo(filament::backend::HandleBase::HandleId id,
+        uint8_t bufferCount, uint8_t attributeCount,
+        filament::backend::AttributeArray const& attributes);
+extern void DiligentDestroyVertexBufferInfo(filament::backend::HandleBase::HandleId id);
+extern void DiligentCreateDescriptorSetLayout(filament::backend::HandleBase::HandleId id,
+        filament::backend::DescriptorSetLayout&& info);
+extern void DiligentDestroyDescriptorSetLayout(filament::backend::HandleBase::HandleId id);
+// Buffer objects and index buffers share the id space, both are Diligent buffers.
+extern void DiligentCreateBuffer(filament::backend::HandleBase::HandleId id, uint32_t byteCount,
+        filament::backend::BufferObjectBinding bindingType, filament::backend::BufferUsage usage);
+extern void DiligentCreateIndexBuffer(filament::backend::HandleBase::HandleId id,
+        uint32_t byteCount, filament::backend::BufferUsage usage);
+extern void DiligentUpdateBuffer(filament::backend::HandleBase::HandleId id,
+        filament::backend::BufferDescriptor&& data, uint32_t byteOffset);
+extern void DiligentDestroyBuffer(filament::backend::HandleBase::HandleId id);
+extern void DiligentCreateDescriptorSet(filament::backend::HandleBase::HandleId id,
+        filament::backend::HandleBase::HandleId layoutId);
+extern void DiligentUpdateDescriptorSetBuffer(filament::backend::HandleBase::HandleId id,
+        filament::backend::descriptor_binding_t binding,
+        filament::backend::HandleBase::HandleId bufferId, uint32_t offset, uint32_t size);
+extern void DiligentDestroyDescriptorSet(filament::backend::HandleBase::HandleId id);
+// `dynamicOffsets` has one offset per dynamic buffer of the set's layout, in binding order, and
+// is only valid during the call.
+extern void DiligentBindDescriptorSet(filament::backend::HandleBase::HandleId id,
+        filament::backend::descriptor_set_t set, uint32_t const* dynamicOffsets);
+
+namespace filament::backend {
+
+/*
+ * Driver executing the command stream on the render thread. Handles are allocated on the
+ * engine thread when a command is recorded, the backend objects are created when it executes.
+ */
+class DiligentDriver final : public Driver {
+    DiligentDriver() noexcept;
+
+public:
+    static Driver* create();
+
+    ~DiligentDriver() noexcept override;
+
+private:
+    void purge() noexcept override;
+
+    ShaderModel getShaderModel() const noexcept override;
+
+    ShaderLanguage getShaderLanguage() const noexcept override;
+
+    void debugCommandBegin(CommandStream* cmds,
+            bool synchronous, const char* methodName) noexcept override;
+
+    void debugCommandEnd(CommandStream* cmds,
+            bool synchronous, const char* methodName) noexcept override;
+
+    // thread-safe, called on the engine thread
+    HandleBase::HandleId allocateHandle() noexcept;
+
+    // thread-safe, called on the render thread
+    void freeHandle(HandleBase::HandleId id) noexcept;
+
+    // the callback is called on the handler's thread, or on the engine thread from purge()
+    void scheduleCallback(CallbackHandler* handler, void* user, CallbackHandler::Callback callback);
+
+    /*
+     * Driver interface
+     */
+
+#define DECL_DRIVER_API(methodName, paramsDecl, params) \
+    void methodName(paramsDecl) override;
+
+#define DECL_DRIVER_API_SYNCHRONOUS(RetType, methodName, paramsDecl, params) \
+    RetType methodName(paramsDecl) override;
+
+#define DECL_DRIVER_API_RETURN(RetType, methodName, paramsDecl, params) \
+    RetType methodName##S() noexcept override; \
+    void methodName##R(RetType, paramsDecl) override;
+
+#include "private/backend/DriverAPI.inc"
+
+    utils::Mutex mHandleLock;
+    std::vector<HandleBase::HandleId> mFreeHandles;
+    HandleBase::HandleId mNextHandle = 0;
+
+    utils::Mutex mPurgeLock;
+    std::vector<std::pair<void*, CallbackHandler::Callback>> mServiceThreadCallbackQueue;
+};
+
+} // namespace filament::backend
+
+#endif // TNT_FILAMENT_BACKEND_DILIGENT_DILIGENTDRIVER_H
@@ -0,0 +1,416 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "NoopDriver.h"
+
+#include "private/backend/CommandStream.h"
+
+#include <backend/BufferDescriptor.h>
+#include <backend/BufferObjectStreamDescriptor.h>
+#include <backend/CallbackHandler.h>
+#include <backend/DescriptorSetOffsetArray.h>
+#include <backend/DriverEnums.h>
+#include <backend/Handle.h>
+#include <backend/Program.h>
+
+#include <utils/CString.h>
+#include <utils/compiler.h>
+#include <utils/debug.h>
+#include <utils/Log.h>
+#include <utils/Mutex.h>
+#include <utils/Panic.h>
+
+#include <math/vec2.h>
+
+#include <array>
+#include <deque>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace filament::backend {
+
+template<>
+struct NoopDriver::HandleTraits<HwBufferObject> {
+    static constexpr HandleType type = HandleType::BUFFER_OBJECT;
+};
+
+template<>
+struct NoopDriver::HandleTraits<HwIndexBuffer> {
+    static constexpr HandleType type = HandleType::INDEX_BUFFER;
+};
+
+template<>
+struct NoopDriver::HandleTraits<HwVertexBufferInfo> {
+    static constexpr HandleType type = HandleType::VERTEX_BUFFER_INFO;
+};
+
+template<>
+struct NoopDriver::HandleTraits<HwVertexBuffer> {
+    static constexpr HandleType type = HandleType::VERTEX_BUFFER;
+};
+
+template<>
+struct NoopDriver::HandleTraits<HwProgram> {
+    static constexpr HandleType type = HandleType::PROGRAM;
+};
+
+template<>
+struct NoopDriver::HandleTraits<HwDescriptorSetLayout> {
+    static constexpr HandleType type = HandleType::DESCRIPTOR_SET_LAYOUT;
+};
+
+template<>
+struct NoopDriver::HandleTraits<HwDescriptorSet> {
+    static constexpr HandleType type = HandleType::DESCRIPTOR_SET;
+};
+
+Driver* NoopDriver::create() {
+    return new NoopDriver();
+}
+
+NoopDriver::NoopDriver() noexcept = default;
+
+NoopDriver::~NoopDriver() noexcept {
+    std::array<size_t, size_t(HandleType::COUNT)> leaks{};
+    for (HandleState const& state : mHandles) {
+        leaks[size_t(state.type)]++;
+    }
+    for (size_t i = 1; i < leaks.size(); i++) {
+        if (UTILS_UNLIKELY(leaks[i])) {
+            utils::slog.w << "NoopDriver: " << leaks[i] << " " << getHandleTypeName(HandleType(i))
+                    << " handle(s) leaked" << utils::io::endl;
+        }
+    }
+}
+
+const char* NoopDriver::getHandleTypeName(HandleType const type) noexcept {
+    switch (type) {
+        case HandleType::FREE:                  return "free";
+        case HandleType::BUFFER_OBJECT:         return "BufferObject";
+        case HandleType::INDEX_BUFFER:          return "IndexBuffer";
+        case HandleType::VERTEX_BUFFER_INFO:    return "VertexBufferInfo";
+        case HandleType::VERTEX_BUFFER:         return "VertexBuffer";
+        case HandleType::PROGRAM:               return "Program";
+        case HandleType::DESCRIPTOR_SET_LAYOUT: return "DescriptorSetLayout";
+        case HandleType::DESCRIPTOR_SET:        return "DescriptorSet";
+        case HandleType::COUNT:                 break;
+    }
+    return "unknown";
+}
+
+void NoopDriver::purge() noexcept {
+    std::vector<std::pair<void*, CallbackHandler::Callback>> callbacks;
+    std::unique_lock<utils::Mutex> lock(mPurgeLock);
+    std::swap(callbacks, mServiceThreadCallbackQueue);
+    lock.unlock();
+    for (auto& item : callbacks) {
+        item.second(item.first);
+    }
+}
+
+ShaderModel NoopDriver::getShaderModel() const noexcept {
+    return ShaderModel::DESKTOP;
+}
+
+ShaderLanguage NoopDriver::getShaderLanguage() const noexcept {
+    return ShaderLanguage::ESSL3;
+}
+
+void NoopDriver::debugCommandBegin(CommandStream*, bool, const char*) noexcept {
+}
+
+void NoopDriver::debugCommandEnd(CommandStream*, bool, const char*) noexcept {
+}
+
+NoopDriver::HandleType NoopDriver::getHandleType(HandleBase::HandleId const id) const noexcept {
+    return id < mHandles.size() ? mHandles[id].type : HandleType::FREE;
+}
+
+template<typename T>
+Handle<T> NoopDriver::allocateHandle() noexcept {
+    std::lock_guard<utils::Mutex> const lock(mHandleLock);
+    HandleBase::HandleId id;
+    if (mFreeHandles.size() > FREE_HANDLES_QUARANTINE) {
+        id = mFreeHandles.front();
+        mFreeHandles.pop_front();
+    } else {
+        id = HandleBase::HandleId(mHandles.size());
+        assert_invariant(id != HandleBase::nullid);
+        mHandles.emplace_back();
+    }
+    mHandles[id] = { HandleTraits<T>::type, false };
+    return Handle<T>{ id };
+}
+
+template<typename T>
+void NoopDriver::construct(Handle<T> const& handle, const char* methodName) {
+    HandleBase::HandleId const id = handle.getId();
+    std::lock_guard<utils::Mutex> const lock(mHandleLock);
+    FILAMENT_CHECK_PRECONDITION(
+            getHandleType(id) == HandleTraits<T>::type && !mHandles[id].created)
+            << methodName << ": handle " << id << " wasn't returned by " << methodName
+            << "S() or is already constructed";
+    mHandles[id].created = true;
+}
+
+template<typename T>
+void NoopDriver::check(Handle<T> const& handle, const char* methodName) {
+    HandleBase::HandleId const id = handle.getId();
+    if (id == HandleBase::nullid) {
+        return;
+    }
+    std::lock_guard<utils::Mutex> const lock(mHandleLock);
+    FILAMENT_CHECK_PRECONDITION(
+            getHandleType(id) == HandleTraits<T>::type && mHandles[id].created)
+            << methodName << ": handle " << id << " isn't a live "
+            << getHandleTypeName(HandleTraits<T>::type)
+            << " (it's " << getHandleTypeName(getHandleType(id)) << ")";
+}
+
+template<typename T>
+void NoopDriver::destroy(Handle<T> const& handle, const char* methodName) {
+    HandleBase::HandleId const id = handle.getId();
+    if (id == HandleBase::nullid) {
+        return;
+    }
+    std::lock_guard<utils::Mutex> const lock(mHandleLock);
+    FILAMENT_CHECK_PRECONDITION(getHandleType(id) == HandleTraits<T>::type)
+            << methodName << ": handle " << id << " isn't a live "
+            << getHandleTypeName(HandleTraits<T>::type)
+            << " (it's " << getHandleTypeName(getHandleType(id)) << ")";
+    mHandles[id] = {};
+    mFreeHandles.push_back(id);
+}
+
+void NoopDriver::scheduleCallback(CallbackHandler* handler, void* user,
+        CallbackHandler::Callback callback) {
+    if (handler) {
+        handler->post(user, callback);
+    } else {
+        std::lock_guard<utils::Mutex> const lock(mPurgeLock);
+        mServiceThreadCallbackQueue.emplace_back(user, callback);
+    }
+}
+
+// ------------------------------------------------------------------------------------------------
+// Creating driver objects
+// ------------------------------------------------------------------------------------------------
+
+BufferObjectHandle NoopDriver::createBufferObjectS() noexcept {
+    return allocateHandle<HwBufferObject>();
+}
+
+IndexBufferHandle NoopDriver::createIndexBufferS() noexcept {
+    return allocateHandle<HwIndexBuffer>();
+}
+
+VertexBufferInfoHandle NoopDriver::createVertexBufferInfoS() noexcept {
+    return allocateHandle<HwVertexBufferInfo>();
+}
+
+VertexBufferHandle NoopDriver::createVertexBufferS() noexcept {
+    return allocateHandle<HwVertexBuffer>();
+}
+
+ProgramHandle NoopDriver::createProgramS() noexcept {
+    return allocateHandle<HwProgram>();
+}
+
+DescriptorSetLayoutHandle NoopDriver::createDescriptorSetLayoutS() noexcept {
+    return allocateHandle<HwDescriptorSetLayout>();
+}
+
+DescriptorSetHandle NoopDriver::createDescriptorSetS() noexcept {
+    return allocateHandle<HwDescriptorSet>();
+}
+
+void NoopDriver::createBufferObjectR(BufferObjectHandle boh,
+        uint32_t, BufferObjectBinding, BufferUsage) {
+    construct(boh, "createBufferObject");
+}
+
+void NoopDriver::createIndexBufferR(IndexBufferHandle ibh,
+        ElementType, uint32_t, BufferUsage) {
+    construct(ibh, "createIndexBuffer");
+}
+
+void NoopDriver::createVertexBufferInfoR(VertexBufferInfoHandle vbih,
+        uint8_t, uint8_t, AttributeArray) {
+    construct(vbih, "createVertexBufferInfo");
+}
+
+void NoopDriver::createVertexBufferR(VertexBufferHandle vbh, uint32_t,
+        VertexBufferInfoHandle vbih) {
+    check(vbih, "createVertexBuffer");
+    construct(vbh, "createVertexBuffer");
+}
+
+void NoopDriver::createProgramR(ProgramHandle ph, Program&&) {
+    construct(ph, "createProgram");
+}
+
+void NoopDriver::createDescriptorSetLayoutR(DescriptorSetLayoutHandle dslh,
+        DescriptorSetLayout&&) {
+    construct(dslh, "createDescriptorSetLayout");
+}
+
+void NoopDriver::createDescriptorSetR(DescriptorSetHandle dsh, DescriptorSetLayoutHandle dslh) {
+    check(dslh, "createDescriptorSet");
+    construct(dsh, "createDescriptorSet");
+}
+
+// ------------------------------------------------------------------------------------------------
+// Destroying driver objects
+// ------------------------------------------------------------------------------------------------
+
+void NoopDriver::destroyBufferObject(BufferObjectHandle boh) {
+    destroy(boh, "destroyBufferObject");
+}
+
+void NoopDriver::destroyIndexBuffer(IndexBufferHandle ibh) {
+    destroy(ibh, "destroyIndexBuffer");
+}
+
+void NoopDriver::destroyVertexBufferInfo(VertexBufferInfoHandle vbih) {
+    destroy(vbih, "destroyVertexBufferInfo");
+}
+
+void NoopDriver::destroyVertexBuffer(VertexBufferHandle vbh) {
+    destroy(vbh, "destroyVertexBuffer");
+}
+
+void NoopDriver::destroyProgram(ProgramHandle ph) {
+    destroy(ph, "destroyProgram");
+}
+
+void NoopDriver::destroyTexture(TextureHandle) {
+    // textures aren't created through the driver API, so their handles aren't ours
+}
+
+void NoopDriver::destroyDescriptorSetLayout(DescriptorSetLayoutHandle dslh) {
+    destroy(dslh, "destroyDescriptorSetLayout");
+}
+
+void NoopDriver::destroyDescriptorSet(DescriptorSetHandle dsh) {
+    destroy(dsh, "destroyDescriptorSet");
+}
+
+// ------------------------------------------------------------------------------------------------
+// Synchronous APIs
+// ------------------------------------------------------------------------------------------------
+
+bool NoopDriver::isWorkaroundNeeded(Workaround) {
+    return false;
+}
+
+FeatureLevel NoopDriver::getFeatureLevel() {
+    return FeatureLevel::FEATURE_LEVEL_3;
+}
+
+math::float2 NoopDriver::getClipSpaceParams() {
+    return math::float2{ 1.0f, 0.0f };
+}
+
+uint8_t NoopDriver::getMaxDrawBuffers() {
+    return 16;// MRT::MAX_SUPPORTED_RENDER_TARGET_COUNT;
+}
+
+size_t NoopDriver::getMaxUniformBufferSize() {
+    return 65536;
+}
+
+size_t NoopDriver::getMaxTextureSize(SamplerType) {
+    return 16384u;
+}
+
+size_t NoopDriver::getMaxArrayTextureLayers() {
+    return 256u;
+}
+
+bool NoopDriver::isStereoSupported() {
+    return false;
+}
+
+bool NoopDriver::isParallelShaderCompileSupported() {
+    return false;
+}
+
+// ------------------------------------------------------------------------------------------------
+// Updating driver objects
+// ------------------------------------------------------------------------------------------------
+
+void NoopDriver::setDebugTag(HandleBase::HandleId const handleId, utils::CString) {
+    // any live handle can be tagged
+    std::lock_guard<utils::Mutex> const lock(mHandleLock);
+    FILAMENT_CHECK_PRECONDITION(getHandleType(handleId) != HandleType::FREE)
+            << "setDebugTag: handle " << handleId << " isn't live";
+}
+
+void NoopDriver::compilePrograms(CompilerPriorityQueue, CallbackHandler* handler,
+        CallbackHandler::Callback callback, void* user) {
+    // there is nothing to compile
+    if (callback) {
+        scheduleCallback(handler, user, callback);
+    }
+}
+
+void NoopDriver::registerBufferObjectStreams(BufferObjectHandle boh,
+        BufferObjectStreamDescriptor&&) {
+    check(boh, "registerBufferObjectStreams");
+}
+
+void NoopDriver::updateIndexBuffer(IndexBufferHandle ibh, BufferDescriptor&& data, uint32_t) {
+    check(ibh, "updateIndexBuffer");
+    // the BufferDescriptor's callback is called when it goes out of scope
+    BufferDescriptor const release(std::move(data));
+}
+
+void NoopDriver::updateBufferObject(BufferObjectHandle boh, BufferDescriptor&& data, uint32_t) {
+    check(boh, "updateBufferObject");
+    BufferDescriptor const release(std::move(data));
+}
+
+void NoopDriver::setVertexBufferObject(VertexBufferHandle vbh, uint32_t,
+        BufferObjectHandle bufferObject) {
+    check(vbh, "setVertexBufferObject");
+    check(bufferObject, "setVertexBufferObject");
+}
+
+void NoopDriver::updateDescriptorSetBuffer(DescriptorSetHandle dsh, descriptor_binding_t,
+        BufferObjectHandle boh, uint32_t, uint32_t) {
+    check(dsh, "updateDescriptorSetBuffer");
+    check(boh, "updateDescriptorSetBuffer");
+}
+
+void NoopDriver::updateDescriptorSetTexture(DescriptorSetHandle dsh, descriptor_binding_t,
+        TextureHandle, SamplerParams) {
+    check(dsh, "updateDescriptorSetTexture");
+}
+
+// ------------------------------------------------------------------------------------------------
+// Rendering operations
+// ------------------------------------------------------------------------------------------------
+
+void NoopDriver::bindDescriptorSet(DescriptorSetHandle dsh, descriptor_set_t,
+        DescriptorSetOffsetArray&&) {
+    check(dsh, "bindDescriptorSet");
+}
+
+} // namespace filament::backend
@@ -0,0 +1,141 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_FILAMENT_BACKEND_NOOP_NOOPDRIVER_H
+#define TNT_FILAMENT_BACKEND_NOOP_NOOPDRIVER_H
+
+#include "private/backend/Driver.h"
+
+#include <backend/CallbackHandler.h>
+#include <backend/DriverEnums.h>
+#include <backend/Handle.h>
+
+#include <utils/Mutex.h>
+
+#include <deque>
+#include <utility>
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace filament::backend {
+
+/*
+ * Driver accepting all commands without doing anything, for running the engine without a GPU
+ * and measuring the cost of the commands themselves.
+ *
+ * It hands out unique handles and tracks their lifetime. Using a handle of the wrong type, or one
+ * that isn't created yet or is already destroyed, is a precondition failure. The handles still
+ * alive when the driver is destroyed are logged.
+ */
+class NoopDriver final : public Driver {
+    NoopDriver() noexcept;
+
+public:
+    static Driver* create();
+
+    ~NoopDriver() noexcept override;
+
+private:
+    enum class HandleType : uint8_t {
+        FREE,
+        BUFFER_OBJECT,
+        INDEX_BUFFER,
+        VERTEX_BUFFER_INFO,
+        VERTEX_BUFFER,
+        PROGRAM,
+        DESCRIPTOR_SET_LAYOUT,
+        DESCRIPTOR_SET,
+        COUNT
+    };
+
+    static const char* getHandleTypeName(HandleType type) noexcept;
+
+    template<typename T>
+    struct HandleTraits;
+
+    struct HandleState {
+        HandleType type = HandleType::FREE;
+        bool created = false;   // its *R() command was executed
+    };
+
+    void purge() noexcept override;
+
+    ShaderModel getShaderModel() const noexcept override;
+
+    ShaderLanguage getShaderLanguage() const noexcept override;
+
+    void debugCommandBegin(CommandStream* cmds,
+            bool synchronous, const char* methodName) noexcept override;
+
+    void debugCommandEnd(CommandStream* cmds,
+            bool synchronous, const char* methodName) noexcept override;
+
+    // FREE for the ids never allocated, mHandleLock must be held
+    HandleType getHandleType(HandleBase::HandleId id) const noexcept;
+
+    // called on the engine thread, by the *S() methods
+    template<typename T>
+    Handle<T> allocateHandle() noexcept;
+
+    // The methods below are called on the render thread.
+    // The handle must come from allocateHandle<T>() and must not be constructed yet.
+    template<typename T>
+    void construct(Handle<T> const& handle, const char* methodName);
+
+    // The handle must be a constructed T, or null.
+    template<typename T>
+    void check(Handle<T> const& handle, const char* methodName);
+
+    // The handle must be a T, or null. Its id can be reused afterward.
+    template<typename T>
+    void destroy(Handle<T> const& handle, const char* methodName);
+
+    // the callback is called on the handler's thread, or on the engine thread from purge()
+    void scheduleCallback(CallbackHandler* handler, void* user, CallbackHandler::Callback callback);
+
+    /*
+     * Driver interface
+     */
+
+#define DECL_DRIVER_API(methodName, paramsDecl, params) \
+    void methodName(paramsDecl) override;
+
+#define DECL_DRIVER_API_SYNCHRONOUS(RetType, methodName, paramsDecl, params) \
+    RetType methodName(paramsDecl) override;
+
+#define DECL_DRIVER_API_RETURN(RetType, methodName, paramsDecl, params) \
+    RetType methodName##S() noexcept override; \
+    void methodName##R(RetType, paramsDecl) override;
+
+#include "private/backend/DriverAPI.inc"
+
+    // A freed id is reused once this many ids were freed after it, so that a stale handle
+    // keeps designating a destroyed object for a while.
+    static constexpr size_t FREE_HANDLES_QUARANTINE = 1024;
+
+    utils::Mutex mHandleLock;
+    std::vector<HandleState> mHandles;
+    std::deque<HandleBase::HandleId> mFreeHandles;
+
+    utils::Mutex mPurgeLock;
+    std::vector<std::pair<void*, CallbackHandler::Callback>> mServiceThreadCallbackQueue;
+};
+
+} // namespace filament::backend
+
+#endif // TNT_FILAMENT_BACKEND_NOOP_NOOPDRIVER_H
@@ -0,0 +1,162 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "CaptureDriver.h"
+
+#include "CommandTrace.h"
+
+#include <backend/BufferDescriptor.h>
+#include <backend/BufferObjectStreamDescriptor.h>
+#include <backend/CallbackHandler.h>
+#include <backend/DescriptorSetOffsetArray.h>
+#include <backend/DriverEnums.h>
+#include <backend/Handle.h>
+#include <backend/Program.h>
+
+#include <utils/CString.h>
+#include <utils/Log.h>
+
+#include <math/vec2.h>
+
+#include <functional>
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+namespace filament::backend {
+
+Driver* CaptureDriver::create(Driver* driver, const char* path) {
+    FILE* const file = fopen(path, "wb");
+    TraceHeader const header;
+    if (!file || fwrite(&header, sizeof(header), 1, file) != 1) {
+        utils::slog.w << "CaptureDriver: couldn't create " << path << utils::io::endl;
+        if (file) {
+            fclose(file);
+        }
+        return driver;
+    }
+    return new CaptureDriver(driver, file);
+}
+
+CaptureDriver::CaptureDriver(Driver* driver, FILE* file) noexcept
+        : mDriver(*driver),
+          mFile(file) {
+}
+
+CaptureDriver::~CaptureDriver() noexcept {
+    fclose(mFile);
+    delete &mDriver;
+}
+
+void CaptureDriver::purge() noexcept {
+    mDriver.purge();
+}
+
+ShaderModel CaptureDriver::getShaderModel() const noexcept {
+    return mDriver.getShaderModel();
+}
+
+ShaderLanguage CaptureDriver::getShaderLanguage() const noexcept {
+    return mDriver.getShaderLanguage();
+}
+
+void CaptureDriver::execute(std::function<void(void)> const& fn) {
+    mWriter.command(TraceCommand::BEGIN_BUFFER);
+    mDepth++;
+    mDriver.execute(fn);
+    mDepth--;
+    mWriter.command(TraceCommand::END_BUFFER);
+    if (!mDepth) {
+        std::vector<uint8_t> const& data = mWriter.getData();
+        fwrite(data.data(), 1, data.size(), mFile);
+        mWriter.clear();
+    }
+}
+
+void CaptureDriver::debugCommandBegin(CommandStream* cmds,
+        bool synchronous, const char* methodName) noexcept {
+    mDriver.debugCommandBegin(cmds, synchronous, methodName);
+}
+
+void CaptureDriver::debugCommandEnd(CommandStream* cmds,
+        bool synchronous, const char* methodName) noexcept {
+    mDriver.debugCommandEnd(cmds, synchronous, methodName);
+}
+
+template<typename T, typename>
+void CaptureDriver::record(TraceCommand const command, Handle<T> dslh,
+        DescriptorSetLayout const& info) {
+    uint32_t count = 0;
+    for (DescriptorSetLayoutBinding const& binding : info.bindings) {
+        if (uint8_t(binding.flags) & uint8_t(DescriptorFlags::DYNAMIC_OFFSET)) {
+            count++;
+        }
+    }
+    mLayoutDynamicOffsets[dslh.getId()] = count;
+    mWriter.command(command);
+    mWriter.write(dslh);
+    mWriter.write(info);
+}
+
+template<typename T, typename>
+void CaptureDriver::record(TraceCommand const command, Handle<T> dsh,
+        DescriptorSetLayoutHandle dslh) {
+    auto const pos = mLayoutDynamicOffsets.find(dslh.getId());
+    mSetDynamicOffsets[dsh.getId()] = pos != mLayoutDynamicOffsets.end() ? pos->second : 0;
+    mWriter.command(command);
+    mWriter.write(dsh);
+    mWriter.write(dslh);
+}
+
+template<typename T, typename>
+void CaptureDriver::record(TraceCommand const command, Handle<T> dsh,
+        descriptor_set_t const set, DescriptorSetOffsetArray const& offsets) {
+    auto const pos = mSetDynamicOffsets.find(dsh.getId());
+    mWriter.command(command);
+    mWriter.write(dsh);
+    mWriter.write(set);
+    mWriter.write(offsets, pos != mSetDynamicOffsets.end() ? pos->second : 0);
+}
+
+// ------------------------------------------------------------------------------------------------
+// Driver interface, every command is recorded then passed on
+// ------------------------------------------------------------------------------------------------
+
+#define DECL_DRIVER_API(methodName, paramsDecl, params)                                         \
+    void CaptureDriver::methodName(paramsDecl) {                                                \
+        record(TraceCommand::methodName, params);                                               \
+        forward(&Driver::methodName, params);                                                   \
+    }
+
+#define DECL_DRIVER_API_SYNCHRONOUS(RetType, methodName, paramsDecl, params)                    \
+    RetType CaptureDriver::methodName(paramsDecl) {                                             \
+        return mDriver.methodName(params);                                                      \
+    }
+
+#define DECL_DRIVER_API_RETURN(RetType, methodName, paramsDecl, params)                         \
+    RetType CaptureDriver::methodName##S() noexcept {                                           \
+        return mDriver.methodName##S();                                                         \
+    }                                                                                           \
+    void CaptureDriver::methodName##R(RetType handle, paramsDecl) {                             \
+        record(TraceCommand::methodName##R, handle, params);                                    \
+        forward(&Driver::methodName##R, handle, params);                                        \
+    }
+
+#include "private/backend/DriverAPI.inc"
+
+} // namespace filament::backend
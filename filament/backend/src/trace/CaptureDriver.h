@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_FILAMENT_BACKEND_TRACE_CAPTUREDRIVER_H
+#define TNT_FILAMENT_BACKEND_TRACE_CAPTUREDRIVER_H
+
+#include "CommandTrace.h"
+
+#include "private/backend/Driver.h"
+
+#include <backend/DriverEnums.h>
+#include <backend/Handle.h>
+
+#include <functional>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+
+#include <stdint.h>
+#include <stdio.h>
+
+namespace filament::backend {
+
+/*
+ * Driver writing the commands it executes to a trace file (see CommandTrace.h) before passing
+ * them on to another driver. Each command buffer is written once it has been executed.
+ */
+class CaptureDriver final : public Driver {
+    CaptureDriver(Driver* driver, FILE* file) noexcept;
+
+public:
+    // Takes ownership of `driver`. Returns `driver` if the trace can't be created.
+    static Driver* create(Driver* driver, const char* path);
+
+    ~CaptureDriver() noexcept override;
+
+private:
+    void purge() noexcept override;
+
+    ShaderModel getShaderModel() const noexcept override;
+
+    ShaderLanguage getShaderLanguage() const noexcept override;
+
+    void execute(std::function<void(void)> const& fn) override;
+
+    void debugCommandBegin(CommandStream* cmds,
+            bool synchronous, const char* methodName) noexcept override;
+
+    void debugCommandEnd(CommandStream* cmds,
+            bool synchronous, const char* methodName) noexcept override;
+
+    template<typename ... ARGS>
+    void record(TraceCommand command, ARGS const& ... args) {
+        mWriter.command(command);
+        (mWriter.write(args), ...);
+    }
+
+    // The size of the dynamic offsets array depends on the descriptor set's layout.
+    // The handle types are deduced, so that the other handles aren't converted to check them.
+    template<typename T, typename = std::enable_if_t<std::is_same_v<T, HwDescriptorSetLayout>>>
+    void record(TraceCommand command, Handle<T> dslh, DescriptorSetLayout const& info);
+    template<typename T, typename = std::enable_if_t<std::is_same_v<T, HwDescriptorSet>>>
+    void record(TraceCommand command, Handle<T> dsh, DescriptorSetLayoutHandle dslh);
+    template<typename T, typename = std::enable_if_t<std::is_same_v<T, HwDescriptorSet>>>
+    void record(TraceCommand command, Handle<T> dsh, descriptor_set_t set,
+            DescriptorSetOffsetArray const& offsets);
+
+    template<typename ... ARGS, typename ... PARAMS>
+    void forward(void (Driver::*method)(ARGS...), PARAMS& ... params) {
+        (mDriver.*method)(std::forward<ARGS>(params)...);
+    }
+
+    /*
+     * Driver interface
+     */
+
+#define DECL_DRIVER_API(methodName, paramsDecl, params) \
+    void methodName(paramsDecl) override;
+
+#define DECL_DRIVER_API_SYNCHRONOUS(RetType, methodName, paramsDecl, params) \
+    RetType methodName(paramsDecl) override;
+
+#define DECL_DRIVER_API_RETURN(RetType, methodName, paramsDecl, params) \
+    RetType methodName##S() noexcept override; \
+    void methodName##R(RetType, paramsDecl) override;
+
+#include "private/backend/DriverAPI.inc"
+
+    Driver& mDriver;
+    FILE* const mFile;
+    TraceWriter mWriter;
+    uint32_t mDepth = 0;    // nesting of execute()
+
+    // number of dynamic offsets of each layout and set, only accessed on the render thread
+    std::unordered_map<HandleBase::HandleId, uint32_t> mLayoutDynamicOffsets;
+    std::unordered_map<HandleBase::HandleId, uint32_t> mSetDynamicOffsets;
+};
+
+} // namespace filament::backend
+
+#endif // TNT_FILAMENT_BACKEND_TRACE_CAPTUREDRIVER_H
@@ -0,0 +1,297 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "CommandTrace.h"
+
+#include <backend/BufferDescriptor.h>
+#include <backend/BufferObjectStreamDescriptor.h>
+#include <backend/DriverEnums.h>
+#include <backend/Program.h>
+
+#include <utils/CString.h>
+#include <utils/FixedCapacityVector.h>
+#include <utils/Panic.h>
+
+#include <utility>
+#include <variant>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace filament::backend {
+
+using namespace utils;
+
+char const* getTraceCommandName(TraceCommand const command) noexcept {
+    static constexpr char const* names[] = {
+#define DECL_DRIVER_API(methodName, paramsDecl, params) #methodName,
+#define DECL_DRIVER_API_SYNCHRONOUS(RetType, methodName, paramsDecl, params)
+#define DECL_DRIVER_API_RETURN(RetType, methodName, paramsDecl, params) #methodName,
+#include "private/backend/DriverAPI.inc"
+    };
+    static_assert(sizeof(names) / sizeof(*names) == size_t(TraceCommand::COUNT));
+    switch (command) {
+        case TraceCommand::BEGIN_BUFFER:    return "beginBuffer";
+        case TraceCommand::END_BUFFER:      return "endBuffer";
+        default:
+            return size_t(command) < size_t(TraceCommand::COUNT) ? names[size_t(command)] : "?";
+    }
+}
+
+// ------------------------------------------------------------------------------------------------
+
+void TraceWriter::write(CString const& str) {
+    write(uint32_t(str.size()));
+    append(str.c_str(), str.size());
+}
+
+void TraceWriter::write(BufferDescriptor const& data) {
+    write(uint32_t(data.size));
+    append(data.buffer, data.size);
+}
+
+void TraceWriter::write(BufferObjectStreamDescriptor const& streams) {
+    write(uint32_t(streams.mStreams.size()));
+    for (auto const& stream : streams.mStreams) {
+        write(stream.offset);
+        write(stream.stream);
+        write(stream.associationType);
+    }
+}
+
+void TraceWriter::write(DescriptorSetLayout const& info) {
+    write(uint32_t(info.bindings.size()));
+    for (DescriptorSetLayoutBinding const& binding : info.bindings) {
+        write(binding);
+    }
+}
+
+void TraceWriter::write(DescriptorSetOffsetArray const& offsets, uint32_t const count) {
+    uint32_t const size = offsets.empty() ? 0 : count;
+    write(size);
+    append(offsets.data(), size * sizeof(uint32_t));
+}
+
+void TraceWriter::write(Program const& program) {
+    for (Program::ShaderBlob const& blob : program.getShadersSource()) {
+        write(uint32_t(blob.size()));
+        append(blob.data(), blob.size());
+    }
+    write(program.getShaderLanguage());
+    write(program.getName());
+    write(program.getCacheId());
+    write(program.getPriorityQueue());
+    write(program.isMultiview());
+
+    auto const& constants = program.getSpecializationConstants();
+    write(uint32_t(constants.size()));
+    for (auto const& constant : constants) {
+        write(constant.id);
+        write(uint8_t(constant.value.index()));
+        std::visit([this](auto const& value) { write(value); }, constant.value);
+    }
+
+    for (size_t i = 0; i < Program::SHADER_TYPE_COUNT; i++) {
+        auto const& pushConstants = program.getPushConstants(ShaderStage(i));
+        write(uint32_t(pushConstants.size()));
+        for (auto const& pushConstant : pushConstants) {
+            write(pushConstant.name);
+            write(pushConstant.type);
+        }
+    }
+
+    // Program has no const accessor for its descriptor bindings
+    for (auto const& bindings : const_cast<Program&>(program).getDescriptorBindings()) {
+        write(uint32_t(bindings.size()));
+        for (Program::Descriptor const& descriptor : bindings) {
+            write(descriptor.name);
+            write(descriptor.type);
+            write(descriptor.binding);
+        }
+    }
+
+    auto const& attributes = program.getAttributes();
+    write(uint32_t(attributes.size()));
+    for (auto const& [name, location] : attributes) {
+        write(name);
+        write(location);
+    }
+
+    auto const& bindingUniforms = program.getBindingUniformInfo();
+    write(uint32_t(bindingUniforms.size()));
+    for (auto const& [index, name, uniforms] : bindingUniforms) {
+        write(index);
+        write(name);
+        write(uint32_t(uniforms.size()));
+        for (Program::Uniform const& uniform : uniforms) {
+            write(uniform.name);
+            write(uniform.offset);
+            write(uniform.size);
+            write(uniform.type);
+        }
+    }
+}
+
+// ------------------------------------------------------------------------------------------------
+
+TraceReader::TraceReader(void const* data, size_t const size) noexcept
+        : mCurrent(static_cast<uint8_t const*>(data)),
+          mEnd(static_cast<uint8_t const*>(data) + size) {
+}
+
+uint8_t const* TraceReader::consume(size_t const size) {
+    FILAMENT_CHECK_POSTCONDITION(size_t(mEnd - mCurrent) >= size) << "truncated command trace";
+    uint8_t const* const p = mCurrent;
+    mCurrent += size;
+    return p;
+}
+
+void TraceReader::read(CString& str) {
+    uint32_t size;
+    read(size);
+    str = CString(reinterpret_cast<char const*>(consume(size)), size);
+}
+
+void TraceReader::read(BufferDescriptor& data) {
+    uint32_t size;
+    read(size);
+    data = BufferDescriptor(consume(size), size);
+}
+
+void TraceReader::read(BufferObjectStreamDescriptor& streams) {
+    uint32_t count;
+    read(count);
+    streams.mStreams.resize(count);
+    for (auto& stream : streams.mStreams) {
+        read(stream.offset);
+        read(stream.stream);
+        read(stream.associationType);
+    }
+}
+
+void TraceReader::read(DescriptorSetLayout& info) {
+    uint32_t count;
+    read(count);
+    info.bindings = FixedCapacityVector<DescriptorSetLayoutBinding>(count);
+    for (DescriptorSetLayoutBinding& binding : info.bindings) {
+        read(binding);
+    }
+}
+
+uint32_t const* TraceReader::readOffsets(uint32_t& count) {
+    read(count);
+    return reinterpret_cast<uint32_t const*>(consume(count * sizeof(uint32_t)));
+}
+
+void TraceReader::read(Program& program) {
+    for (size_t i = 0; i < Program::SHADER_TYPE_COUNT; i++) {
+        uint32_t size;
+        read(size);
+        program.shader(ShaderStage(i), consume(size), size);
+    }
+
+    ShaderLanguage language;
+    read(language);
+    program.shaderLanguage(language);
+    read(program.getName());
+    uint64_t cacheId;
+    read(cacheId);
+    program.cacheId(cacheId);
+    CompilerPriorityQueue priority;
+    read(priority);
+    program.priorityQueue(priority);
+    bool multiview;
+    read(multiview);
+    program.multiview(multiview);
+
+    uint32_t count;
+    read(count);
+    auto constants = Program::SpecializationConstantsInfo::with_capacity(count);
+    for (uint32_t i = 0; i < count; i++) {
+        Program::SpecializationConstant constant{};
+        read(constant.id);
+        uint8_t type;
+        read(type);
+        switch (type) {
+            case 0: { int32_t v; read(v); constant.value = v; break; }
+            case 1: { float v; read(v); constant.value = v; break; }
+            case 2: { bool v; read(v); constant.value = v; break; }
+            default:
+                FILAMENT_CHECK_POSTCONDITION(false) << "invalid specialization constant";
+        }
+        constants.push_back(std::move(constant));
+    }
+    program.specializationConstants(std::move(constants));
+
+    for (size_t i = 0; i < Program::SHADER_TYPE_COUNT; i++) {
+        read(count);
+        auto pushConstants = FixedCapacityVector<Program::PushConstant>::with_capacity(count);
+        for (uint32_t j = 0; j < count; j++) {
+            Program::PushConstant pushConstant{};
+            read(pushConstant.name);
+            read(pushConstant.type);
+            pushConstants.push_back(std::move(pushConstant));
+        }
+        program.pushConstants(ShaderStage(i), std::move(pushConstants));
+    }
+
+    size_t const setCount = program.getDescriptorBindings().size();
+    for (size_t set = 0; set < setCount; set++) {
+        read(count);
+        auto bindings = Program::DescriptorBindingsInfo::with_capacity(count);
+        for (uint32_t j = 0; j < count; j++) {
+            Program::Descriptor descriptor{};
+            read(descriptor.name);
+            read(descriptor.type);
+            read(descriptor.binding);
+            bindings.push_back(std::move(descriptor));
+        }
+        program.descriptorBindings(descriptor_set_t(set), std::move(bindings));
+    }
+
+    read(count);
+    auto attributes = Program::AttributesInfo::with_capacity(count);
+    for (uint32_t i = 0; i < count; i++) {
+        CString name;
+        uint8_t location;
+        read(name);
+        read(location);
+        attributes.emplace_back(std::move(name), location);
+    }
+    program.attributes(std::move(attributes));
+
+    read(count);
+    for (uint32_t i = 0; i < count; i++) {
+        uint8_t index;
+        CString name;
+        uint32_t uniformCount;
+        read(index);
+        read(name);
+        read(uniformCount);
+        auto uniforms = Program::UniformInfo::with_capacity(uniformCount);
+        for (uint32_t j = 0; j < uniformCount; j++) {
+            Program::Uniform uniform{};
+            read(uniform.name);
+            read(uniform.offset);
+            read(uniform.size);
+            read(uniform.type);
+            uniforms.push_back(std::move(uniform));
+        }
+        program.uniforms(index, std::move(name), std::move(uniforms));
+    }
+}
+
+} // namespace filament::backend
@@ -0,0 +1,170 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_FILAMENT_BACKEND_TRACE_COMMANDTRACE_H
+#define TNT_FILAMENT_BACKEND_TRACE_COMMANDTRACE_H
+
+#include "private/backend/Driver.h"
+
+#include <backend/BufferDescriptor.h>
+#include <backend/BufferObjectStreamDescriptor.h>
+#include <backend/CallbackHandler.h>
+#include <backend/DriverEnums.h>
+#include <backend/Handle.h>
+#include <backend/Program.h>
+
+#include <utils/CString.h>
+
+#include <type_traits>
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * Binary trace of the commands executed by a Driver, written by CaptureDriver and read by
+ * TraceReplayer.
+ *
+ * A trace is a TraceHeader followed by records. A record is a TraceCommand followed by the
+ * command's arguments, in declaration order. Trivially copyable arguments are stored as is,
+ * variable-size ones (BufferDescriptor, Program, ...) are prefixed by their element count.
+ * Pointers (callbacks, handlers, user data) aren't stored, they're replayed as nullptr.
+ *
+ * Traces are only meant to be replayed by the same build on the same architecture.
+ */
+
+namespace filament::backend {
+
+// The driver commands are numbered in the order of DriverAPI.inc, synchronous calls aren't
+// recorded since they don't change the driver's state.
+enum class TraceCommand : uint16_t {
+#define DECL_DRIVER_API(methodName, paramsDecl, params) methodName,
+#define DECL_DRIVER_API_SYNCHRONOUS(RetType, methodName, paramsDecl, params)
+#define DECL_DRIVER_API_RETURN(RetType, methodName, paramsDecl, params) methodName##R,
+#include "private/backend/DriverAPI.inc"
+    COUNT,
+
+    // the commands in between were executed by one Driver::execute() call
+    BEGIN_BUFFER = 0xFFFE,
+    END_BUFFER = 0xFFFF,
+};
+
+char const* getTraceCommandName(TraceCommand command) noexcept;
+
+struct TraceHeader {
+    static constexpr uint32_t MAGIC = 0x43525446; // 'FTRC'
+    static constexpr uint32_t VERSION = 1;
+    uint32_t magic = MAGIC;
+    uint32_t version = VERSION;
+    // a trace recorded with a different DriverAPI.inc can't be replayed
+    uint32_t commandCount = uint32_t(TraceCommand::COUNT);
+};
+
+class TraceWriter {
+public:
+    std::vector<uint8_t> const& getData() const noexcept { return mData; }
+
+    void clear() noexcept { mData.clear(); }
+
+    void command(TraceCommand command) {
+        write(uint16_t(command));
+    }
+
+    template<typename T, typename = std::enable_if_t<std::is_trivially_copyable_v<T>>>
+    void write(T const& value) {
+        append(&value, sizeof(T));
+    }
+
+    template<typename T>
+    void write(Handle<T> const& handle) {
+        write(handle.getId());
+    }
+
+    void write(utils::CString const& str);
+    void write(BufferDescriptor const& data);
+    void write(BufferObjectStreamDescriptor const& streams);
+    void write(DescriptorSetLayout const& info);
+    void write(Program const& program);
+
+    // the size of the array isn't known to it, see CaptureDriver
+    void write(DescriptorSetOffsetArray const& offsets, uint32_t count);
+
+    void write(CallbackHandler*) noexcept {}
+    void write(CallbackHandler::Callback) noexcept {}
+    void write(void*) noexcept {}
+
+private:
+    void append(void const* data, size_t size) {
+        if (!size) {
+            return;
+        }
+        size_t const offset = mData.size();
+        mData.resize(offset + size);
+        memcpy(mData.data() + offset, data, size);
+    }
+
+    std::vector<uint8_t> mData;
+};
+
+class TraceReader {
+public:
+    // the trace must outlive the reader, BufferDescriptors point into it
+    TraceReader(void const* data, size_t size) noexcept;
+
+    bool empty() const noexcept { return mCurrent == mEnd; }
+
+    TraceCommand command() {
+        uint16_t command;
+        read(command);
+        return TraceCommand(command);
+    }
+
+    template<typename T, typename = std::enable_if_t<std::is_trivially_copyable_v<T>>>
+    void read(T& value) {
+        memcpy(&value, consume(sizeof(T)), sizeof(T));
+    }
+
+    template<typename T>
+    void read(Handle<T>& handle) {
+        HandleBase::HandleId id;
+        read(id);
+        handle = id == HandleBase::nullid ? Handle<T>{} : Handle<T>{ id };
+    }
+
+    void read(utils::CString& str);
+    void read(BufferDescriptor& data);
+    void read(BufferObjectStreamDescriptor& streams);
+    void read(DescriptorSetLayout& info);
+    void read(Program& program);
+
+    // returns the offsets of a DescriptorSetOffsetArray, which the caller must allocate
+    uint32_t const* readOffsets(uint32_t& count);
+
+    void read(CallbackHandler*& handler) noexcept { handler = nullptr; }
+    void read(CallbackHandler::Callback& callback) noexcept { callback = nullptr; }
+    void read(void*& user) noexcept { user = nullptr; }
+
+private:
+    uint8_t const* consume(size_t size);
+
+    uint8_t const* mCurrent;
+    uint8_t const* const mEnd;
+};
+
+} // namespace filament::backend
+
+#endif // TNT_FILAMENT_BACKEND_TRACE_COMMANDTRACE_H
@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "TraceReplayer.h"
+
+#include "CommandTrace.h"
+
+#include "private/backend/CircularBuffer.h"
+#include "private/backend/CommandStream.h"
+#include "private/backend/Driver.h"
+#include "private/backend/DriverApi.h"
+
+#include <backend/DescriptorSetOffsetArray.h>
+
+#include <utils/compiler.h>
+#include <utils/Panic.h>
+
+#include <algorithm>
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+namespace filament::backend {
+
+void TraceReplayer::Histogram::add(uint64_t const duration) noexcept {
+    count++;
+    total += duration;
+    min = std::min(min, duration);
+    max = std::max(max, duration);
+    size_t bucket = 0;
+    while (bucket < BUCKET_COUNT - 1 && (duration >> (bucket + 1))) {
+        bucket++;
+    }
+    buckets[bucket]++;
+}
+
+uint64_t TraceReplayer::Histogram::percentile(double const p) const noexcept {
+    uint64_t const target = uint64_t(double(count) * p);
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BUCKET_COUNT; i++) {
+        seen += buckets[i];
+        if (seen > target) {
+            return std::min(max, (uint64_t(1) << (i + 1)) - 1);
+        }
+    }
+    return max;
+}
+
+// ------------------------------------------------------------------------------------------------
+
+TraceReplayer::TraceReplayer(Driver& driver)
+        : mDriver(driver),
+          mScratchBuffer(CircularBuffer::getBlockSize()),
+          mScratch(driver, mScratchBuffer) {
+}
+
+void TraceReplayer::replay(void const* trace, size_t const size, Stats& stats) {
+    mScratch.debugThreading();
+
+    TraceHeader header;
+    FILAMENT_CHECK_PRECONDITION(size >= sizeof(header)) << "not a command trace";
+    memcpy(&header, trace, sizeof(header));
+    FILAMENT_CHECK_PRECONDITION(header.magic == TraceHeader::MAGIC) << "not a command trace";
+    FILAMENT_CHECK_PRECONDITION(header.version == TraceHeader::VERSION &&
+            header.commandCount == uint32_t(TraceCommand::COUNT))
+            << "the command trace was recorded by another version of filament";
+
+    TraceReader reader(static_cast<uint8_t const*>(trace) + sizeof(header), size - sizeof(header));
+    while (!reader.empty()) {
+        TraceCommand const command = reader.command();
+        FILAMENT_CHECK_POSTCONDITION(command == TraceCommand::BEGIN_BUFFER)
+                << "corrupted command trace";
+        replayBuffer(reader, stats);
+    }
+}
+
+void TraceReplayer::replayBuffer(TraceReader& reader, Stats& stats) {
+    // replay the buffer within Driver::execute(), like CommandStream::execute() does
+    mDriver.execute([this, &reader, &stats]() {
+        while (true) {
+            TraceCommand const command = reader.command();
+            switch (command) {
+                case TraceCommand::BEGIN_BUFFER:
+                    replayBuffer(reader, stats);
+                    break;
+                case TraceCommand::END_BUFFER:
+                    return;
+#define DECL_DRIVER_API(methodName, paramsDecl, params)                                         \
+                case TraceCommand::methodName:                                                  \
+                    replayCommand(reader, stats[size_t(command)], &Driver::methodName);         \
+                    break;
+#define DECL_DRIVER_API_SYNCHRONOUS(RetType, methodName, paramsDecl, params)
+#define DECL_DRIVER_API_RETURN(RetType, methodName, paramsDecl, params)                         \
+                case TraceCommand::methodName##R:                                               \
+                    replayCreate(reader, stats[size_t(command)],                                \
+                            &Driver::methodName##S, &Driver::methodName##R);                    \
+                    break;
+#include "private/backend/DriverAPI.inc"
+                default:
+                    FILAMENT_CHECK_POSTCONDITION(false) << "corrupted command trace";
+                    return;
+            }
+        }
+    });
+}
+
+HandleBase::HandleId TraceReplayer::translate(HandleBase::HandleId const id) const noexcept {
+    auto const pos = mHandles.find(id);
+    return pos != mHandles.end() ? pos->second : id;
+}
+
+void TraceReplayer::read(TraceReader& reader, DescriptorSetOffsetArray& offsets) {
+    uint32_t count;
+    uint32_t const* const data = reader.readOffsets(count);
+    if (count) {
+        offsets = DescriptorSetOffsetArray(count, mScratch);
+        std::copy_n(data, count, offsets.data());
+    }
+}
+
+} // namespace filament::backend
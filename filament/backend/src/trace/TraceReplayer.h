@@ -0,0 +1,154 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_FILAMENT_BACKEND_TRACE_TRACEREPLAYER_H
+#define TNT_FILAMENT_BACKEND_TRACE_TRACEREPLAYER_H
+
+#include "CommandTrace.h"
+
+#include "private/backend/CircularBuffer.h"
+#include "private/backend/CommandStream.h"
+#include "private/backend/Driver.h"
+
+#include <backend/DescriptorSetOffsetArray.h>
+#include <backend/Handle.h>
+
+#include <utils/CString.h>
+
+#include <array>
+#include <chrono>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace filament::backend {
+
+/*
+ * Executes the commands of a trace written by CaptureDriver with a Driver, as fast as possible,
+ * and measures how long each one takes.
+ *
+ * The handles are allocated with the Driver's *S() methods, and the captured handles are
+ * translated to them.
+ * Must be called from a single thread, which becomes the Driver's render thread.
+ */
+class TraceReplayer {
+public:
+    // Durations of a command, bucket i counts the durations in [2^i, 2^(i+1)) ns.
+    struct Histogram {
+        static constexpr size_t BUCKET_COUNT = 40;
+        uint64_t count = 0;
+        uint64_t total = 0;     // ns
+        uint64_t min = UINT64_MAX;
+        uint64_t max = 0;
+        std::array<uint64_t, BUCKET_COUNT> buckets{};
+
+        void add(uint64_t duration) noexcept;
+
+        // upper bound of the bucket containing the given percentile, in ns
+        uint64_t percentile(double p) const noexcept;
+    };
+
+    using Stats = std::array<Histogram, size_t(TraceCommand::COUNT)>;
+
+    explicit TraceReplayer(Driver& driver);
+
+    // Replays a whole trace, including its header. Adds the durations to `stats`.
+    void replay(void const* trace, size_t size, Stats& stats);
+
+private:
+    using clock = std::chrono::steady_clock;
+
+    void replayBuffer(TraceReader& reader, Stats& stats);
+
+    template<typename ... ARGS>
+    void replayCommand(TraceReader& reader, Histogram& histogram,
+            void (Driver::*method)(ARGS...)) {
+        using Args = std::tuple<std::decay_t<ARGS>...>;
+        Args args;
+        std::apply([this, &reader](auto& ... arg) { (read(reader, arg), ...); }, args);
+        if constexpr (std::is_same_v<Args, std::tuple<HandleBase::HandleId, utils::CString>>) {
+            // setDebugTag() takes the id of any handle
+            std::get<0>(args) = translate(std::get<0>(args));
+        }
+        measure(histogram, [this, method, &args]() {
+            std::apply([this, method](auto& ... arg) {
+                (mDriver.*method)(std::forward<ARGS>(arg)...);
+            }, args);
+        });
+    }
+
+    // the driver allocates the handle, which replaces the captured one in the next commands
+    template<typename T, typename ... ARGS>
+    void replayCreate(TraceReader& reader, Histogram& histogram,
+            Handle<T> (Driver::*allocate)() noexcept, void (Driver::*method)(Handle<T>, ARGS...)) {
+        Handle<T> captured;
+        reader.read(captured);
+        Handle<T> handle = (mDriver.*allocate)();
+        mHandles[captured.getId()] = handle.getId();
+        std::tuple<std::decay_t<ARGS>...> args;
+        std::apply([this, &reader](auto& ... arg) { (read(reader, arg), ...); }, args);
+        measure(histogram, [this, method, &handle, &args]() {
+            std::apply([this, method, &handle](auto& ... arg) {
+                (mDriver.*method)(std::move(handle), std::forward<ARGS>(arg)...);
+            }, args);
+        });
+    }
+
+    template<typename F>
+    void measure(Histogram& histogram, F&& command) {
+        clock::time_point const start = clock::now();
+        command();
+        clock::time_point const end = clock::now();
+        histogram.add(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+        // the arrays of dynamic offsets aren't needed anymore
+        mScratchBuffer.getBuffer();
+    }
+
+    template<typename T>
+    void read(TraceReader& reader, T& value) {
+        reader.read(value);
+    }
+
+    template<typename T>
+    void read(TraceReader& reader, Handle<T>& handle) {
+        reader.read(handle);
+        if (handle) {
+            handle = Handle<T>{ translate(handle.getId()) };
+        }
+    }
+
+    // the ids which weren't created by the trace are kept as they are
+    HandleBase::HandleId translate(HandleBase::HandleId id) const noexcept;
+
+    void read(TraceReader& reader, DescriptorSetOffsetArray& offsets);
+
+    Driver& mDriver;
+
+    // captured handle id to the id allocated by mDriver
+    std::unordered_map<HandleBase::HandleId, HandleBase::HandleId> mHandles;
+
+    // DescriptorSetOffsetArrays are allocated from a CommandStream
+    CircularBuffer mScratchBuffer;
+    CommandStream mScratch;
+};
+
+} // namespace filament::backend
+
+#endif // TNT_FILAMENT_BACKEND_TRACE_TRACEREPLAYER_H
@@ -22,6 +22,11 @@
 
 #include <spirv/unified1/spirv.hpp>
 
+#if FVK_ENABLE_SPIRV_OPT
+#include <spirv-tools/optimizer.hpp>
+#endif
+
+#include <algorithm>
 #include <cstring>
 #include <unordered_map>
 #include <vector>
@@ -32,7 +37,7 @@ namespace {
 
 // This function transforms an OpSpecConstant instruction into just a OpConstant instruction.
 // Additionally, it will adjust the value of the constant as given by the program.
-void getTransformedConstantInst(SpecConstantValue* value, uint32_t* inst) {
+void getTransformedConstantInst(SpecConstantValue const* value, uint32_t* inst) {
 
     // The first word is the size of the instruction and the instruction type.
     // The second word is the type of the instruction.
@@ -71,37 +76,37 @@ void getTransformedConstantInst(SpecConstantValue* value, uint32_t* inst) {
 void workaroundSpecConstant(Program::ShaderBlob const& blob,
         utils::FixedCapacityVector<Program::SpecializationConstant> const& specConstants,
         std::vector<uint32_t>& output) {
+    SpecConstantPatchTable const table = analyzeSpecConstants(blob);
+    output.resize(table.outputSize);
+    workaroundSpecConstant(blob, table, specConstants, output.data());
+}
+
+SpecConstantPatchTable analyzeSpecConstants(Program::ShaderBlob const& blob) {
     using WordMap = std::unordered_map<uint32_t, uint32_t>;
-    using SpecValueMap = std::unordered_map<uint32_t, SpecConstantValue>;
+    using Span = SpecConstantPatchTable::Span;
+    using Patch = SpecConstantPatchTable::Patch;
     constexpr size_t HEADER_SIZE = 5;
 
-    WordMap varToIdMap;
-    SpecValueMap idToValue;
-
-    for (auto spec: specConstants) {
-        idToValue[spec.id] = spec.value;
-    }
-
     // The follow loop will iterate through all the instructions and look for instructions of the
     // form:
     //
     //     OpDecorate %1 SpecId 0
     //     %1 = OpSpecConstantFalse %bool
     //
-    // We want to track the mapping between the variable id %1 and the specId 0. And when seeing a
-    // %1 as the result, we want to change that instruction to just an OpConsant where the constant
-    // value is adjusted by the spec values provided in the program.
-    // Additionally, we will turn the SpecId decorations to no-ops.
-    size_t const dataSize = blob.size() / 4;
+    // We want to track the mapping between the variable id %1 and the specId 0, and record where
+    // %1's instruction ends up in the output, so it can later be changed to an OpConstant with
+    // the value provided by the program. The SpecId decorations are dropped from the output.
+    uint32_t const dataSize = uint32_t(blob.size() / 4);
+    uint32_t const* const data = (uint32_t const*) blob.data();
 
-    output.resize(dataSize);
-    uint32_t const* data = (uint32_t*) blob.data();
-    uint32_t* outputData = output.data();
+    WordMap varToIdMap;
+    std::vector<Span> spans;
+    std::vector<Patch> patches;
 
-    memcpy(&outputData[0], &data[0], HEADER_SIZE * 4);
-    size_t outputCursor = HEADER_SIZE;
+    uint32_t spanBegin = 0;
+    uint32_t outputCursor = HEADER_SIZE;
 
-    for (uint32_t cursor = HEADER_SIZE, cursorEnd = dataSize; cursor < cursorEnd;) {
+    for (uint32_t cursor = HEADER_SIZE; cursor < dataSize;) {
         uint32_t const firstWord = data[cursor];
         uint32_t const wordCount = firstWord >> 16;
         uint32_t const op = firstWord & 0x0000FFFF;
@@ -112,15 +117,13 @@ void workaroundSpecConstant(Program::ShaderBlob const& blob,
             case spv::Op::OpSpecConstantFalse: {
                 uint32_t const targetVar = data[cursor + 2];
 
-                UTILS_UNUSED_IN_RELEASE WordMap::const_iterator idItr = varToIdMap.find(targetVar);
+                WordMap::const_iterator const idItr = varToIdMap.find(targetVar);
                 assert_invariant(idItr != varToIdMap.end() &&
                         "Cannot find variable previously decorated with SpecId");
 
-                auto valItr = idToValue.find(idItr->second);
-
-                SpecConstantValue* val = (valItr != idToValue.end()) ? &valItr->second : nullptr;
-                std::memcpy(&outputData[outputCursor], &data[cursor], wordCount * 4);
-                getTransformedConstantInst(val, &outputData[outputCursor]);
+                if (UTILS_LIKELY(idItr != varToIdMap.end())) {
+                    patches.push_back({ outputCursor, idItr->second });
+                }
                 outputCursor += wordCount;
                 break;
             }
@@ -130,20 +133,96 @@ void workaroundSpecConstant(Program::ShaderBlob const& blob,
                     uint32_t const specId = data[cursor + 3];
                     varToIdMap[targetVar] = specId;
 
-                    // Note these decorations do not need to be written to the output.
+                    // Note these decorations do not need to be written to the output, close the
+                    // current span and start the next one after this instruction.
+                    if (spanBegin != cursor) {
+                        spans.push_back({ spanBegin, cursor });
+                    }
+                    spanBegin = cursor + wordCount;
                     break;
                 }
                 // else fallthrough and copy like all other instructions
                 UTILS_FALLTHROUGH;
             }
             default:
-                std::memcpy(&outputData[outputCursor], &data[cursor], wordCount * 4);
                 outputCursor += wordCount;
                 break;
         }
         cursor += wordCount;
     }
-    output.resize(outputCursor);
+    if (spanBegin < dataSize) {
+        spans.push_back({ spanBegin, dataSize });
+    }
+
+    SpecConstantPatchTable table;
+    table.spans = utils::FixedCapacityVector<Span>::with_capacity(spans.size());
+    for (auto const& span : spans) {
+        table.spans.push_back(span);
+    }
+    table.patches = utils::FixedCapacityVector<Patch>::with_capacity(patches.size());
+    for (auto const& patch : patches) {
+        table.patches.push_back(patch);
+    }
+    table.outputSize = outputCursor;
+    return table;
+}
+
+size_t workaroundSpecConstant(Program::ShaderBlob const& blob, SpecConstantPatchTable const& table,
+        utils::FixedCapacityVector<Program::SpecializationConstant> const& specConstants,
+        uint32_t* output) noexcept {
+    uint32_t const* const data = (uint32_t const*) blob.data();
+
+    uint32_t* out = output;
+    for (auto const& span : table.spans) {
+        size_t const count = span.end - span.begin;
+        std::memcpy(out, &data[span.begin], count * 4);
+        out += count;
+    }
+    assert_invariant(size_t(out - output) == table.outputSize);
+
+    // There are only a handful of constants, a linear search beats any map here.
+    for (auto const& patch : table.patches) {
+        auto const pos = std::find_if(specConstants.begin(), specConstants.end(),
+                [specId = patch.specId](auto const& sc) { return sc.id == specId; });
+        SpecConstantValue const* const val =
+                (pos != specConstants.end()) ? &pos->value : nullptr;
+        getTransformedConstantInst(val, &output[patch.offset]);
+    }
+    return table.outputSize;
+}
+
+bool stripDeadCode(std::vector<uint32_t>& spirv) {
+#if FVK_ENABLE_SPIRV_OPT
+    struct DeadCodeOptimizer {
+        spvtools::Optimizer optimizer{ SPV_ENV_VULKAN_1_0 };
+        spvtools::OptimizerOptions options;
+        DeadCodeOptimizer() {
+            optimizer
+                    .RegisterPass(spvtools::CreateFoldSpecConstantOpAndCompositePass())
+                    .RegisterPass(spvtools::CreateDeadBranchElimPass())
+                    .RegisterPass(spvtools::CreateEliminateDeadFunctionsPass())
+                    .RegisterPass(spvtools::CreateAggressiveDCEPass())
+                    .RegisterPass(spvtools::CreateDeadVariableEliminationPass())
+                    .RegisterPass(spvtools::CreateEliminateDeadConstantPass())
+                    .RegisterPass(spvtools::CreateCFGCleanupPass());
+            // the module comes from matc and only had constants substituted
+            options.set_run_validator(false);
+            options.set_preserve_bindings(true);
+        }
+    };
+    // building the pass list isn't free, and Run() leaves the optimizer untouched
+    static DeadCodeOptimizer const dco;
+
+    std::vector<uint32_t> optimized;
+    if (!dco.optimizer.Run(spirv.data(), spirv.size(), &optimized, dco.options)) {
+        return false;
+    }
+    spirv.swap(optimized);
+    return true;
+#else
+    (void)spirv;
+    return false;
+#endif
 }
 
 } // namespace filament::backend::fvkutils
@@ -24,6 +24,9 @@
 #include <tuple>
 #include <vector>
 
+#include <stddef.h>
+#include <stdint.h>
+
 namespace filament::backend::fvkutils {
 
 using SpecConstantValue = Program::SpecializationConstant::Type;
@@ -43,6 +46,49 @@ void workaroundSpecConstant(Program::ShaderBlob const& blob,
         utils::FixedCapacityVector<Program::SpecializationConstant> const& specConstants,
         std::vector<uint32_t>& output);
 
+// The work done by workaroundSpecConstant() above only depends on the blob, not on the values
+// of the constants. SpecConstantPatchTable records it once per blob, so that specializing is
+// reduced to copying a few spans of words and patching the OpSpecConstant* instructions.
+struct SpecConstantPatchTable {
+    // A range of words [begin, end) of the input blob that is copied verbatim; the SpecId
+    // decorations fall in between spans.
+    struct Span {
+        uint32_t begin;
+        uint32_t end;
+    };
+
+    // An OpSpecConstant* instruction, at word `offset` of the *output*.
+    struct Patch {
+        uint32_t offset;
+        uint32_t specId;
+    };
+
+    utils::FixedCapacityVector<Span> spans;
+    utils::FixedCapacityVector<Patch> patches;
+
+    // size of the specialized module, in words
+    uint32_t outputSize = 0;
+
+    bool empty() const noexcept { return outputSize == 0; }
+};
+
+// Scans `blob` and returns its patch table.
+SpecConstantPatchTable analyzeSpecConstants(Program::ShaderBlob const& blob);
+
+// Specializes `blob` into `output`, which must hold at least table.outputSize words.
+// Doesn't allocate. Returns the number of words written.
+size_t workaroundSpecConstant(Program::ShaderBlob const& blob, SpecConstantPatchTable const& table,
+        utils::FixedCapacityVector<Program::SpecializationConstant> const& specConstants,
+        uint32_t* output) noexcept;
+
+// Once the spec constants are folded, the branches they guarded (e.g. disabled shadows or fog)
+// are statically dead. This runs constant-branch folding followed by dead function, variable and
+// constant elimination on a specialized module. Descriptor bindings are preserved, even if unused,
+// so that the resource layout doesn't depend on the specialization.
+// Returns false and leaves `spirv` untouched if the optimizer is not available
+// (FVK_ENABLE_SPIRV_OPT) or failed.
+bool stripDeadCode(std::vector<uint32_t>& spirv);
+
 // bindings for UBO, samplers, input attachment
 // This is no longer needed after the descriptor set refactor, but the code is good for reference. 
 // std::tuple<uint32_t, uint32_t, uint32_t> getProgramBindings(Program::ShaderBlob const& blob);
@@ -401,6 +401,15 @@ public:
          * @deprecated use "backend.opengl.assert_native_window_is_valid" feature flag instead
          */
         bool assertNativeWindowIsValid = false;
+
+        /**
+         * Path of the compiled default material package (.filamat), which is used by the materials
+         * that don't provide some of their programs.
+         *
+         * If null, the path is taken from the FILAMENT_DEFAULT_MATERIAL environment variable.
+         * Engine creation fails when the package can't be read.
+         */
+        const char* UTILS_NULLABLE defaultMaterialPath = nullptr;
     };
 
 
@@ -68,6 +68,7 @@ public:
     using CullingMode = backend::CullingMode;
     using ShaderModel = backend::ShaderModel;
     using SubpassType = backend::SubpassType;
+    using ParameterHandle = MaterialInstance::ParameterHandle;
 
     /**
      * Holds information about a material parameter.
@@ -350,6 +351,22 @@ public:
     //! Indicates whether an existing parameter is a sampler or not.
     bool isSampler(const char* UTILS_NONNULL name) const noexcept;
 
+    /**
+     * Resolves a parameter name once, so it can be set on this material's instances without
+     * a name lookup.
+     *
+     * @param name          Name of the parameter as defined by Material. Cannot be nullptr.
+     * @param nameLength    Length in `char` of the name parameter.
+     * @return A handle to the parameter, which is invalid if the parameter doesn't exist.
+     * @see MaterialInstance::setParameter
+     */
+    ParameterHandle getParameterHandle(const char* UTILS_NONNULL name, size_t nameLength) const noexcept;
+
+    /** inline helper to provide the name as a null-terminated C string */
+    ParameterHandle getParameterHandle(const char* UTILS_NONNULL name) const noexcept {
+        return getParameterHandle(name, strlen(name));
+    }
+
     /**
      * Sets the value of the given parameter on this material's default instance.
      *
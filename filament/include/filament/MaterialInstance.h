@@ -63,6 +63,34 @@ public:
     using StencilOperation = backend::StencilOperation;
     using StencilFace = backend::StencilFace;
 
+    /**
+     * A material parameter resolved ahead of time, see Material::getParameterHandle().
+     *
+     * Setting a parameter through its handle skips the name lookup, which is worthwhile when
+     * the same parameters are set on many instances every frame. A handle is only valid with
+     * instances of the Material it was obtained from.
+     */
+    class ParameterHandle {
+    public:
+        ParameterHandle() noexcept = default;
+
+        //! Whether this handle refers to a parameter of its material.
+        bool isValid() const noexcept { return mKind != Kind::INVALID; }
+
+        //! Whether this handle refers to a sampler (texture) parameter.
+        bool isSampler() const noexcept { return mKind == Kind::SAMPLER; }
+
+    private:
+        friend class FMaterial;
+        friend class FMaterialInstance;
+        enum class Kind : uint8_t { INVALID, UNIFORM, SAMPLER };
+        Material const* UTILS_NULLABLE mMaterial = nullptr;
+        uint32_t mOffset = 0;   // offset in bytes in the uniform buffer, or sampler binding
+        uint16_t mCount = 0;    // number of elements for arrays, 1 otherwise
+        backend::UniformType mType{};
+        Kind mKind = Kind::INVALID;
+    };
+
     template<typename T>
     using is_supported_parameter_t = std::enable_if_t<
             std::is_same_v<float, T> ||
@@ -235,6 +263,56 @@ public:
         setParameter(name, strlen(name), type, color);
     }
 
+    /**
+     * Set a uniform from a handle obtained from this instance's Material.
+     *
+     * @param handle        A valid handle to a uniform of type T.
+     * @param value         Value of the parameter to set.
+     * @throws utils::PreConditionPanic if the handle doesn't refer to a uniform of type T of this
+     *         instance's material, or no-op if exceptions are disabled.
+     * @see Material::getParameterHandle
+     */
+    template<typename T, typename = is_supported_parameter_t<T>>
+    void setParameter(ParameterHandle handle, T const& value);
+
+    /**
+     * Set a uniform array from a handle obtained from this instance's Material.
+     *
+     * @param handle        A valid handle to a uniform array of type T.
+     * @param values        Array of values to set to the parameter array.
+     * @param count         Size of the array to set, at most the size of the parameter array.
+     * @throws utils::PreConditionPanic if the handle doesn't refer to a uniform array of type T of
+     *         this instance's material, or no-op if exceptions are disabled.
+     * @see Material::getParameterHandle
+     */
+    template<typename T, typename = is_supported_parameter_t<T>>
+    void setParameter(ParameterHandle handle, const T* UTILS_NONNULL values, size_t count);
+
+    /**
+     * Set a texture from a handle obtained from this instance's Material.
+     *
+     * @param handle        A valid handle to a sampler parameter.
+     * @param texture       Non nullptr Texture object pointer.
+     * @param sampler       Sampler parameters.
+     * @throws utils::PreConditionPanic if the handle doesn't refer to a sampler of this instance's
+     *         material, or no-op if exceptions are disabled.
+     * @see Material::getParameterHandle
+     */
+    void setParameter(ParameterHandle handle,
+            Texture const* UTILS_NULLABLE texture, TextureSampler const& sampler);
+
+    /**
+     * Set an RGB color from a handle obtained from this instance's Material.
+     * A conversion might occur depending on the specified type
+     */
+    void setParameter(ParameterHandle handle, RgbType type, math::float3 color);
+
+    /**
+     * Set an RGBA color from a handle obtained from this instance's Material.
+     * A conversion might occur depending on the specified type
+     */
+    void setParameter(ParameterHandle handle, RgbaType type, math::float4 color);
+
     /**
      * Gets the value of a parameter by name.
      * 
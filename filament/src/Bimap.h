@@ -0,0 +1,156 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_FILAMENT_BIMAP_H
+#define TNT_FILAMENT_BIMAP_H
+
+#include <tsl/robin_map.h>
+
+#include <utils/debug.h>
+
+#include <functional>
+#include <memory>
+#include <new>
+#include <utility>
+
+#include <stddef.h>
+
+namespace filament {
+
+/*
+ * A semi-bidirectional map: values can be looked up by key and keys by value.
+ *
+ * Keys are copied once into storage obtained from `Allocator` (which typically is an arena) and
+ * both maps only store pointers to them, so large keys aren't duplicated. Values are expected to
+ * be small (e.g. a handle).
+ */
+template<typename Key, typename Value,
+        typename KeyHash = std::hash<Key>,
+        typename ValueHash = std::hash<Value>,
+        typename Allocator = std::allocator<Key>>
+class Bimap {
+    struct KeyDelegate {
+        Key const* pKey = nullptr;
+        bool operator==(KeyDelegate const& rhs) const noexcept {
+            return *pKey == *rhs.pKey;
+        }
+    };
+
+    struct KeyHasherDelegate {
+        KeyHash keyHasher;
+        size_t operator()(KeyDelegate const& p) const noexcept {
+            return keyHasher(*p.pKey);
+        }
+    };
+
+    using ForwardMap = tsl::robin_map<
+            KeyDelegate, Value,
+            KeyHasherDelegate,
+            std::equal_to<KeyDelegate>,
+            std::allocator<std::pair<KeyDelegate, Value>>,
+            true>;  // the key hash is potentially expensive, store it
+
+    using BackwardMap = tsl::robin_map<
+            Value, KeyDelegate,
+            ValueHash,
+            std::equal_to<Value>,
+            std::allocator<std::pair<Value, KeyDelegate>>,
+            false>;
+
+    Allocator mAllocator;
+    ForwardMap mForwardMap;
+    BackwardMap mBackwardMap;
+
+public:
+    Bimap() = default;
+
+    explicit Bimap(Allocator&& allocator)
+            : mAllocator(std::forward<Allocator>(allocator)) {
+    }
+
+    Bimap(Bimap const&) = delete;
+    Bimap& operator=(Bimap const&) = delete;
+
+    ~Bimap() noexcept {
+        clear();
+    }
+
+    void reserve(size_t const capacity) {
+        mForwardMap.reserve(capacity);
+        mBackwardMap.reserve(capacity);
+    }
+
+    bool empty() const noexcept {
+        return mForwardMap.empty();
+    }
+
+    size_t size() const noexcept {
+        return mForwardMap.size();
+    }
+
+    // the key is copied, `value` must not be in the map already
+    void insert(Key const& key, Value const& value) {
+        Key* const pKey = mAllocator.allocate(1);
+        new(pKey) Key(key);
+        mForwardMap.insert({{ pKey }, value });
+        mBackwardMap.insert({ value, { pKey }});
+    }
+
+    typename ForwardMap::const_iterator end() const noexcept {
+        return mForwardMap.end();
+    }
+
+    typename BackwardMap::const_iterator endValue() const noexcept {
+        return mBackwardMap.end();
+    }
+
+    typename ForwardMap::const_iterator find(Key const& key) const {
+        return mForwardMap.find(KeyDelegate{ &key });
+    }
+
+    typename BackwardMap::const_iterator findValue(Value const& value) const {
+        return mBackwardMap.find(value);
+    }
+
+    void erase(typename BackwardMap::const_iterator const pos) {
+        Key const* const pKey = pos->second.pKey;
+        mForwardMap.erase(KeyDelegate{ pKey });
+        mBackwardMap.erase(pos);
+        pKey->~Key();
+        mAllocator.deallocate(const_cast<Key*>(pKey), 1);
+    }
+
+    // calls `f(key, value)` for each entry
+    template<typename F>
+    void forEach(F&& f) const {
+        for (auto const& [key, value] : mForwardMap) {
+            f(*key.pKey, value);
+        }
+    }
+
+    void clear() noexcept {
+        for (auto const& [key, value] : mForwardMap) {
+            key.pKey->~Key();
+            mAllocator.deallocate(const_cast<Key*>(key.pKey), 1);
+        }
+        mForwardMap.clear();
+        mBackwardMap.clear();
+    }
+};
+
+} // namespace filament
+
+#endif // TNT_FILAMENT_BIMAP_H
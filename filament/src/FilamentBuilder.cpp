@@ -18,14 +18,34 @@
 #include <details/Engine.h>
 #include <details/VertexBuffer.h>
 #include <details/Material.h>
+#include <details/MaterialInstance.h>
 #include <details/IndirectLight.h>
 #include "details/Skybox.h"
+#include <details/Texture.h>
 #include <components/LightManager.h>
 #include <backend/DriverEnums.h>
+#include <private/backend/CommandBufferQueue.h>
+#include <private/backend/SecondaryCommandStreams.h>
 #include <private/backend/Driver.h>
+#if !defined(FILAMENT_HEADLESS)
+#include "diligent/DiligentDriver.h"
+#endif
+#include "noop/NoopDriver.h"
+#include "trace/CaptureDriver.h"
+#include <utils/JobSystem.h>
+#include <utils/Log.h>
+#include <utils/Panic.h>
 #include <algorithm>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <new>
+#include <thread>
+#include <utility>
+#include <vector>
 
 #include <fcntl.h>
+#include <stdlib.h>
 #if !defined(WIN32)
 #    include <unistd.h>
 #else
@@ -49,11 +69,6 @@ backend::FeatureLevel Engine::getActiveFeatureLevel() const noexcept {
 	return downcast(this)->getActiveFeatureLevel();
 }
 
-HwVertexBufferInfoFactory::HwVertexBufferInfoFactory() {}
-HwVertexBufferInfoFactory::~HwVertexBufferInfoFactory() noexcept {}
-HwDescriptorSetLayoutFactory::HwDescriptorSetLayoutFactory() {}
-HwDescriptorSetLayoutFactory::~HwDescriptorSetLayoutFactory() noexcept {}
-
 static size_t fileSize(int fd) {
 	size_t filesize;
 	filesize = (size_t)lseek(fd, 0, SEEK_END);
@@ -64,18 +79,63 @@ static size_t fileSize(int fd) {
 FEngine::FEngine()
 	: mLightManager(*this)
 	, mCameraManager(*this)
+	, mCommandBufferQueue(mConfig.minCommandBufferSizeMB * MiB, mConfig.commandBufferSizeMB * MiB, false)
 {
-	int fd = open("D:\\filament-1.59.4\\samples\\materials\\aiDefaultMat.filamat", O_RDONLY);
-	size_t size = fileSize(fd);
-	char* data = (char*)malloc(size);
-	read(fd, data, size);
+	// the engine thread takes part in the jobs it schedules (e.g. material variant precaching)
+	mJobSystem.adopt();
+	mMainThreadId = std::this_thread::get_id();
+}
+
+FEngine::~FEngine() noexcept {
+	assert_invariant(!mDriverThread.joinable());
+	delete mDriver;
+}
+
+// Reads the whole file, returns an empty vector if it can't be read.
+static std::vector<char> readFile(const char* path) {
+	std::vector<char> data;
+	int const fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		return data;
+	}
+	data.resize(fileSize(fd));
+	auto const n = read(fd, data.data(), unsigned(data.size()));
+	if (n < 0 || size_t(n) != data.size()) {
+		data.clear();
+	}
+	close(fd);
+	return data;
+}
+
+bool FEngine::init() {
+	// this must be first.
+	assert_invariant(intptr_t(&mDriverApiStorage) % alignof(DriverApi) == 0);
+	::new(&mDriverApiStorage) DriverApi(*mDriver, mCommandBufferQueue.getCircularBuffer());
+
+	// commands are recorded on this thread only
+	getDriverApi().debugThreading();
+
+	mSecondaryCommandStreams.emplace(*mDriver,
+		mConfig.minCommandBufferSizeMB * MiB, mConfig.commandBufferSizeMB * MiB);
+
+	char const* const defaultMaterialPath = mConfig.defaultMaterialPath ?
+		mConfig.defaultMaterialPath : getenv("FILAMENT_DEFAULT_MATERIAL");
+	std::vector<char> const defaultMaterialPackage =
+		defaultMaterialPath ? readFile(defaultMaterialPath) : std::vector<char>{};
+	if (UTILS_UNLIKELY(defaultMaterialPackage.empty())) {
+		utils::slog.e << "could not read the default material package \""
+			<< (defaultMaterialPath ? defaultMaterialPath : "") << "\", set "
+			<< "Config::defaultMaterialPath or FILAMENT_DEFAULT_MATERIAL" << utils::io::endl;
+		return false;
+	}
 
 	FMaterial::DefaultMaterialBuilder defaultMaterialBuilder;
 	switch (mConfig.stereoscopicType) {
 	case StereoscopicType::NONE:
 	case StereoscopicType::INSTANCED:
+		// the parser keeps a copy of the package
 		defaultMaterialBuilder.package(
-			data, size
+			defaultMaterialPackage.data(), defaultMaterialPackage.size()
 			//MATERIALS_DEFAULTMATERIAL_DATA, MATERIALS_DEFAULTMATERIAL_SIZE
 		);
 		break;
@@ -94,12 +154,190 @@ FEngine::FEngine()
 	mDefaultIbl = downcast(IndirectLight::Builder()
 		.irradiance(3, reinterpret_cast<const math::float3*>(sh))
 		.build(*this));
+
+	mInitialized = true;
+	return true;
 }
-Engine* FEngine::create() {
+
+Engine* FEngine::create([[maybe_unused]] Backend const api) {
 	FEngine* instance = new FEngine();
+#if !defined(FILAMENT_HEADLESS)
+	if (api != Backend::NOOP) {
+		instance->mDriver = backend::DiligentDriver::create();
+	} else
+#endif
+	{
+		// no GPU needed, e.g. for measuring the CPU side of a frame
+		instance->mBackend = Backend::NOOP;
+		instance->mDriver = backend::NoopDriver::create();
+	}
+
+	// record the commands for offline replay (see tools/cmdreplay)
+	if (char const* const path = getenv("FILAMENT_CAPTURE_COMMANDS")) {
+		instance->mDriver = backend::CaptureDriver::create(instance->mDriver, path);
+	}
+
+	// start the render thread, it executes the commands recorded from now on
+	instance->mDriverThread = std::thread(&FEngine::loop, instance);
+
+	// now we can initialize the largest part of the engine
+	if (UTILS_UNLIKELY(!instance->init())) {
+		// stops the render thread and releases the driver
+		destroy(instance);
+		return nullptr;
+	}
 	return instance;
 }
 
+void FEngine::destroy(FEngine* engine) {
+	if (engine) {
+		engine->shutdown();
+		delete engine;
+	}
+}
+
+void FEngine::shutdown() {
+	// materials free their driver objects, so they go before the render thread
+	mMaterials.forEach([this](FMaterial const* material) {
+		destroy(material);
+	});
+	mDefaultMaterial = nullptr;
+	mTextures.forEach([this](FTexture const* texture) {
+		destroy(texture);
+	});
+
+	// the materials released their programs, this destroys the leaked ones and reports sharing
+	mHwProgramFactory.terminate(getDriverApi());
+
+	// the buffer objects shared by the material instances' uniforms
+	mMaterialUniformPool.terminate(getDriverApi());
+
+	// The materials released their descriptor set layouts. This clears the descriptor set cache,
+	// destroys the pooled and retired descriptor sets, and the leaked layouts.
+	mHwDescriptorSetLayoutFactory.terminate(getDriverApi());
+
+	// the vertex buffer infos leaked by the application
+	mHwVertexBufferInfoFactory.terminate(getDriverApi());
+
+	// the render thread executes everything recorded so far before it exits
+	flush();
+	mCommandBufferQueue.requestExit();
+	mDriverThread.join();
+
+	// the driver may have callbacks pending
+	pumpMessageQueues();
+
+	mSecondaryCommandStreams.reset();
+	getDriverApi().~DriverApi();
+
+	// undo adopt() from the constructor
+	mJobSystem.emancipate();
+	mInitialized = false;
+}
+
+int FEngine::loop() {
+	utils::JobSystem::setThreadName("FEngine::loop");
+	while (execute()) {
+	}
+	return 0;
+}
+
+bool FEngine::execute() {
+	// wait until we get command buffers to be executed (or thread exit requested)
+	auto const buffers = mCommandBufferQueue.waitForCommands();
+	if (UTILS_UNLIKELY(buffers.empty())) {
+		return false;
+	}
+
+	// execute all command buffers
+	auto& driver = getDriverApi();
+	for (auto const& item : buffers) {
+		if (UTILS_LIKELY(item.tail)) {
+			driver.execute(item.tail);
+			mCommandBufferQueue.releaseBuffer(item);
+		}
+	}
+	return true;
+}
+
+void FEngine::flush() {
+	// the staging memory is reused once the commands recorded so far have executed
+	getDriverApi().retireStaging();
+	size_t const used = mCommandBufferQueue.getCircularBuffer().getUsed();
+	flushCommandBuffer(mCommandBufferQueue);
+	mFlushStats.count++;
+	mFlushStats.bytes += used;
+	mFlushStats.largest = std::max(mFlushStats.largest, used);
+}
+
+void FEngine::updateFlushThreshold() noexcept {
+	if (!features.engine.commands.adaptive_flush) {
+		mFlushThreshold = getMaxFlushThreshold();
+		return;
+	}
+	if (mFlushStats.stallTime.count()) {
+		// the render thread is behind, flushing sooner doesn't help it, so save the flushes
+		mFlushThreshold = std::min(mFlushThreshold * 2, getMaxFlushThreshold());
+	} else if (mFlushStats.idleCount > 1) {
+		// the render thread ran out of commands during the frame (the end of frame flush
+		// usually finds it idle), give it work sooner
+		mFlushThreshold = std::max(mFlushThreshold / 2, getMinFlushThreshold());
+	}
+}
+
+DriverApi& FEngine::getSecondaryDriverApi(size_t const index) {
+	return mSecondaryCommandStreams->acquire(index);
+}
+
+void FEngine::submitSecondaryDriverApis() {
+	mSecondaryCommandStreams->submit(getDriverApi());
+	// the secondary streams can't be reused until this is executed, which could otherwise
+	// wait forever in getSecondaryDriverApi()
+	flush();
+}
+
+void FEngine::flushCommandBuffer(backend::CommandBufferQueue& commandBufferQueue) const {
+	getDriver().purge();
+	commandBufferQueue.flush();
+}
+
+void FEngine::flushAndWait() {
+	flushAndWait(backend::FENCE_WAIT_FOR_EVER);
+}
+
+bool FEngine::flushAndWait(uint64_t const timeout) {
+	FILAMENT_CHECK_PRECONDITION(!mCommandBufferQueue.isPaused())
+			<< "Cannot call Engine::flushAndWait() when rendering thread is paused!";
+
+	// The render thread signals once it has executed everything recorded before this point. The
+	// promise is shared because the command may execute after we've given up waiting.
+	auto const executed = std::make_shared<std::promise<void>>();
+	std::future<void> const future = executed->get_future();
+	getDriverApi().queueCommand([executed]() {
+		executed->set_value();
+	});
+	flush();
+
+	bool ready = true;
+	if (timeout == backend::FENCE_WAIT_FOR_EVER) {
+		future.wait();
+	} else {
+		ready = future.wait_for(std::chrono::nanoseconds(timeout)) == std::future_status::ready;
+	}
+
+	// finally, execute callbacks that might have been scheduled
+	pumpMessageQueues();
+	return ready;
+}
+
+bool FEngine::isPaused() const noexcept {
+	return mCommandBufferQueue.isPaused();
+}
+
+void FEngine::setPaused(bool const paused) {
+	mCommandBufferQueue.setPaused(paused);
+}
+
 template<typename T, typename ... ARGS>
 T* FEngine::create(ResourceList<T>& list,
 	typename T::Builder const& builder, ARGS&& ... args) noexcept {
@@ -123,7 +361,45 @@ FIndexBuffer* FEngine::createIndexBuffer(const IndexBuffer::Builder& builder) no
 }
 FMaterial* FEngine::createMaterial(const Material::Builder& builder,
 	std::unique_ptr<MaterialParser> materialParser) noexcept {
-	return create(mMaterials, builder, std::move(materialParser));
+	return mMaterials.make(*this, builder, std::move(materialParser));
+}
+
+bool FEngine::destroy(const FMaterial* p) {
+	if (p == nullptr) {
+		return true;
+	}
+	if (UTILS_UNLIKELY(!mMaterials.isValid(p))) {
+		// not one of ours, or already destroyed
+		return false;
+	}
+	const_cast<FMaterial*>(p)->terminate(*this);
+	mMaterialInstances.erase(p);
+	return mMaterials.destroy(p);
+}
+
+FTexture* FEngine::createTexture(const Texture::Builder& builder) noexcept {
+	return mTextures.make(*this, builder);
+}
+
+bool FEngine::destroy(const FTexture* p) {
+	if (p == nullptr) {
+		return true;
+	}
+	if (UTILS_UNLIKELY(!mTextures.isValid(p))) {
+		// not one of ours, or already destroyed
+		return false;
+	}
+	const_cast<FTexture*>(p)->terminate(*this);
+	return mTextures.destroy(p);
+}
+
+bool FEngine::isValid(const FMaterial* m, const FMaterialInstance* p) const {
+	// the instances are only looked up if the material is valid, which is cheap to check
+	if (!isValid(m)) {
+		return false;
+	}
+	auto const pos = mMaterialInstances.find(m);
+	return pos != mMaterialInstances.end() && pos->second.find(p) != pos->second.end();
 }
 
 void FEngine::createLight(const LightManager::Builder& builder, utils::Entity const entity) {
@@ -140,7 +416,9 @@ FIndirectLight* FEngine::createIndirectLight(const IndirectLight::Builder& build
 
 FMaterialInstance* FEngine::createMaterialInstance(const FMaterial* material,
 	const FMaterialInstance* other, const char* name) noexcept {
-	FMaterialInstance* p = mHeapAllocator.make<FMaterialInstance>(*this, other, name);
+	// instances live in their material's slab, together with their uniforms
+	void* const storage = material->allocateInstance();
+	FMaterialInstance* p = new(storage) FMaterialInstance(*this, other, name);
 	if (UTILS_LIKELY(p)) {
 		auto const pos = mMaterialInstances.emplace(material, "MaterialInstance");
 		pos.first->second.insert(p);
@@ -150,7 +428,8 @@ FMaterialInstance* FEngine::createMaterialInstance(const FMaterial* material,
 
 FMaterialInstance* FEngine::createMaterialInstance(const FMaterial* material,
 	const char* name) noexcept {
-	FMaterialInstance* p = mHeapAllocator.make<FMaterialInstance>(*this, material, name);
+	void* const storage = material->allocateInstance();
+	FMaterialInstance* p = new(storage) FMaterialInstance(*this, material, name);
 	if (UTILS_LIKELY(p)) {
 		auto pos = mMaterialInstances.emplace(material, "MaterialInstance");
 		pos.first->second.insert(p);
@@ -158,6 +437,88 @@ FMaterialInstance* FEngine::createMaterialInstance(const FMaterial* material,
 	return p;
 }
 
+bool FEngine::destroy(const FMaterialInstance* p) {
+	if (p == nullptr) {
+		return true;
+	}
+	FMaterial const* const material = p->getMaterial();
+	auto const pos = mMaterialInstances.find(material);
+	if (UTILS_UNLIKELY(pos == mMaterialInstances.end() || !pos->second.remove(p))) {
+		// not one of ours, or already destroyed
+		return false;
+	}
+	FMaterialInstance* const mi = const_cast<FMaterialInstance*>(p);
+	mi->terminate(*this);
+	mi->~FMaterialInstance();
+	material->freeInstance(mi);
+	return true;
+}
+
+void FEngine::removeDirtyMaterialInstance(FMaterialInstance const* mi) noexcept {
+	auto const pos = std::find(mDirtyMaterialInstances.begin(), mDirtyMaterialInstances.end(), mi);
+	assert_invariant(pos != mDirtyMaterialInstances.end());
+	// order doesn't matter
+	*pos = mDirtyMaterialInstances.back();
+	mDirtyMaterialInstances.pop_back();
+}
+
+void FEngine::commitMaterialInstances(DriverApi& driver) {
+	if (mDirtyMaterialInstances.empty()) {
+		return;
+	}
+
+	// Instances committed individually since they were marked dirty have nothing left to upload,
+	// so the staging size is computed now rather than accumulated by markDirty().
+	size_t size = 0;
+	for (FMaterialInstance const* mi : mDirtyMaterialInstances) {
+		size += mi->getCommitSize();
+	}
+
+	// One allocation for all the uniforms, each instance gets its own range. This memory belongs
+	// to the command stream and is released once the commands are executed.
+	char* staging = size ? static_cast<char*>(driver.allocate(size)) : nullptr;
+	for (FMaterialInstance const* mi : mDirtyMaterialInstances) {
+		size_t const commitSize = mi->getCommitSize();
+		mi->commit(driver, staging);
+		staging += commitSize;
+	}
+	mDirtyMaterialInstances.clear();
+}
+
+void FEngine::prepare() {
+	// the instances modified since the last frame are committed together
+	commitMaterialInstances(getDriverApi());
+	// the render thread can start on them while the frame is recorded
+	flushIfNeeded();
+}
+
+void FEngine::beginRenderPass() noexcept {
+	mHwDescriptorSetLayoutFactory.getDescriptorSetCache().invalidateBindings();
+}
+
+void FEngine::bindPipeline() noexcept {
+	mHwDescriptorSetLayoutFactory.getDescriptorSetCache().invalidateBindings();
+}
+
+void FEngine::endFrame() noexcept {
+	mHwDescriptorSetLayoutFactory.getDescriptorSetPool().endFrame();
+	// the next frame starts with nothing bound
+	mHwDescriptorSetLayoutFactory.getDescriptorSetCache().invalidateBindings();
+
+	// hand the frame's commands to the render thread
+	flush();
+
+	mCommandStreamUsage = getDriverApi().resetUsage();
+
+	backend::CommandBufferQueue::Stats const queueStats = mCommandBufferQueue.resetStats();
+	mFlushStats.idleCount = queueStats.idleFlushCount;
+	mFlushStats.stallTime = queueStats.stallTime;
+	mFlushStats.highWatermark = mCommandBufferQueue.getHighWatermark();
+	mFlushStats.flushThreshold = mFlushThreshold;
+	updateFlushThreshold();
+	mLastFlushStats = std::exchange(mFlushStats, {});
+}
+
 FSkybox* FEngine::createSkybox(const Skybox::Builder& builder) noexcept {
 	return create(mSkyboxes, builder);
 }
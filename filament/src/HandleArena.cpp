@@ -0,0 +1,124 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "HandleArena.h"
+
+#include <utils/compiler.h>
+#include <utils/debug.h>
+#include <utils/Log.h>
+#include <utils/memalign.h>
+#include <utils/ostream.h>
+
+#include <algorithm>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace filament {
+
+using namespace utils;
+
+HandleArenaBase::HandleArenaBase(const char* typeName,
+        size_t const objectSize, size_t const alignment, size_t const arenaSize)
+        : mStride((objectSize + alignment - 1) & ~(alignment - 1)),
+          mAlignment(alignment),
+          mTypeName(typeName) {
+    assert_invariant(alignment && !(alignment & (alignment - 1)));
+    mCapacity = uint32_t(std::min(arenaSize / mStride, size_t(UINT32_MAX)));
+    if (mCapacity) {
+        mStorage = static_cast<char*>(utils::aligned_alloc(mCapacity * mStride, mAlignment));
+        assert_invariant(mStorage);
+        mGenerations.resize(mCapacity, 0);
+    }
+}
+
+HandleArenaBase::~HandleArenaBase() noexcept {
+    if (UTILS_UNLIKELY(size())) {
+        slog.d << "leaked " << size() << " " << mTypeName << io::endl;
+    }
+    utils::aligned_free(mStorage);
+    for (void* p : mOverflow) {
+        utils::aligned_free(p);
+    }
+}
+
+void* HandleArenaBase::allocate() {
+    uint32_t index;
+    if (!mFreeSlots.empty()) {
+        index = mFreeSlots.back();
+        mFreeSlots.pop_back();
+    } else if (mHighWater < mCapacity) {
+        index = mHighWater++;
+    } else {
+        if (mOverflow.empty()) {
+            slog.w << "The " << mTypeName << " arena is full (" << mCapacity << " objects), "
+                   << "increase Engine::Config::driverHandleArenaSizeMB" << io::endl;
+        }
+        void* const p = utils::aligned_alloc(mStride, mAlignment);
+        assert_invariant(p);
+        mOverflow.insert(p);
+        return p;
+    }
+    assert_invariant(!(mGenerations[index] & 1u));
+    mGenerations[index]++;
+    mLiveCount++;
+    return mStorage + index * mStride;
+}
+
+void HandleArenaBase::free(void const* p) noexcept {
+    uintptr_t const offset = uintptr_t(p) - uintptr_t(mStorage);
+    if (offset < mCapacity * mStride) {
+        uint32_t const index = uint32_t(offset / mStride);
+        assert_invariant(mGenerations[index] & 1u);
+        // even again. Refs only hold odd generations, so wrapping around to 0 is fine.
+        mGenerations[index]++;
+        mFreeSlots.push_back(index);
+        mLiveCount--;
+    } else {
+        mOverflow.erase(const_cast<void*>(p));
+        utils::aligned_free(const_cast<void*>(p));
+    }
+}
+
+HandleArenaBase::Ref HandleArenaBase::getRef(void const* p) const noexcept {
+    assert_invariant(isValid(p));
+    uintptr_t const offset = uintptr_t(p) - uintptr_t(mStorage);
+    if (offset < mCapacity * mStride) {
+        uint32_t const index = uint32_t(offset / mStride);
+        return { index, mGenerations[index] };
+    }
+    return {};
+}
+
+bool HandleArenaBase::isOverflow(void const* p) const noexcept {
+    return !mOverflow.empty() && mOverflow.find(const_cast<void*>(p)) != mOverflow.end();
+}
+
+// this is not inlined, so we don't pay the code-size cost of iterating the arena
+void HandleArenaBase::forEach(void (* f)(void*, void*), void* user) const noexcept {
+    for (uint32_t i = 0; i < mHighWater; i++) {
+        if (mGenerations[i] & 1u) {
+            f(user, mStorage + i * mStride);
+        }
+    }
+    // copied, so that f() can destroy the object
+    std::vector<void*> const overflow(mOverflow.begin(), mOverflow.end());
+    std::for_each(overflow.begin(), overflow.end(), [=](void* p) {
+        f(user, p);
+    });
+}
+
+} // namespace filament
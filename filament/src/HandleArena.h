@@ -0,0 +1,157 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_FILAMENT_HANDLEARENA_H
+#define TNT_FILAMENT_HANDLEARENA_H
+
+#include <utils/compiler.h>
+
+#include <tsl/robin_set.h>
+
+#include <new>
+#include <utility>
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace filament {
+
+/*
+ * Owns objects of a single type, constructed in a packed array of slots allocated once.
+ *
+ * Each slot has a 32-bit generation, incremented when an object is created in it and when it's
+ * destroyed, so it's odd while the slot is in use. This gives:
+ * - isValid(pointer) in O(1) without dereferencing the pointer: a range check, then the parity
+ *   of the slot's generation. This also catches a double destroy.
+ * - isValid(Ref): a Ref is the slot index and its generation, it becomes invalid when the object
+ *   is destroyed, even if the slot holds another object since (use after free).
+ * - forEach() walks the slots in memory order.
+ *
+ * When the arena is full, objects are allocated on the heap and tracked in a hash set, which
+ * makes them slower to check.
+ *
+ * Not thread-safe.
+ */
+class HandleArenaBase {
+public:
+    struct Ref {
+        uint32_t index = 0;
+        uint32_t generation = 0;    // 0 means the object isn't in the arena and can't be checked
+    };
+
+    size_t size() const noexcept { return mLiveCount + mOverflow.size(); }
+
+    bool empty() const noexcept { return !size(); }
+
+    size_t getCapacity() const noexcept { return mCapacity; }
+
+    bool isValid(Ref const ref) const noexcept {
+        return !ref.generation || (UTILS_LIKELY(ref.index < mCapacity) &&
+                mGenerations[ref.index] == ref.generation);
+    }
+
+protected:
+    // the arena holds as many objects as fit in `arenaSize` bytes
+    HandleArenaBase(const char* typeName, size_t objectSize, size_t alignment, size_t arenaSize);
+    ~HandleArenaBase() noexcept;
+
+    HandleArenaBase(HandleArenaBase const& rhs) = delete;
+    HandleArenaBase& operator=(HandleArenaBase const& rhs) = delete;
+
+    // storage for a new object, which must be constructed by the caller
+    void* allocate();
+
+    // the object must be destroyed by the caller, p must be valid
+    void free(void const* p) noexcept;
+
+    bool isValid(void const* p) const noexcept {
+        uintptr_t const offset = uintptr_t(p) - uintptr_t(mStorage);
+        if (UTILS_LIKELY(offset < mCapacity * mStride)) {
+            return !(offset % mStride) && (mGenerations[offset / mStride] & 1u);
+        }
+        return p && isOverflow(p);
+    }
+
+    Ref getRef(void const* p) const noexcept;
+
+    void forEach(void(*f)(void* user, void* p), void* user) const noexcept;
+
+private:
+    bool isOverflow(void const* p) const noexcept;
+
+    char* mStorage = nullptr;
+    size_t mStride;
+    size_t mAlignment;
+    uint32_t mCapacity = 0;
+    uint32_t mHighWater = 0;        // slots above this were never used
+    uint32_t mLiveCount = 0;
+    std::vector<uint32_t> mGenerations;
+    std::vector<uint32_t> mFreeSlots;
+    tsl::robin_set<void*> mOverflow;
+    const char* const mTypeName;
+};
+
+// The split HandleArenaBase / HandleArena keeps the code operating on void* out of line.
+template<typename T>
+class HandleArena : public HandleArenaBase {
+public:
+    HandleArena(const char* typeName, size_t arenaSize)
+            : HandleArenaBase(typeName, sizeof(T), alignof(T), arenaSize) {
+    }
+
+    // the objects still alive aren't destructed, their owner is expected to destroy them first
+    ~HandleArena() noexcept = default;
+
+    template<typename ... ARGS>
+    T* make(ARGS&& ... args) {
+        return new(allocate()) T(std::forward<ARGS>(args)...);
+    }
+
+    // returns false if p isn't a live object of this arena
+    bool destroy(T const* p) noexcept {
+        if (UTILS_UNLIKELY(!isValid(p))) {
+            return false;
+        }
+        p->~T();
+        free(p);
+        return true;
+    }
+
+    bool isValid(T const* p) const noexcept {
+        return HandleArenaBase::isValid(static_cast<void const*>(p));
+    }
+
+    bool isValid(Ref const ref) const noexcept {
+        return HandleArenaBase::isValid(ref);
+    }
+
+    Ref getRef(T const* p) const noexcept {
+        return HandleArenaBase::getRef(p);
+    }
+
+    template<typename F>
+    void forEach(F func) const noexcept {
+        // turn the closure into a function pointer call, to reduce code size
+        HandleArenaBase::forEach(+[](void* user, void* p) {
+            ((F*)user)->operator()((T*)p);
+        }, &func);
+    }
+};
+
+} // namespace filament
+
+#endif // TNT_FILAMENT_HANDLEARENA_H
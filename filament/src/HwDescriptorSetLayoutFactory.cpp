@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "HwDescriptorSetLayoutFactory.h"
+
+#include <private/backend/DriverApi.h>
+
+#include <backend/DriverEnums.h>
+#include <backend/Handle.h>
+
+#include <utils/compiler.h>
+#include <utils/debug.h>
+#include <utils/Hash.h>
+#include <utils/Log.h>
+#include <utils/ostream.h>
+
+#include <algorithm>
+#include <utility>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace filament {
+
+using namespace utils;
+using namespace backend;
+
+size_t HwDescriptorSetLayoutFactory::Parameters::hash() const noexcept {
+    static_assert(sizeof(DescriptorSetLayoutBinding) == 6,
+            "DescriptorSetLayoutBinding is hashed as bytes, it must not have padding");
+    return hash::murmurSlow(reinterpret_cast<uint8_t const*>(dsl.bindings.data()),
+            dsl.bindings.size() * sizeof(DescriptorSetLayoutBinding), 0);
+}
+
+bool operator==(HwDescriptorSetLayoutFactory::Parameters const& lhs,
+        HwDescriptorSetLayoutFactory::Parameters const& rhs) noexcept {
+    return (lhs.dsl.bindings.size() == rhs.dsl.bindings.size()) &&
+           std::equal(lhs.dsl.bindings.begin(), lhs.dsl.bindings.end(),
+                   rhs.dsl.bindings.begin());
+}
+
+// ------------------------------------------------------------------------------------------------
+
+HwDescriptorSetLayoutFactory::HwDescriptorSetLayoutFactory()
+        : mArena("HwDescriptorSetLayoutFactory::mArena", SET_ARENA_SIZE),
+          mBimap(mArena) {
+    mBimap.reserve(256);
+}
+
+HwDescriptorSetLayoutFactory::~HwDescriptorSetLayoutFactory() noexcept = default;
+
+void HwDescriptorSetLayoutFactory::terminate(DriverApi& driver) noexcept {
+    mDescriptorSetCache.terminate();
+    mDescriptorSetPool.terminate(driver);
+    if (UTILS_UNLIKELY(!mBimap.empty())) {
+        slog.w << "HwDescriptorSetLayoutFactory: " << mBimap.size()
+               << " descriptor set layouts leaked" << io::endl;
+        mBimap.forEach([&driver](Key const& key, Value const value) {
+            slog.w << "    handle=" << value.handle.getId()
+                   << " refs=" << key.refs
+                   << " bindings=" << key.params.dsl.bindings.size() << io::endl;
+            driver.destroyDescriptorSetLayout(value.handle);
+        });
+        mBimap.clear();
+    }
+}
+
+auto HwDescriptorSetLayoutFactory::create(DriverApi& driver,
+        DescriptorSetLayout dsl) noexcept -> Handle {
+    // the bindings are compared in order
+    std::sort(dsl.bindings.begin(), dsl.bindings.end(),
+            [](auto const& lhs, auto const& rhs) {
+                return lhs.binding < rhs.binding;
+            });
+
+    Key const key({ std::move(dsl) });
+    auto const pos = mBimap.find(key);
+    if (UTILS_LIKELY(pos != mBimap.end())) {
+        pos->first.pKey->refs++;
+        return pos->second.handle;
+    }
+    // the backend needs its own copy of the layout
+    Handle const dslh = driver.createDescriptorSetLayout(
+            DescriptorSetLayout{ key.params.dsl });
+    mBimap.insert(key, { dslh });
+    return dslh;
+}
+
+void HwDescriptorSetLayoutFactory::destroy(DriverApi& driver, Handle const handle) noexcept {
+    auto const pos = mBimap.findValue({ handle });
+    assert_invariant(pos != mBimap.endValue());
+    if (--pos->second.pKey->refs == 0) {
+        mBimap.erase(pos);
+        // descriptor sets can't outlive their layout
+        mDescriptorSetCache.purge(handle);
+        mDescriptorSetPool.purge(driver, handle);
+        driver.destroyDescriptorSetLayout(handle);
+    }
+}
+
+} // namespace filament
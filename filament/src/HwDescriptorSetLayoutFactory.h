@@ -17,7 +17,9 @@
 #ifndef TNT_FILAMENT_HWDESCRIPTORSETLAYOUTFACTORY_H
 #define TNT_FILAMENT_HWDESCRIPTORSETLAYOUTFACTORY_H
 
-//#include "Bimap.h"
+#include "Bimap.h"
+#include "ds/DescriptorSetCache.h"
+#include "ds/DescriptorSetPool.h"
 
 #include <backend/DriverApiForward.h>
 #include <backend/DriverEnums.h>
@@ -34,6 +36,10 @@ namespace filament {
 
 class FEngine;
 
+/*
+ * Engine-wide registry of HwDescriptorSetLayout. Identical layouts map to the same refcounted
+ * backend object, which is destroyed when its last user releases it.
+ */
 class HwDescriptorSetLayoutFactory {
 public:
     using Handle = backend::DescriptorSetLayoutHandle;
@@ -55,9 +61,17 @@ public:
 
     friend bool operator==(Parameters const& lhs, Parameters const& rhs) noexcept;
 
-    Handle create(backend::DriverApi& driver, backend::DescriptorSetLayout dsl) noexcept { return {}; }
+    // Returns the descriptor set layout matching `dsl`, creating it if needed.
+    // Each call must be balanced by a call to destroy().
+    Handle create(backend::DriverApi& driver, backend::DescriptorSetLayout dsl) noexcept;
+
+    void destroy(backend::DriverApi& driver, Handle handle) noexcept;
 
-    void destroy(backend::DriverApi& driver, Handle handle) noexcept {}
+    // descriptor sets of the layouts we create are recycled through this pool
+    DescriptorSetPool& getDescriptorSetPool() noexcept { return mDescriptorSetPool; }
+
+    // descriptor sets with identical contents are shared through this cache
+    DescriptorSetCache& getDescriptorSetCache() noexcept { return mDescriptorSetCache; }
 
 private:
     struct Key { // 24 bytes
@@ -107,11 +121,14 @@ private:
 
 
     // Arena where the set memory is allocated
-    //PoolAllocatorArena mArena;
+    PoolAllocatorArena mArena;
+
+    DescriptorSetPool mDescriptorSetPool;
+    DescriptorSetCache mDescriptorSetCache{ mDescriptorSetPool };
 
     // The special Bimap
-//     Bimap<Key, Value, KeyHasher, ValueHasher,
-//             utils::STLAllocator<Key, PoolAllocatorArena>> mBimap;
+    Bimap<Key, Value, KeyHasher, ValueHasher,
+            utils::STLAllocator<Key, PoolAllocatorArena>> mBimap;
 };
 
 } // namespace filament
@@ -0,0 +1,196 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "HwProgramFactory.h"
+
+#include <private/backend/DriverApi.h>
+
+#include <backend/Handle.h>
+#include <backend/Program.h>
+
+#include <utils/CString.h>
+#include <utils/FixedCapacityVector.h>
+#include <utils/Hash.h>
+#include <utils/Log.h>
+#include <utils/debug.h>
+#include <utils/ostream.h>
+
+#include <algorithm>
+#include <functional>
+#include <type_traits>
+#include <utility>
+#include <variant>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace filament {
+
+using namespace utils;
+using namespace backend;
+
+namespace {
+
+template<typename T, typename EQ>
+bool equal(FixedCapacityVector<T> const& lhs, FixedCapacityVector<T> const& rhs,
+        EQ const& eq) noexcept {
+    return lhs.size() == rhs.size() && std::equal(lhs.begin(), lhs.end(), rhs.begin(), eq);
+}
+
+} // anonymous namespace
+
+HwProgramFactory::Key::Key(Program& program) noexcept
+        : sources(std::move(program.getShadersSource())),
+          specializationConstants(std::move(program.getSpecializationConstants())),
+          descriptorBindings(std::move(program.getDescriptorBindings())),
+          pushConstants{
+                  std::move(program.getPushConstants(ShaderStage::VERTEX)),
+                  std::move(program.getPushConstants(ShaderStage::FRAGMENT)),
+                  std::move(program.getPushConstants(ShaderStage::COMPUTE)) },
+          language(program.getShaderLanguage()),
+          multiview(program.isMultiview()),
+          digest(0) {
+    // The shader sources dominate; the rest only needs to be part of the equality test, but
+    // specialization constants are cheap and are what usually differ between instances of
+    // the same template.
+    for (auto const& blob : sources) {
+        digest = hash::combine(digest, hash::murmurSlow(blob.data(), blob.size(), 0));
+    }
+    for (auto const& sc : specializationConstants) {
+        digest = hash::combine(digest, sc.id);
+        digest = hash::combine(digest, std::visit([](auto const value) -> size_t {
+            return std::hash<std::decay_t<decltype(value)>>{}(value);
+        }, sc.value));
+    }
+    digest = hash::combine(digest, uint32_t(language));
+}
+
+void HwProgramFactory::Key::copyTo(Program& program) const noexcept {
+    program.getShadersSource() = sources;
+    program.specializationConstants(specializationConstants);
+    for (size_t i = 0; i < descriptorBindings.size(); i++) {
+        program.descriptorBindings(descriptor_set_t(i), descriptorBindings[i]);
+    }
+    program.pushConstants(ShaderStage::VERTEX, pushConstants[0]);
+    program.pushConstants(ShaderStage::FRAGMENT, pushConstants[1]);
+    program.pushConstants(ShaderStage::COMPUTE, pushConstants[2]);
+}
+
+bool HwProgramFactory::Key::operator==(Key const& rhs) const noexcept {
+    if (digest != rhs.digest || language != rhs.language || multiview != rhs.multiview) {
+        return false;
+    }
+    for (size_t i = 0; i < sources.size(); i++) {
+        auto const& a = sources[i];
+        auto const& b = rhs.sources[i];
+        if (a.size() != b.size() || !std::equal(a.begin(), a.end(), b.begin())) {
+            return false;
+        }
+    }
+    if (!equal(specializationConstants, rhs.specializationConstants,
+            [](auto const& a, auto const& b) {
+                return a.id == b.id && a.value == b.value;
+            })) {
+        return false;
+    }
+    for (size_t i = 0; i < descriptorBindings.size(); i++) {
+        if (!equal(descriptorBindings[i], rhs.descriptorBindings[i],
+                [](auto const& a, auto const& b) {
+                    return a.binding == b.binding && a.type == b.type && a.name == b.name;
+                })) {
+            return false;
+        }
+    }
+    for (size_t i = 0; i < pushConstants.size(); i++) {
+        if (!equal(pushConstants[i], rhs.pushConstants[i],
+                [](auto const& a, auto const& b) {
+                    return a.type == b.type && a.name == b.name;
+                })) {
+            return false;
+        }
+    }
+    return true;
+}
+
+HwProgramFactory::HwProgramFactory() = default;
+
+HwProgramFactory::~HwProgramFactory() noexcept = default;
+
+void HwProgramFactory::terminate(DriverApi& driver) noexcept {
+    if (UTILS_UNLIKELY(!mPrograms.empty())) {
+        slog.w << "HwProgramFactory: " << mPrograms.size()
+               << " programs still alive at terminate()" << io::endl;
+    }
+    for (auto& [key, value] : mPrograms) {
+        driver.destroyProgram(std::move(value.handle));
+    }
+    mPrograms.clear();
+    mHandles.clear();
+    mStats.programs = 0;
+
+    slog.d << "HwProgramFactory: " << mStats.hits << " of " << mStats.requests
+           << " program requests deduplicated" << io::endl;
+}
+
+HwProgramFactory::Handle HwProgramFactory::create(DriverApi& driver, Program&& program,
+        utils::CString const& tag) noexcept {
+    mStats.requests++;
+
+    // ES2 programs carry their uniform and attribute layouts on the side, they are not worth
+    // deduplicating; those are always created as-is and never tracked.
+    if (UTILS_UNLIKELY(program.getShaderLanguage() == ShaderLanguage::ESSL1)) {
+        Handle const handle = driver.createProgram(std::move(program));
+        driver.setDebugTag(handle.getId(), tag);
+        return handle;
+    }
+
+    Key key{ program };
+    auto pos = mPrograms.find(key);
+    if (pos != mPrograms.end()) {
+        mStats.hits++;
+        pos->second.refs++;
+        return pos->second.handle;
+    }
+
+    key.copyTo(program);
+    Handle const handle = driver.createProgram(std::move(program));
+    // the first user names the program, later ones share it
+    driver.setDebugTag(handle.getId(), tag);
+    auto [it, inserted] = mPrograms.emplace(std::move(key), Value{ handle, 1 });
+    assert_invariant(inserted);
+    mHandles[handle.getId()] = &*it;
+    mStats.programs++;
+    return handle;
+}
+
+void HwProgramFactory::destroy(DriverApi& driver, Handle handle) noexcept {
+    auto const pos = mHandles.find(handle.getId());
+    if (UTILS_UNLIKELY(pos == mHandles.end())) {
+        // not shared (e.g. ES2 program)
+        driver.destroyProgram(std::move(handle));
+        return;
+    }
+    Map::value_type* const entry = pos->second;
+    assert_invariant(entry->second.refs > 0);
+    if (--entry->second.refs == 0) {
+        driver.destroyProgram(std::move(handle));
+        mHandles.erase(pos);
+        mPrograms.erase(mPrograms.find(entry->first));
+        mStats.programs--;
+    }
+}
+
+} // namespace filament
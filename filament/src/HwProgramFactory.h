@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_FILAMENT_HWPROGRAMFACTORY_H
+#define TNT_FILAMENT_HWPROGRAMFACTORY_H
+
+#include <backend/DriverApiForward.h>
+#include <backend/DriverEnums.h>
+#include <backend/Handle.h>
+#include <backend/Program.h>
+
+#include <utils/CString.h>
+
+#include <tsl/robin_map.h>
+
+#include <array>
+#include <unordered_map>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace filament {
+
+/*
+ * Engine-wide registry of HwProgram, shared across materials.
+ *
+ * Programs are keyed by their content: final shader sources, specialization constants,
+ * descriptor bindings and push constants. Two materials producing byte-identical shaders for a
+ * variant (e.g. materials generated from the same template) end up with the same HwProgram,
+ * which is refcounted and destroyed when its last user releases it.
+ */
+class HwProgramFactory {
+public:
+    using Handle = backend::ProgramHandle;
+
+    struct Stats {
+        uint32_t requests = 0;  // number of create() calls
+        uint32_t hits = 0;      // create() calls that reused an existing program
+        uint32_t programs = 0;  // number of live programs
+    };
+
+    HwProgramFactory();
+    ~HwProgramFactory() noexcept;
+
+    HwProgramFactory(HwProgramFactory const& rhs) = delete;
+    HwProgramFactory(HwProgramFactory&& rhs) noexcept = delete;
+    HwProgramFactory& operator=(HwProgramFactory const& rhs) = delete;
+    HwProgramFactory& operator=(HwProgramFactory&& rhs) noexcept = delete;
+
+    void terminate(backend::DriverApi& driver) noexcept;
+
+    // Returns a program with the same content as `program`, creating it if needed.
+    // Each successful call must be balanced by a call to destroy().
+    // The program is shared, so `tag` is only set as its debug tag when it's created.
+    Handle create(backend::DriverApi& driver, backend::Program&& program,
+            utils::CString const& tag) noexcept;
+
+    void destroy(backend::DriverApi& driver, Handle handle) noexcept;
+
+    Stats const& getStats() const noexcept { return mStats; }
+
+private:
+    using PushConstants = utils::FixedCapacityVector<backend::Program::PushConstant>;
+
+    struct Key {
+        // Takes the content out of `program`, this avoids a copy when the program already
+        // exists. On a miss, copyTo() gives the content back before the program is created.
+        explicit Key(backend::Program& program) noexcept;
+        void copyTo(backend::Program& program) const noexcept;
+        backend::Program::ShaderSource sources;
+        backend::Program::SpecializationConstantsInfo specializationConstants;
+        backend::Program::DescriptorSetInfo descriptorBindings;
+        std::array<PushConstants, backend::Program::SHADER_TYPE_COUNT> pushConstants;
+        backend::ShaderLanguage language;
+        bool multiview;
+        size_t digest;
+        bool operator==(Key const& rhs) const noexcept;
+    };
+
+    struct KeyHasher {
+        size_t operator()(Key const& key) const noexcept {
+            return key.digest;
+        }
+    };
+
+    struct Value {
+        Handle handle;
+        uint32_t refs;
+    };
+
+    using Map = std::unordered_map<Key, Value, KeyHasher>;
+
+    // content -> program
+    Map mPrograms;
+
+    // program -> content, references are stable across rehashes of mPrograms
+    tsl::robin_map<Handle::HandleId, Map::value_type*> mHandles;
+
+    Stats mStats;
+};
+
+} // namespace filament
+
+#endif // TNT_FILAMENT_HWPROGRAMFACTORY_H
@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "HwVertexBufferInfoFactory.h"
+
+#include <private/backend/DriverApi.h>
+
+#include <backend/DriverEnums.h>
+#include <backend/Handle.h>
+
+#include <utils/compiler.h>
+#include <utils/debug.h>
+#include <utils/Hash.h>
+#include <utils/Log.h>
+#include <utils/ostream.h>
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+namespace filament {
+
+using namespace utils;
+using namespace backend;
+
+size_t HwVertexBufferInfoFactory::Parameters::hash() const noexcept {
+    static_assert((sizeof(*this) % sizeof(uint32_t)) == 0);
+    return hash::murmur3(
+            reinterpret_cast<uint32_t const*>(this), sizeof(*this) / sizeof(uint32_t), 0);
+}
+
+bool operator==(HwVertexBufferInfoFactory::Parameters const& lhs,
+        HwVertexBufferInfoFactory::Parameters const& rhs) noexcept {
+    // Parameters has no padding bytes, and unused attributes are default-initialized
+    return !memcmp(&lhs, &rhs, sizeof(lhs));
+}
+
+// ------------------------------------------------------------------------------------------------
+
+HwVertexBufferInfoFactory::HwVertexBufferInfoFactory()
+        : mArena("HwVertexBufferInfoFactory::mArena", SET_ARENA_SIZE),
+          mBimap(mArena) {
+    mBimap.reserve(256);
+}
+
+HwVertexBufferInfoFactory::~HwVertexBufferInfoFactory() noexcept = default;
+
+void HwVertexBufferInfoFactory::terminate(DriverApi& driver) noexcept {
+    if (UTILS_UNLIKELY(!mBimap.empty())) {
+        slog.w << "HwVertexBufferInfoFactory: " << mBimap.size()
+               << " vertex buffer infos leaked" << io::endl;
+        mBimap.forEach([&driver](Key const& key, Value const value) {
+            slog.w << "    handle=" << value.handle.getId()
+                   << " refs=" << key.refs << io::endl;
+            driver.destroyVertexBufferInfo(value.handle);
+        });
+        mBimap.clear();
+    }
+}
+
+auto HwVertexBufferInfoFactory::create(DriverApi& driver,
+        uint8_t const bufferCount,
+        uint8_t const attributeCount,
+        AttributeArray attributes) noexcept -> Handle {
+    Key const key({ bufferCount, attributeCount, {}, attributes });
+    auto const pos = mBimap.find(key);
+    if (UTILS_LIKELY(pos != mBimap.end())) {
+        pos->first.pKey->refs++;
+        return pos->second.handle;
+    }
+    Handle const vbih = driver.createVertexBufferInfo(bufferCount, attributeCount, attributes);
+    mBimap.insert(key, { vbih });
+    return vbih;
+}
+
+void HwVertexBufferInfoFactory::destroy(DriverApi& driver, Handle const handle) noexcept {
+    auto const pos = mBimap.findValue({ handle });
+    assert_invariant(pos != mBimap.endValue());
+    if (--pos->second.pKey->refs == 0) {
+        mBimap.erase(pos);
+        driver.destroyVertexBufferInfo(handle);
+    }
+}
+
+} // namespace filament
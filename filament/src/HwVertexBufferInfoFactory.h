@@ -17,7 +17,7 @@
 #ifndef TNT_FILAMENT_HWVERTEXBUFFERINFOFACTORY_H
 #define TNT_FILAMENT_HWVERTEXBUFFERINFOFACTORY_H
 
-//#include "Bimap.h"
+#include "Bimap.h"
 
 #include <backend/DriverApiForward.h>
 #include <backend/DriverEnums.h>
@@ -34,6 +34,10 @@ namespace filament {
 
 class FEngine;
 
+/*
+ * Engine-wide registry of HwVertexBufferInfo. Identical vertex formats map to the same
+ * refcounted backend object, which is destroyed when its last user releases it.
+ */
 class HwVertexBufferInfoFactory {
 public:
     using Handle = backend::VertexBufferInfoHandle;
@@ -58,14 +62,14 @@ public:
 
     friend bool operator==(Parameters const& lhs, Parameters const& rhs) noexcept;
 
+    // Returns the vertex buffer info matching these parameters, creating it if needed.
+    // Each call must be balanced by a call to destroy().
     Handle create(backend::DriverApi& driver,
             uint8_t bufferCount,
             uint8_t attributeCount,
-        backend::AttributeArray attributes) noexcept {
-        return {};
-    }
+            backend::AttributeArray attributes) noexcept;
 
-    void destroy(backend::DriverApi& driver, Handle handle) noexcept {}
+    void destroy(backend::DriverApi& driver, Handle handle) noexcept;
 
 private:
     struct Key { // 136 bytes
@@ -115,11 +119,11 @@ private:
 
 
     // Arena where the set memory is allocated
-    //PoolAllocatorArena mArena;
+    PoolAllocatorArena mArena;
 
     // The special Bimap
-//     Bimap<Key, Value, KeyHasher, ValueHasher,
-//             utils::STLAllocator<Key, PoolAllocatorArena>> mBimap;
+    Bimap<Key, Value, KeyHasher, ValueHasher,
+            utils::STLAllocator<Key, PoolAllocatorArena>> mBimap;
 };
 
 } // namespace filament
@@ -146,6 +146,11 @@ bool Material::isSampler(const char* name) const noexcept {
     return downcast(this)->isSampler(name);
 }
 
+Material::ParameterHandle Material::getParameterHandle(
+        const char* name, size_t const nameLength) const noexcept {
+    return downcast(this)->getParameterHandle({ name, nameLength });
+}
+
 MaterialInstance* Material::getDefaultInstance() noexcept {
     return downcast(this)->getDefaultInstance();
 }
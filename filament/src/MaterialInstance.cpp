@@ -35,6 +35,7 @@
 
 #include <algorithm>
 #include <string_view>
+#include <type_traits>
 
 #include <stddef.h>
 #include <stdint.h>
@@ -44,6 +45,29 @@ namespace filament {
 using namespace math;
 using namespace backend;
 
+namespace {
+
+// the type a parameter must be declared with in the material to be set from a T
+template<typename T>
+constexpr UniformType uniformTypeOf() noexcept {
+    if constexpr (std::is_same_v<T, float>)         return UniformType::FLOAT;
+    else if constexpr (std::is_same_v<T, float2>)   return UniformType::FLOAT2;
+    else if constexpr (std::is_same_v<T, float3>)   return UniformType::FLOAT3;
+    else if constexpr (std::is_same_v<T, float4>)   return UniformType::FLOAT4;
+    else if constexpr (std::is_same_v<T, int32_t>)  return UniformType::INT;
+    else if constexpr (std::is_same_v<T, int2>)     return UniformType::INT2;
+    else if constexpr (std::is_same_v<T, int3>)     return UniformType::INT3;
+    else if constexpr (std::is_same_v<T, int4>)     return UniformType::INT4;
+    else if constexpr (std::is_same_v<T, uint32_t>) return UniformType::UINT;
+    else if constexpr (std::is_same_v<T, uint2>)    return UniformType::UINT2;
+    else if constexpr (std::is_same_v<T, uint3>)    return UniformType::UINT3;
+    else if constexpr (std::is_same_v<T, uint4>)    return UniformType::UINT4;
+    else if constexpr (std::is_same_v<T, mat3f>)    return UniformType::MAT3;
+    else if constexpr (std::is_same_v<T, mat4f>)    return UniformType::MAT4;
+}
+
+} // anonymous namespace
+
 // ------------------------------------------------------------------------------------------------
 
 // This is the untyped/sized version of the setParameter: we end up here for e.g. vec4<int> and
@@ -51,9 +75,10 @@ using namespace backend;
 template<size_t Size>
 UTILS_NOINLINE
 void FMaterialInstance::setParameterUntypedImpl(std::string_view const name, const void* value) {
-    ssize_t offset = mMaterial->getUniformInterfaceBlock().getFieldOffset(name, 0);
+    ssize_t offset = mMaterial->getUniformOffset(name);
     if (UTILS_LIKELY(offset >= 0)) {
         mUniforms.setUniformUntyped<Size>(size_t(offset), value);  // handles specialization for mat3f
+        markUniformsDirty();
     }
 }
 
@@ -70,9 +95,10 @@ inline void FMaterialInstance::setParameterImpl(std::string_view const name, T c
 // specialization for mat3f
 template<>
 inline void FMaterialInstance::setParameterImpl(std::string_view const name, mat3f const& value) {
-    ssize_t offset = mMaterial->getUniformInterfaceBlock().getFieldOffset(name, 0);
+    ssize_t offset = mMaterial->getUniformOffset(name);
     if (UTILS_LIKELY(offset >= 0)) {
         mUniforms.setUniform(size_t(offset), value);
+        markUniformsDirty();
     }
 }
 
@@ -82,9 +108,10 @@ template<size_t Size>
 UTILS_NOINLINE
 void FMaterialInstance::setParameterUntypedImpl(std::string_view const name,
         const void* value, size_t const count) {
-    ssize_t offset = mMaterial->getUniformInterfaceBlock().getFieldOffset(name, 0);
+    ssize_t offset = mMaterial->getUniformOffset(name);
     if (UTILS_LIKELY(offset >= 0)) {
         mUniforms.setUniformArrayUntyped<Size>(size_t(offset), value, count);
+        markUniformsDirty();
     }
 }
 
@@ -204,9 +231,158 @@ template UTILS_PUBLIC void MaterialInstance::setParameter<mat4f>   (const char*
 
 // ------------------------------------------------------------------------------------------------
 
+// Same as above, with the name already resolved: this is a type check and a copy.
+
+template<size_t Size>
+UTILS_NOINLINE
+void FMaterialInstance::setParameterUntypedImpl(ParameterHandle const handle,
+        const void* value, UniformType const type) {
+    checkParameterHandle(handle, type, 1);
+    mUniforms.setUniformUntyped<Size>(handle.mOffset, value);
+    markUniformsDirty();
+}
+
+template<size_t Size>
+UTILS_NOINLINE
+void FMaterialInstance::setParameterUntypedImpl(ParameterHandle const handle,
+        const void* value, size_t const count, UniformType const type) {
+    checkParameterHandle(handle, type, count);
+    mUniforms.setUniformArrayUntyped<Size>(handle.mOffset, value, count);
+    markUniformsDirty();
+}
+
+template<typename T>
+UTILS_ALWAYS_INLINE
+inline void FMaterialInstance::setParameterImpl(ParameterHandle const handle, T const& value) {
+    static_assert(!std::is_same_v<T, mat3f>);
+    setParameterUntypedImpl<sizeof(T)>(handle, &value, uniformTypeOf<T>());
+}
+
+template<>
+inline void FMaterialInstance::setParameterImpl(ParameterHandle const handle, mat3f const& value) {
+    checkParameterHandle(handle, UniformType::MAT3, 1);
+    mUniforms.setUniform(handle.mOffset, value);
+    markUniformsDirty();
+}
+
+template<typename T>
+UTILS_ALWAYS_INLINE
+inline void FMaterialInstance::setParameterImpl(ParameterHandle const handle,
+        const T* value, size_t const count) {
+    static_assert(!std::is_same_v<T, mat3f>);
+    setParameterUntypedImpl<sizeof(T)>(handle, value, count, uniformTypeOf<T>());
+}
+
+template<>
+inline void FMaterialInstance::setParameterImpl(ParameterHandle const handle,
+        const mat3f* value, size_t const count) {
+    checkParameterHandle(handle, UniformType::MAT3, count);
+    // pretend each mat3 is an array of 3 float3
+    mUniforms.setUniformArrayUntyped<sizeof(float3)>(handle.mOffset, value, count * 3);
+    markUniformsDirty();
+}
+
+template<typename T, typename>
+void MaterialInstance::setParameter(ParameterHandle const handle, T const& value) {
+    downcast(this)->setParameterImpl(handle, value);
+}
+
+template<>
+UTILS_PUBLIC void MaterialInstance::setParameter(ParameterHandle const handle, bool const& v) {
+    uint32_t const u(v);
+    downcast(this)->setParameterUntypedImpl<sizeof(u)>(handle, &u, UniformType::BOOL);
+}
+
+template<>
+UTILS_PUBLIC void MaterialInstance::setParameter(ParameterHandle const handle, bool2 const& v) {
+    uint2 const u(v);
+    downcast(this)->setParameterUntypedImpl<sizeof(u)>(handle, &u, UniformType::BOOL2);
+}
+
+template<>
+UTILS_PUBLIC void MaterialInstance::setParameter(ParameterHandle const handle, bool3 const& v) {
+    uint3 const u(v);
+    downcast(this)->setParameterUntypedImpl<sizeof(u)>(handle, &u, UniformType::BOOL3);
+}
+
+template<>
+UTILS_PUBLIC void MaterialInstance::setParameter(ParameterHandle const handle, bool4 const& v) {
+    uint4 const u(v);
+    downcast(this)->setParameterUntypedImpl<sizeof(u)>(handle, &u, UniformType::BOOL4);
+}
+
+template UTILS_PUBLIC void MaterialInstance::setParameter<float>   (ParameterHandle handle, float const&    v);
+template UTILS_PUBLIC void MaterialInstance::setParameter<int32_t> (ParameterHandle handle, int32_t const&  v);
+template UTILS_PUBLIC void MaterialInstance::setParameter<uint32_t>(ParameterHandle handle, uint32_t const& v);
+template UTILS_PUBLIC void MaterialInstance::setParameter<int2>    (ParameterHandle handle, int2 const&     v);
+template UTILS_PUBLIC void MaterialInstance::setParameter<int3>    (ParameterHandle handle, int3 const&     v);
+template UTILS_PUBLIC void MaterialInstance::setParameter<int4>    (ParameterHandle handle, int4 const&     v);
+template UTILS_PUBLIC void MaterialInstance::setParameter<uint2>   (ParameterHandle handle, uint2 const&    v);
+template UTILS_PUBLIC void MaterialInstance::setParameter<uint3>   (ParameterHandle handle, uint3 const&    v);
+template UTILS_PUBLIC void MaterialInstance::setParameter<uint4>   (ParameterHandle handle, uint4 const&    v);
+template UTILS_PUBLIC void MaterialInstance::setParameter<float2>  (ParameterHandle handle, float2 const&   v);
+template UTILS_PUBLIC void MaterialInstance::setParameter<float3>  (ParameterHandle handle, float3 const&   v);
+template UTILS_PUBLIC void MaterialInstance::setParameter<float4>  (ParameterHandle handle, float4 const&   v);
+template UTILS_PUBLIC void MaterialInstance::setParameter<mat3f>   (ParameterHandle handle, mat3f const&    v);
+template UTILS_PUBLIC void MaterialInstance::setParameter<mat4f>   (ParameterHandle handle, mat4f const&    v);
+
+template<typename T, typename>
+void MaterialInstance::setParameter(ParameterHandle const handle, const T* values, size_t const count) {
+    downcast(this)->setParameterImpl(handle, values, count);
+}
+
+template<>
+UTILS_PUBLIC void MaterialInstance::setParameter(ParameterHandle const handle, const bool* v, size_t const c) {
+    auto* p = new uint32_t[c];
+    std::copy_n(v, c, p);
+    downcast(this)->setParameterUntypedImpl<sizeof(uint32_t)>(handle, p, c, UniformType::BOOL);
+    delete [] p;
+}
+
+template<>
+UTILS_PUBLIC void MaterialInstance::setParameter(ParameterHandle const handle, const bool2* v, size_t const c) {
+    auto* p = new uint2[c];
+    std::copy_n(v, c, p);
+    downcast(this)->setParameterUntypedImpl<sizeof(uint2)>(handle, p, c, UniformType::BOOL2);
+    delete [] p;
+}
+
+template<>
+UTILS_PUBLIC void MaterialInstance::setParameter(ParameterHandle const handle, const bool3* v, size_t const c) {
+    auto* p = new uint3[c];
+    std::copy_n(v, c, p);
+    downcast(this)->setParameterUntypedImpl<sizeof(uint3)>(handle, p, c, UniformType::BOOL3);
+    delete [] p;
+}
+
+template<>
+UTILS_PUBLIC void MaterialInstance::setParameter(ParameterHandle const handle, const bool4* v, size_t const c) {
+    auto* p = new uint4[c];
+    std::copy_n(v, c, p);
+    downcast(this)->setParameterUntypedImpl<sizeof(uint4)>(handle, p, c, UniformType::BOOL4);
+    delete [] p;
+}
+
+template UTILS_PUBLIC void MaterialInstance::setParameter<float>   (ParameterHandle handle, const float    *v, size_t c);
+template UTILS_PUBLIC void MaterialInstance::setParameter<int32_t> (ParameterHandle handle, const int32_t  *v, size_t c);
+template UTILS_PUBLIC void MaterialInstance::setParameter<uint32_t>(ParameterHandle handle, const uint32_t *v, size_t c);
+template UTILS_PUBLIC void MaterialInstance::setParameter<int2>    (ParameterHandle handle, const int2     *v, size_t c);
+template UTILS_PUBLIC void MaterialInstance::setParameter<int3>    (ParameterHandle handle, const int3     *v, size_t c);
+template UTILS_PUBLIC void MaterialInstance::setParameter<int4>    (ParameterHandle handle, const int4     *v, size_t c);
+template UTILS_PUBLIC void MaterialInstance::setParameter<uint2>   (ParameterHandle handle, const uint2    *v, size_t c);
+template UTILS_PUBLIC void MaterialInstance::setParameter<uint3>   (ParameterHandle handle, const uint3    *v, size_t c);
+template UTILS_PUBLIC void MaterialInstance::setParameter<uint4>   (ParameterHandle handle, const uint4    *v, size_t c);
+template UTILS_PUBLIC void MaterialInstance::setParameter<float2>  (ParameterHandle handle, const float2   *v, size_t c);
+template UTILS_PUBLIC void MaterialInstance::setParameter<float3>  (ParameterHandle handle, const float3   *v, size_t c);
+template UTILS_PUBLIC void MaterialInstance::setParameter<float4>  (ParameterHandle handle, const float4   *v, size_t c);
+template UTILS_PUBLIC void MaterialInstance::setParameter<mat3f>   (ParameterHandle handle, const mat3f    *v, size_t c);
+template UTILS_PUBLIC void MaterialInstance::setParameter<mat4f>   (ParameterHandle handle, const mat4f    *v, size_t c);
+
+// ------------------------------------------------------------------------------------------------
+
 template<typename T>
 T FMaterialInstance::getParameterImpl(std::string_view const name) const {
-    ssize_t offset = mMaterial->getUniformInterfaceBlock().getFieldOffset(name, 0);
+    ssize_t offset = mMaterial->getUniformOffset(name);
     assert_invariant(offset>=0);
     return downcast(this)->getUniformBuffer().getUniform<T>(offset);
 }
@@ -256,6 +432,21 @@ void MaterialInstance::setParameter(
     downcast(this)->setParameterImpl<float4>({ name, nameLength }, Color::toLinear(type, color));
 }
 
+void MaterialInstance::setParameter(ParameterHandle const handle, Texture const* texture,
+        TextureSampler const& sampler) {
+    downcast(this)->setParameterImpl(handle, downcast(texture), sampler);
+}
+
+void MaterialInstance::setParameter(
+        ParameterHandle const handle, RgbType const type, float3 const color) {
+    downcast(this)->setParameterImpl<float3>(handle, Color::toLinear(type, color));
+}
+
+void MaterialInstance::setParameter(
+        ParameterHandle const handle, RgbaType const type, float4 const color) {
+    downcast(this)->setParameterImpl<float4>(handle, Color::toLinear(type, color));
+}
+
 void MaterialInstance::setScissor(
         uint32_t const left, uint32_t const bottom, uint32_t const width, uint32_t const height) noexcept {
     downcast(this)->setScissor(left, bottom, width, height);
@@ -127,6 +127,8 @@ public:
     bool getSpecularAntiAliasingThreshold(float* value) const noexcept;
     bool getStereoscopicType(backend::StereoscopicType*) const noexcept;
 
+    // Once parse() has succeeded, this only reads from the material package, so it can be
+    // called concurrently as long as each caller provides its own ShaderContent.
     bool getShader(filaflat::ShaderContent& shader, backend::ShaderModel shaderModel,
             Variant variant, backend::ShaderStage stage) noexcept;
 
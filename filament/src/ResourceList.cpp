@@ -18,8 +18,6 @@
 
 #include <utils/Log.h>
 
-#include <algorithm>
-
 namespace filament {
 
 ResourceListBase::ResourceListBase(const char* typeName)
@@ -38,26 +36,51 @@ ResourceListBase::~ResourceListBase() noexcept {
 }
 
 void ResourceListBase::insert(void* item) {
-    mList.insert(item);
+    if (mIndices.try_emplace(item, uint32_t(mList.size())).second) {
+        mList.push_back(item);
+    }
 }
 
 bool ResourceListBase::remove(void const* item) {
-    return mList.erase(const_cast<void*>(item)) > 0;
+    auto const pos = mIndices.find(const_cast<void*>(item));
+    if (pos == mIndices.end()) {
+        return false;
+    }
+    // move the last item into the hole
+    uint32_t const index = pos->second;
+    mIndices.erase(pos);
+    void* const last = mList.back();
+    mList.pop_back();
+    if (last != item) {
+        mList[index] = last;
+        mIndices[last] = index;
+    }
+    return true;
 }
 
 auto ResourceListBase::find(void const* item) -> iterator {
-    return mList.find(const_cast<void*>(item));
+    auto const pos = mIndices.find(const_cast<void*>(item));
+    return pos != mIndices.end() ? mList.begin() + pos->second : mList.end();
+}
+
+auto ResourceListBase::find(void const* item) const -> const_iterator {
+    auto const pos = mIndices.find(const_cast<void*>(item));
+    return pos != mIndices.end() ? mList.begin() + pos->second : mList.end();
 }
 
 void ResourceListBase::clear() noexcept {
     mList.clear();
+    mIndices.clear();
 }
 
 // this is not inlined, so we don't pay the code-size cost of iterating the list
 void ResourceListBase::forEach(void (* f)(void*, void*), void* user) const noexcept {
-    std::for_each(mList.begin(), mList.end(), [=](void* p) {
-        f(user, p);
-    });
+    // backward, so that removing the current item only moves an item already visited
+    for (size_t i = mList.size(); i-- > 0;) {
+        if (i < mList.size()) {
+            f(user, mList[i]);
+        }
+    }
 }
 
 } // namespace filament
@@ -19,16 +19,27 @@
 
 #include <utils/compiler.h>
 
-#include <tsl/robin_set.h>
+#include <tsl/robin_map.h>
 
+#include <vector>
+
+#include <stddef.h>
 #include <stdint.h>
 
 namespace filament {
 
+/*
+ * A set of resources stored as a dense slot-map: the items are packed in an array, which is what
+ * iteration walks, and a sparse index maps each item to its position in that array. Removing an
+ * item moves the last one in its place, so the array never has holes.
+ *
+ * insert(), remove() and find() are O(1), forEach() and iterators are linear scans of the array.
+ * The order of the items is unspecified and changes when items are removed.
+ */
 class ResourceListBase {
 public:
-    using iterator = typename tsl::robin_set<void*>::iterator;
-    using const_iterator = typename tsl::robin_set<void*>::const_iterator;
+    using iterator = typename std::vector<void*>::iterator;
+    using const_iterator = typename std::vector<void*>::const_iterator;
 
     explicit ResourceListBase(const char* typeName);
     ResourceListBase(ResourceListBase&& rhs) noexcept = default;
@@ -41,6 +52,8 @@ public:
 
     iterator find(void const* item);
 
+    const_iterator find(void const* item) const;
+
     void clear() noexcept;
 
     bool empty() const noexcept {
@@ -68,8 +81,10 @@ public:
     }
 
 protected:
+    // f() may remove the item it's given from the list
     void forEach(void(*f)(void* user, void *p), void* user) const noexcept;
-    tsl::robin_set<void*> mList;
+    std::vector<void*> mList;                   // dense
+    tsl::robin_map<void*, uint32_t> mIndices;   // sparse, position of each item in mList
 #ifndef NDEBUG
 private:
     // removing this saves 8-bytes because of padding of derived classes
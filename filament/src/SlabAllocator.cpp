@@ -0,0 +1,63 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "SlabAllocator.h"
+
+#include <utils/compiler.h>
+#include <utils/debug.h>
+#include <utils/Log.h>
+#include <utils/memalign.h>
+#include <utils/ostream.h>
+
+#include <algorithm>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace filament {
+
+using namespace utils;
+
+SlabAllocator::~SlabAllocator() noexcept {
+    if (UTILS_UNLIKELY(mLiveCount)) {
+        slog.w << "SlabAllocator: " << mLiveCount << " slots still alive" << io::endl;
+    }
+    for (void* slab : mSlabs) {
+        utils::aligned_free(slab);
+    }
+}
+
+void SlabAllocator::init(size_t const slotSize, size_t const alignment) noexcept {
+    assert_invariant(mSlabs.empty());
+    assert_invariant(alignment && !(alignment & (alignment - 1)));
+    mAlignment = std::max(alignment, alignof(Node));
+    // slots must be able to hold a Node when free, and keep their successor aligned
+    mSlotSize = (std::max(slotSize, sizeof(Node)) + mAlignment - 1) & ~(mAlignment - 1);
+}
+
+void SlabAllocator::grow() noexcept {
+    char* const slab = static_cast<char*>(utils::aligned_alloc(mSlotSize * SLOTS_PER_SLAB, mAlignment));
+    assert_invariant(slab);
+    mSlabs.push_back(slab);
+    // thread the new slots in address order, so consecutive allocations are contiguous
+    for (size_t i = SLOTS_PER_SLAB; i-- > 0;) {
+        Node* const node = reinterpret_cast<Node*>(slab + i * mSlotSize);
+        node->next = mFreeList;
+        mFreeList = node;
+    }
+}
+
+} // namespace filament
@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_FILAMENT_SLABALLOCATOR_H
+#define TNT_FILAMENT_SLABALLOCATOR_H
+
+#include <utils/compiler.h>
+#include <utils/debug.h>
+
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace filament {
+
+/*
+ * Allocator of fixed-size slots, carved out of slabs of SLOTS_PER_SLAB slots.
+ *
+ * alloc() and free() are O(1): freed slots are kept in an intrusive free list and reused
+ * most-recently-freed first, so that live objects stay packed in few cache lines. Slabs are only
+ * released when the allocator is destroyed.
+ *
+ * Not thread-safe.
+ */
+class SlabAllocator {
+public:
+    static constexpr size_t SLOTS_PER_SLAB = 64;
+
+    // init() must be called before the first alloc()
+    SlabAllocator() noexcept = default;
+    ~SlabAllocator() noexcept;
+
+    SlabAllocator(SlabAllocator const& rhs) = delete;
+    SlabAllocator(SlabAllocator&& rhs) noexcept = delete;
+    SlabAllocator& operator=(SlabAllocator const& rhs) = delete;
+    SlabAllocator& operator=(SlabAllocator&& rhs) noexcept = delete;
+
+    // sets the size and alignment of the slots, only allowed while nothing is allocated
+    void init(size_t slotSize, size_t alignment) noexcept;
+
+    void* alloc() noexcept {
+        if (UTILS_UNLIKELY(!mFreeList)) {
+            grow();
+        }
+        Node* const node = mFreeList;
+        mFreeList = node->next;
+        mLiveCount++;
+        return node;
+    }
+
+    void free(void* p) noexcept {
+        if (p) {
+            assert_invariant(mLiveCount);
+            Node* const node = static_cast<Node*>(p);
+            node->next = mFreeList;
+            mFreeList = node;
+            mLiveCount--;
+        }
+    }
+
+    size_t getSlotSize() const noexcept { return mSlotSize; }
+
+    size_t getLiveCount() const noexcept { return mLiveCount; }
+
+    size_t getSlabCount() const noexcept { return mSlabs.size(); }
+
+private:
+    struct Node {
+        Node* next;
+    };
+
+    void grow() noexcept;
+
+    Node* mFreeList = nullptr;
+    std::vector<void*> mSlabs;
+    size_t mSlotSize = sizeof(Node);
+    size_t mAlignment = alignof(Node);
+    size_t mLiveCount = 0;
+};
+
+} // namespace filament
+
+#endif // TNT_FILAMENT_SLABALLOCATOR_H
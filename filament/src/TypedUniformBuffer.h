@@ -59,7 +59,7 @@ public:
             backend::DriverApi& driver, size_t offset, size_t size) const noexcept {
         backend::BufferDescriptor p;
         p.size = size;
-        p.buffer = driver.allocate(p.size); // TODO: use out-of-line buffer if too large
+        p.buffer = driver.allocate(p.size); // out-of-line if too large
         memcpy(p.buffer, reinterpret_cast<const char*>(mBuffer) + offset, p.size); // inlined
         clean();
         return p;
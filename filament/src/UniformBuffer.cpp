@@ -26,17 +26,29 @@ namespace filament {
 UniformBuffer::UniformBuffer(size_t const size) noexcept
         : mBuffer(mStorage),
           mSize(uint32_t(size)),
-          mSomethingDirty(true) {
+          mDirtyBegin(0),
+          mDirtyEnd(uint32_t(size)) {
     if (UTILS_LIKELY(size > sizeof(mStorage))) {
         mBuffer = alloc(size);
     }
     memset(mBuffer, 0, size);
 }
 
+UniformBuffer::UniformBuffer(void* storage, size_t const size) noexcept
+        : mBuffer(storage),
+          mSize(uint32_t(size)),
+          mDirtyBegin(0),
+          mDirtyEnd(uint32_t(size)),
+          mExternalStorage(true) {
+    memset(mBuffer, 0, size);
+}
+
 UniformBuffer::UniformBuffer(UniformBuffer&& rhs) noexcept
         : mBuffer(rhs.mBuffer),
           mSize(rhs.mSize),
-          mSomethingDirty(rhs.mSomethingDirty) {
+          mDirtyBegin(rhs.mDirtyBegin),
+          mDirtyEnd(rhs.mDirtyEnd),
+          mExternalStorage(rhs.mExternalStorage) {
     if (UTILS_LIKELY(rhs.isLocalStorage())) {
         mBuffer = mStorage;
         memcpy(mBuffer, rhs.mBuffer, mSize);
@@ -47,14 +59,17 @@ UniformBuffer::UniformBuffer(UniformBuffer&& rhs) noexcept
 
 UniformBuffer& UniformBuffer::operator=(UniformBuffer&& rhs) noexcept {
     if (this != &rhs) {
-        mSomethingDirty = rhs.mSomethingDirty;
+        mDirtyBegin = rhs.mDirtyBegin;
+        mDirtyEnd = rhs.mDirtyEnd;
         if (UTILS_LIKELY(rhs.isLocalStorage())) {
             mBuffer = mStorage;
             mSize = rhs.mSize;
+            mExternalStorage = false;
             memcpy(mBuffer, rhs.mBuffer, rhs.mSize);
         } else {
             std::swap(mBuffer, rhs.mBuffer);
             std::swap(mSize, rhs.mSize);
+            std::swap(mExternalStorage, rhs.mExternalStorage);
         }
     }
     return *this;
@@ -64,10 +79,11 @@ UniformBuffer& UniformBuffer::setUniforms(const UniformBuffer& rhs) noexcept {
     if (this != &rhs) {
         if (UTILS_UNLIKELY(mSize != rhs.mSize)) {
             // first free our storage if any
-            if (mBuffer && !isLocalStorage()) {
+            if (mBuffer && !isLocalStorage() && !mExternalStorage) {
                 free(mBuffer, mSize);
             }
             // and allocate new storage
+            mExternalStorage = false;
             mBuffer = mStorage;
             mSize = rhs.mSize;
             if (mSize > sizeof(mStorage)) {
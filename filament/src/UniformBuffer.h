@@ -31,7 +31,10 @@
 #include <math/mat3.h>
 #include <math/mat4.h>
 
+#include <limits>
+
 #include <stddef.h>
+#include <stdint.h>
 #include <string.h>
 
 namespace filament {
@@ -43,6 +46,10 @@ public:
     // create a uniform buffer of a given size in bytes
     explicit UniformBuffer(size_t size) noexcept;
 
+    // create a uniform buffer of a given size in bytes, using memory owned by the caller, which
+    // must outlive the UniformBuffer
+    UniformBuffer(void* storage, size_t size) noexcept;
+
     // disallow copy-construction, since it's heavy.
     UniformBuffer(const UniformBuffer& rhs) = delete;
 
@@ -58,7 +65,7 @@ public:
     ~UniformBuffer() noexcept {
         // inline this because there is no point in jumping into the library, just to
         // immediately jump into libc's free()
-        if (mBuffer && !isLocalStorage()) {
+        if (mBuffer && !isLocalStorage() && !mExternalStorage) {
             // test not necessary but avoids a call to libc (and this is a common enough case)
             free(mBuffer, mSize);
         }
@@ -69,7 +76,8 @@ public:
     // invalidate a range of uniforms and return a pointer to it. offset and size given in bytes
     void* invalidateUniforms(size_t const offset, size_t const size) {
         assert_invariant(offset + size <= mSize);
-        mSomethingDirty = true;
+        mDirtyBegin = std::min(mDirtyBegin, uint32_t(offset));
+        mDirtyEnd = std::max(mDirtyEnd, uint32_t(offset + size));
         return static_cast<char*>(mBuffer) + offset;
     }
 
@@ -84,10 +92,23 @@ public:
     size_t getSize() const noexcept { return mSize; }
 
     // return if any uniform has been changed
-    bool isDirty() const noexcept { return mSomethingDirty; }
+    bool isDirty() const noexcept { return mDirtyBegin < mDirtyEnd; }
+
+    // Range of bytes that contains all the uniforms changed since the last clean(), widened to
+    // std140 vec4 boundaries. Only meaningful if isDirty().
+    size_t getDirtyOffset() const noexcept {
+        return mDirtyBegin & ~0xFu;
+    }
+
+    size_t getDirtySize() const noexcept {
+        return std::min((mDirtyEnd + 0xFu) & ~0xFu, mSize) - getDirtyOffset();
+    }
 
     // mark the whole buffer as clean (no modified uniforms)
-    void clean() const noexcept { mSomethingDirty = false; }
+    void clean() const noexcept {
+        mDirtyBegin = CLEAN;
+        mDirtyEnd = 0;
+    }
 
     /*
      * -----------------------------------------------
@@ -166,12 +187,19 @@ public:
         return toBufferDescriptor(driver, 0, getSize());
     }
 
+    // copy the dirty range of the UBO data and cleans the dirty bits, the range must be
+    // uploaded at getDirtyOffset().
+    backend::BufferDescriptor toDirtyBufferDescriptor(backend::DriverApi& driver) const noexcept {
+        assert_invariant(isDirty());
+        return toBufferDescriptor(driver, getDirtyOffset(), getDirtySize());
+    }
+
     // copy the UBO data and cleans the dirty bits
     backend::BufferDescriptor toBufferDescriptor(
             backend::DriverApi& driver, size_t const offset, size_t const size) const noexcept {
         backend::BufferDescriptor p;
         p.size = size;
-        p.buffer = driver.allocate(p.size); // TODO: use out-of-line buffer if too large
+        p.buffer = driver.allocate(p.size); // out-of-line if too large
         memcpy(p.buffer, static_cast<const char*>(getBuffer()) + offset, p.size); // inlined
         clean();
         return p;
@@ -200,10 +228,15 @@ private:
 
     inline bool isLocalStorage() const noexcept { return mBuffer == mStorage; }
 
+    static constexpr uint32_t CLEAN = std::numeric_limits<uint32_t>::max();
+
     char mStorage[96];
     void *mBuffer = nullptr;
     uint32_t mSize = 0;
-    mutable bool mSomethingDirty = false;
+    // [mDirtyBegin, mDirtyEnd) is the byte range modified since the last clean()
+    mutable uint32_t mDirtyBegin = CLEAN;
+    mutable uint32_t mDirtyEnd = 0;
+    bool mExternalStorage = false;  // mBuffer isn't ours
 };
 
 // specialization for mat3f (which has a different alignment, see std140 layout rules)
@@ -0,0 +1,153 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "UniformBufferPool.h"
+
+#include "ds/DescriptorSetCache.h"
+
+#include <private/backend/DriverApi.h>
+
+#include <backend/DriverEnums.h>
+#include <backend/Handle.h>
+
+#include <utils/compiler.h>
+#include <utils/CString.h>
+#include <utils/debug.h>
+#include <utils/Log.h>
+#include <utils/ostream.h>
+
+#include <algorithm>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace filament {
+
+using namespace utils;
+using namespace backend;
+
+UniformBufferPool::UniformBufferPool(DescriptorSetCache& descriptorSetCache) noexcept
+        : mDescriptorSetCache(descriptorSetCache) {
+}
+
+UniformBufferPool::~UniformBufferPool() noexcept = default;
+
+void UniformBufferPool::terminate(DriverApi& driver) noexcept {
+    if (UTILS_UNLIKELY(mStats.slices)) {
+        slog.w << "UniformBufferPool: " << mStats.slices
+               << " slices still alive at terminate()" << io::endl;
+    }
+    for (auto& boh : mBuffers) {
+        destroyBuffer(driver, boh);
+    }
+    mBuffers.clear();
+    for (auto& list : mFreeLists) {
+        list.clear();
+    }
+    mCurrentBuffer.clear();
+    mCurrentOffset = BUFFER_SIZE;
+}
+
+size_t UniformBufferPool::getSizeClass(size_t const size) noexcept {
+    size_t sizeClass = 0;
+    while ((size_t(ALIGNMENT) << sizeClass) < size) {
+        sizeClass++;
+    }
+    return sizeClass;
+}
+
+Handle<HwBufferObject> UniformBufferPool::createBuffer(
+        DriverApi& driver, uint32_t const size) noexcept {
+    Handle<HwBufferObject> const boh = driver.createBufferObject(size,
+            BufferObjectBinding::UNIFORM, BufferUsage::DYNAMIC);
+    driver.setDebugTag(boh.getId(), CString("UniformBufferPool"));
+    mBuffers.push_back(boh);
+    mStats.buffers++;
+    return boh;
+}
+
+void UniformBufferPool::destroyBuffer(DriverApi& driver, Handle<HwBufferObject> boh) noexcept {
+    // its id can be reused as soon as it's destroyed
+    mDescriptorSetCache.evict(boh.getId());
+    driver.destroyBufferObject(boh);
+    assert_invariant(mStats.buffers);
+    mStats.buffers--;
+}
+
+UniformBufferPool::Slice UniformBufferPool::allocate(DriverApi& driver, size_t const size) noexcept {
+    assert_invariant(size);
+
+    if (UTILS_UNLIKELY(size > BUFFER_SIZE)) {
+        // too large to be pooled, these are rare
+        uint32_t const alignedSize = uint32_t((size + ALIGNMENT - 1) & ~size_t(ALIGNMENT - 1));
+        mStats.slices++;
+        return { createBuffer(driver, alignedSize), 0, alignedSize };
+    }
+
+    size_t const sizeClass = getSizeClass(size);
+    uint32_t const classSize = ALIGNMENT << sizeClass;
+
+    auto& freeList = mFreeLists[sizeClass];
+    if (!freeList.empty()) {
+        Slice const slice = freeList.back();
+        freeList.pop_back();
+        mStats.slices++;
+        mStats.reused++;
+        return slice;
+    }
+
+    if (UTILS_UNLIKELY(mCurrentOffset + classSize > BUFFER_SIZE)) {
+        // Give the tail of the current buffer to the free lists, largest classes first. All
+        // offsets are multiples of ALIGNMENT so the tail always decomposes exactly.
+        for (size_t c = SIZE_CLASS_COUNT; c-- > 0;) {
+            uint32_t const s = ALIGNMENT << c;
+            while (mCurrentBuffer && mCurrentOffset + s <= BUFFER_SIZE) {
+                mFreeLists[c].push_back({ mCurrentBuffer, mCurrentOffset, s });
+                mCurrentOffset += s;
+            }
+        }
+        mCurrentBuffer = createBuffer(driver, BUFFER_SIZE);
+        mCurrentOffset = 0;
+    }
+
+    Slice const slice{ mCurrentBuffer, mCurrentOffset, classSize };
+    mCurrentOffset += classSize;
+    mStats.slices++;
+    return slice;
+}
+
+void UniformBufferPool::free(DriverApi& driver, Slice const& slice) noexcept {
+    if (!slice) {
+        return;
+    }
+    assert_invariant(mStats.slices);
+    mStats.slices--;
+
+    if (UTILS_UNLIKELY(slice.size > BUFFER_SIZE)) {
+        // dedicated buffer
+        auto const pos = std::find(mBuffers.begin(), mBuffers.end(), slice.boh);
+        assert_invariant(pos != mBuffers.end());
+        mBuffers.erase(pos);
+        destroyBuffer(driver, slice.boh);
+        return;
+    }
+
+    size_t const sizeClass = getSizeClass(slice.size);
+    assert_invariant((ALIGNMENT << sizeClass) == slice.size);
+    mFreeLists[sizeClass].push_back(slice);
+}
+
+} // namespace filament
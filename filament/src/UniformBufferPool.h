@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_FILAMENT_UNIFORMBUFFERPOOL_H
+#define TNT_FILAMENT_UNIFORMBUFFERPOOL_H
+
+#include <backend/DriverApiForward.h>
+#include <backend/Handle.h>
+
+#include <array>
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace filament {
+
+class DescriptorSetCache;
+
+/*
+ * Sub-allocates small uniform buffers (typically the uniforms of material instances) out of a
+ * few large buffer objects.
+ *
+ * Slices are aligned so that they can be bound with a dynamic offset, and their size is rounded
+ * up to a power-of-two size class. Freed slices go back to the free list of their size class and
+ * are reused as-is, the buffer objects themselves are only destroyed by terminate().
+ *
+ * Requests larger than a buffer object get a dedicated buffer object, destroyed with its slice.
+ * Buffer objects are evicted from the descriptor set cache before they're destroyed.
+ */
+class UniformBufferPool {
+public:
+    // conservative minimum dynamic offset alignment, this is what D3D12 requires
+    static constexpr uint32_t ALIGNMENT = 256;
+
+    // size of the buffer objects slices are carved from
+    static constexpr uint32_t BUFFER_SIZE = 256 * 1024;
+
+    struct Slice {
+        backend::Handle<backend::HwBufferObject> boh;
+        uint32_t offset = 0;    // in bytes, multiple of ALIGNMENT
+        uint32_t size = 0;      // in bytes, size of the slice's size class
+        explicit operator bool() const noexcept { return bool(boh); }
+    };
+
+    struct Stats {
+        uint32_t buffers = 0;   // live buffer objects, including dedicated ones
+        uint32_t slices = 0;    // live slices
+        uint32_t reused = 0;    // allocations served from a free list
+    };
+
+    explicit UniformBufferPool(DescriptorSetCache& descriptorSetCache) noexcept;
+    ~UniformBufferPool() noexcept;
+
+    UniformBufferPool(UniformBufferPool const& rhs) = delete;
+    UniformBufferPool(UniformBufferPool&& rhs) noexcept = delete;
+    UniformBufferPool& operator=(UniformBufferPool const& rhs) = delete;
+    UniformBufferPool& operator=(UniformBufferPool&& rhs) noexcept = delete;
+
+    void terminate(backend::DriverApi& driver) noexcept;
+
+    // returns a slice of at least `size` bytes, its content is undefined
+    Slice allocate(backend::DriverApi& driver, size_t size) noexcept;
+
+    void free(backend::DriverApi& driver, Slice const& slice) noexcept;
+
+    Stats const& getStats() const noexcept { return mStats; }
+
+private:
+    // ALIGNMENT, 2*ALIGNMENT, ... up to BUFFER_SIZE
+    static constexpr size_t SIZE_CLASS_COUNT = 11;
+    static_assert((ALIGNMENT << (SIZE_CLASS_COUNT - 1)) == BUFFER_SIZE);
+
+    static size_t getSizeClass(size_t size) noexcept;
+
+    backend::Handle<backend::HwBufferObject> createBuffer(
+            backend::DriverApi& driver, uint32_t size) noexcept;
+
+    void destroyBuffer(backend::DriverApi& driver,
+            backend::Handle<backend::HwBufferObject> boh) noexcept;
+
+    DescriptorSetCache& mDescriptorSetCache;
+    std::array<std::vector<Slice>, SIZE_CLASS_COUNT> mFreeLists;
+    std::vector<backend::Handle<backend::HwBufferObject>> mBuffers;
+    backend::Handle<backend::HwBufferObject> mCurrentBuffer;
+    uint32_t mCurrentOffset = BUFFER_SIZE;
+    Stats mStats;
+};
+
+} // namespace filament
+
+#endif // TNT_FILAMENT_UNIFORMBUFFERPOOL_H
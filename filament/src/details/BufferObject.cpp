@@ -74,6 +74,8 @@ FBufferObject::FBufferObject(FEngine& engine, const Builder& builder)
 
 void FBufferObject::terminate(FEngine& engine) {
     FEngine::DriverApi& driver = engine.getDriverApi();
+    // its id can be reused as soon as it's destroyed
+    engine.getDescriptorSetLayoutFactory().getDescriptorSetCache().evict(mHandle.getId());
     driver.destroyBufferObject(mHandle);
 }
 
@@ -20,11 +20,14 @@
 #include "downcast.h"
 
 #include "Allocators.h"
+#include "HandleArena.h"
 // #include "DFG.h"
 // #include "PostProcessManager.h"
 #include "ResourceList.h"
 #include "HwDescriptorSetLayoutFactory.h"
+#include "HwProgramFactory.h"
 #include "HwVertexBufferInfoFactory.h"
+#include "UniformBufferPool.h"
 // 
 #include "components/CameraManager.h"
 #include "components/LightManager.h"
@@ -45,9 +48,10 @@
 // #include "details/MorphTargetBuffer.h"
 #include "details/Skybox.h"
 // 
-// #include "private/backend/CommandBufferQueue.h"
+#include "private/backend/CommandBufferQueue.h"
 #include "private/backend/CommandStream.h"
 #include "private/backend/DriverApi.h"
+#include "private/backend/SecondaryCommandStreams.h"
 
 #include <private/filament/EngineEnums.h>
 #include <private/filament/BufferInterfaceBlock.h>
@@ -82,6 +86,7 @@
 #include <thread>
 #include <type_traits>
 #include <unordered_map>
+#include <vector>
 
 #if FILAMENT_ENABLE_MATDBG
 #include <matdbg/DebugServer.h>
@@ -140,7 +145,9 @@ public:
     using duration = clock::duration;
 
 public:
-    static Engine* create();
+    // Backend::NOOP runs the engine without a GPU, any other backend uses Diligent.
+    // Headless builds (FILAMENT_HEADLESS) only have the no-op backend.
+    static Engine* create(Backend backend = Backend::DEFAULT);
 
 #if UTILS_HAS_THREADING
     static void create(Builder const& builder, utils::Invocable<void(void* token)>&& callback);
@@ -308,7 +315,7 @@ public:
 //     FInstanceBuffer* createInstanceBuffer(const InstanceBuffer::Builder& builder) noexcept;
     FIndirectLight* createIndirectLight(const IndirectLight::Builder& builder) noexcept;
     FMaterial* createMaterial(const Material::Builder& builder, std::unique_ptr<MaterialParser> materialParser) noexcept;
-//     FTexture* createTexture(const Texture::Builder& builder) noexcept;
+    FTexture* createTexture(const Texture::Builder& builder) noexcept;
     FSkybox* createSkybox(const Skybox::Builder& builder) noexcept;
 //     FColorGrading* createColorGrading(const ColorGrading::Builder& builder) noexcept;
 //     FStream* createStream(const Stream::Builder& builder) noexcept;
@@ -343,14 +350,14 @@ public:
 //     bool destroy(const FSkinningBuffer* p);
 //     bool destroy(const FMorphTargetBuffer* p);
 //     bool destroy(const FIndirectLight* p);
-    bool destroy(const FMaterial* p) { return true; }
-    bool destroy(const FMaterialInstance* p) { return true; }
+    bool destroy(const FMaterial* p);
+    bool destroy(const FMaterialInstance* p);
 //     bool destroy(const FRenderer* p);
 //     bool destroy(const FScene* p);
 //     bool destroy(const FSkybox* p);
 //     bool destroy(const FColorGrading* p);
 //     bool destroy(const FStream* p);
-    bool destroy(const FTexture* p) { return true; }
+    bool destroy(const FTexture* p);
 //     bool destroy(const FRenderTarget* p);
 //     bool destroy(const FSwapChain* p);
 //     bool destroy(const FView* p);
@@ -363,8 +370,8 @@ public:
 //     bool isValid(const FSkinningBuffer* p) const;
 //     bool isValid(const FMorphTargetBuffer* p) const;
 //     bool isValid(const FIndirectLight* p) const;
-    bool isValid(const FMaterial* p) const { return true; }
-    bool isValid(const FMaterial* m, const FMaterialInstance* p) const { return true; }
+    bool isValid(const FMaterial* p) const { return mMaterials.isValid(p); }
+    bool isValid(const FMaterial* m, const FMaterialInstance* p) const;
 //     bool isValidExpensive(const FMaterialInstance* p) const;
 //     bool isValid(const FRenderer* p) const;
 //     bool isValid(const FScene* p) const;
@@ -372,7 +379,13 @@ public:
 //     bool isValid(const FColorGrading* p) const;
 //     bool isValid(const FSwapChain* p) const;
 //     bool isValid(const FStream* p) const;
-    bool isValid(const FTexture* p) const { return true; }
+    bool isValid(const FTexture* p) const { return mTextures.isValid(p); }
+    // Also false if the texture `ref` was taken from was destroyed, even if another one reuses its
+    // slot since, see HandleArena.
+    bool isValid(const FTexture* p, HandleArenaBase::Ref const ref) const {
+        return mTextures.isValid(p) && mTextures.isValid(ref);
+    }
+    HandleArenaBase::Ref getRef(const FTexture* p) const { return mTextures.getRef(p); }
 //     bool isValid(const FRenderTarget* p) const;
 //     bool isValid(const FView* p) const;
 //     bool isValid(const FInstanceBuffer* p) const;
@@ -405,13 +418,18 @@ public:
     // flush the current buffer
     void flush();
 
-    // flush the current buffer based on some heuristics
+    // Returns a command stream that a job can record into while other jobs record into other
+    // indices. Must be called on the engine thread before the jobs start.
+    DriverApi& getSecondaryDriverApi(size_t index);
+
+    // Appends the secondary command streams to the main one in index order, and flushes.
+    // Must be called on the engine thread after the jobs are done.
+    void submitSecondaryDriverApis();
+
+    // flush the current buffer once it holds more than the flush threshold
     void flushIfNeeded() {
-        auto counter = mFlushCounter + 1;
-        if (UTILS_LIKELY(counter < 128)) {
-            mFlushCounter = counter;
-        } else {
-            mFlushCounter = 0;
+        if (UTILS_UNLIKELY(mCommandBufferQueue.getCircularBuffer().getUsed() >= mFlushThreshold)) {
+            mFlushStats.budgetCount++;
             flush();
         }
     }
@@ -424,11 +442,46 @@ public:
         return mPlatform->pumpEvents();
     }
 
+    // Must be called once per frame, before the frame's commands are recorded.
     void prepare();
     void gc();
 
+    // Must be called once per frame, after the frame's commands have been submitted. Resources
+    // retired during the frame become reusable once the GPU is done with it.
+    void endFrame() noexcept;
+
+    // The backend forgets the bound descriptor sets when a render pass begins and when a pipeline
+    // is bound, the code doing these must call the methods below so that the next binds aren't
+    // skipped. See DescriptorSetCache::needsBind().
+    void beginRenderPass() noexcept;
+    void bindPipeline() noexcept;
+
+    // memory used by the commands of the last frame, in the CircularBuffer and out of it
+    backend::CommandStream::Usage getCommandStreamUsage() const noexcept {
+        return mCommandStreamUsage;
+    }
+
+    // command buffer flushes of a frame, for sizing Config::commandBufferSizeMB
+    struct FlushStats {
+        uint32_t count = 0;             // all flushes
+        uint32_t budgetCount = 0;       // flushes from flushIfNeeded()
+        uint32_t idleCount = 0;         // flushes finding the render thread waiting for commands
+        size_t bytes = 0;               // bytes flushed
+        size_t largest = 0;             // largest flush in bytes
+        duration stallTime{};           // time waiting for the render thread to free space
+        size_t highWatermark = 0;       // largest use of the command buffer so far, in bytes
+        size_t flushThreshold = 0;      // flushIfNeeded() threshold during the frame, in bytes
+    };
+
+    // flushes of the last frame
+    FlushStats const& getFlushStats() const noexcept {
+        return mLastFlushStats;
+    }
+
     using ShaderContent = utils::FixedCapacityVector<uint8_t>;
 
+    // Scratch space for shader extraction on the engine thread only. Jobs building programs
+    // concurrently must use their own (see FMaterial::prepareProgramsParallel).
     ShaderContent& getVertexShaderContent() const noexcept {
         return mVertexShaderContent;
     }
@@ -443,21 +496,21 @@ public:
 
     bool execute();
 
-//     utils::JobSystem& getJobSystem() const noexcept {
-//         // JobSystem is thread-safe, and it's always okay to return a non-const one,
-//         // it's conceptually the same as if we were holding a non-const reference, as opposed
-//         // to by-value class attribute.
-//         return const_cast<utils::JobSystem&>(mJobSystem);
-//     }
+    utils::JobSystem& getJobSystem() const noexcept {
+        // JobSystem is thread-safe, and it's always okay to return a non-const one,
+        // it's conceptually the same as if we were holding a non-const reference, as opposed
+        // to by-value class attribute.
+        return const_cast<utils::JobSystem&>(mJobSystem);
+    }
 
     std::default_random_engine& getRandomEngine() {
         return mRandomEngine;
     }
 
-//     void pumpMessageQueues() const {
-//         getDriver().purge();
-//     }
-// 
+    void pumpMessageQueues() const {
+        getDriver().purge();
+    }
+
 //     void unprotected() noexcept;
 
     void setAutomaticInstancingEnabled(bool const enable) noexcept {
@@ -479,6 +532,15 @@ public:
         return mHwDescriptorSetLayoutFactory;
     }
 
+    HwProgramFactory& getProgramFactory() noexcept {
+        return mHwProgramFactory;
+    }
+
+    // how many programs were shared across materials so far
+    HwProgramFactory::Stats const& getProgramStats() const noexcept {
+        return mHwProgramFactory.getStats();
+    }
+
     DescriptorSetLayout const& getPerViewDescriptorSetLayoutDepthVariant() const noexcept {
         return mPerViewDescriptorSetLayoutDepthVariant;
     }
@@ -502,6 +564,10 @@ public:
     size_t getPerFrameCommandsSize() const noexcept { return mConfig.perFrameCommandsSizeMB * MiB; }
     size_t getPerRenderPassArenaSize() const noexcept { return mConfig.perRenderPassArenaSizeMB * MiB; }
     size_t getRequestedDriverHandleArenaSize() const noexcept { return mConfig.driverHandleArenaSizeMB * MiB; }
+    // size of the arena of materials, see HandleArena
+    size_t getHandleArenaSize() const noexcept {
+        return mConfig.driverHandleArenaSizeMB ? getRequestedDriverHandleArenaSize() : 4 * MiB;
+    }
     Config const& getConfig() const noexcept { return mConfig; }
 
     bool hasFeatureLevel(backend::FeatureLevel const neededFeatureLevel) const noexcept {
@@ -512,6 +578,21 @@ public:
         return mMaterialInstances;
     }
 
+    // uniform buffers of all material instances are sub-allocated from this pool
+    UniformBufferPool& getMaterialUniformPool() noexcept { return mMaterialUniformPool; }
+
+    // Instances with modified uniforms or textures register themselves here, they're all
+    // committed at once by commitMaterialInstances().
+    void addDirtyMaterialInstance(FMaterialInstance const* mi) noexcept {
+        mDirtyMaterialInstances.push_back(mi);
+    }
+
+    void removeDirtyMaterialInstance(FMaterialInstance const* mi) noexcept;
+
+    // Commits all dirty material instances. Their uniforms are packed into a single staging
+    // allocation of the command stream.
+    void commitMaterialInstances(DriverApi& driver);
+
 #if defined(__EMSCRIPTEN__)
     void resetBackendState() noexcept;
 #endif
@@ -520,11 +601,11 @@ public:
 
 private:
     explicit FEngine();
-    void init();
+    bool init();
     void shutdown();
 
     int loop();
-//     void flushCommandBuffer(backend::CommandBufferQueue& commandBufferQueue) const;
+    void flushCommandBuffer(backend::CommandBufferQueue& commandBufferQueue) const;
 // 
 //     template<typename T>
 //     bool isValid(const T* ptr, ResourceList<T> const& list) const;
@@ -541,6 +622,9 @@ private:
 //     template<typename T, typename Lock>
 //     void cleanupResourceListLocked(Lock& lock, ResourceList<T>&& list);
 
+    // Creation parameters
+    Config mConfig;
+
     backend::Driver* mDriver = nullptr;
     backend::Handle<backend::HwRenderTarget> mDefaultRenderTarget;
 
@@ -565,6 +649,7 @@ private:
 //     std::shared_ptr<ResourceAllocatorDisposer> mResourceAllocatorDisposer;
     HwVertexBufferInfoFactory mHwVertexBufferInfoFactory;
     HwDescriptorSetLayoutFactory mHwDescriptorSetLayoutFactory;
+    HwProgramFactory mHwProgramFactory;
     DescriptorSetLayout mPerViewDescriptorSetLayoutDepthVariant;
     DescriptorSetLayout mPerViewDescriptorSetLayoutSsrVariant;
     DescriptorSetLayout mPerRenderableDescriptorSetLayout;
@@ -581,8 +666,8 @@ private:
 //     ResourceList<FInstanceBuffer> mInstanceBuffers{ "InstanceBuffer" };
     ResourceList<FVertexBuffer> mVertexBuffers{ "VertexBuffer" };
     ResourceList<FIndirectLight> mIndirectLights{ "IndirectLight" };
-    ResourceList<FMaterial> mMaterials{ "Material" };
-//     ResourceList<FTexture> mTextures{ "Texture" };
+    HandleArena<FMaterial> mMaterials{ "Material", getHandleArenaSize() };
+    HandleArena<FTexture> mTextures{ "Texture", getHandleArenaSize() };
     ResourceList<FSkybox> mSkyboxes{ "Skybox" };
 //     ResourceList<FColorGrading> mColorGradings{ "ColorGrading" };
 //     ResourceList<FRenderTarget> mRenderTargets{ "RenderTarget" };
@@ -596,19 +681,35 @@ private:
     // FMaterialInstance are handled directly by FMaterial
     std::unordered_map<const FMaterial*, ResourceList<FMaterialInstance>> mMaterialInstances;
 
+    std::vector<FMaterialInstance const*> mDirtyMaterialInstances;
+
+
+    UniformBufferPool mMaterialUniformPool{ mHwDescriptorSetLayoutFactory.getDescriptorSetCache() };
+
 //     DFG mDFG;
 
     std::thread mDriverThread;
- //   backend::CommandBufferQueue mCommandBufferQueue;
+    backend::CommandBufferQueue mCommandBufferQueue;
     std::aligned_storage<sizeof(DriverApi), alignof(DriverApi)>::type mDriverApiStorage;
     static_assert( sizeof(mDriverApiStorage) >= sizeof(DriverApi) );
+    std::optional<backend::SecondaryCommandStreams> mSecondaryCommandStreams;
+    backend::CommandStream::Usage mCommandStreamUsage;
+
+    // Flushing more often lets the render thread start earlier, but each flush has a cost.
+    // Never more than half the minimum size, so that the commands recorded between two
+    // flushIfNeeded() calls fit.
+    size_t getMaxFlushThreshold() const noexcept { return getMinCommandBufferSize() / 2; }
+    size_t getMinFlushThreshold() const noexcept { return getMaxFlushThreshold() / 16; }
+    void updateFlushThreshold() noexcept;
 
-    uint32_t mFlushCounter = 0;
+    size_t mFlushThreshold = getMaxFlushThreshold();
+    FlushStats mFlushStats;
+    FlushStats mLastFlushStats;
 
 //     RootArenaScope::Arena mPerRenderPassArena;
     HeapAllocatorArena mHeapAllocator;
 
-//    utils::JobSystem mJobSystem;
+    utils::JobSystem mJobSystem;
     static uint32_t getJobSystemThreadPoolSize(Config const& config) noexcept;
 
     std::default_random_engine mRandomEngine;
@@ -640,9 +741,6 @@ private:
 
     bool mInitialized = false;
 
-    // Creation parameters
-    Config mConfig;
-
 public:
     // These are the debug properties used by FDebug.
     // They're accessed directly by modules who need them.
@@ -703,6 +801,9 @@ public:
                 bool assert_material_instance_in_use = false;
                 bool assert_destroy_material_before_material_instance = false;
             } debug;
+            struct {
+                bool adaptive_flush = true;
+            } commands;
         } engine;
         struct {
             struct {
@@ -739,6 +840,9 @@ public:
             { "features.engine.debug.assert_destroy_material_before_material_instance",
               "Assert when a Material is destroyed but its instances are still alive.",
               &features.engine.debug.assert_destroy_material_before_material_instance, false },
+            { "engine.commands.adaptive_flush",
+              "Adapts the command buffer flush threshold to the render thread's progress.",
+              &features.engine.commands.adaptive_flush, false },
     }};
 
     utils::Slice<const FeatureFlag> getFeatureFlags() const noexcept {
@@ -195,6 +195,9 @@ FIndirectLight::FIndirectLight(FEngine& engine, const Builder& builder) noexcept
 void FIndirectLight::terminate(FEngine& engine) {
     if (CONFIG_IBL_USE_IRRADIANCE_MAP) {
         FEngine::DriverApi& driver = engine.getDriverApi();
+        // its id can be reused as soon as it's destroyed
+        engine.getDescriptorSetLayoutFactory().getDescriptorSetCache().evict(
+                getIrradianceHwHandle().getId());
         driver.destroyTexture(getIrradianceHwHandle());
     }
 }
@@ -50,12 +50,14 @@
 #include <utils/FixedCapacityVector.h>
 #include <utils/Hash.h>
 #include <utils/Invocable.h>
+#include <utils/JobSystem.h>
 #include <utils/Log.h>
 #include <utils/Panic.h>
 #include <utils/bitset.h>
 #include <utils/compiler.h>
 #include <utils/debug.h>
 #include <utils/ostream.h>
+#include <utils/Slice.h>
 
 #include <algorithm>
 #include <array>
@@ -267,6 +269,15 @@ FMaterial::FMaterial(FEngine& engine, const Builder& builder,
     success = parser->getUIB(&mUniformInterfaceBlock);
     assert_invariant(success);
 
+    buildParameterTable();
+
+    // uniforms are stored right after the instance, aligned for std140 vec4 accesses
+    constexpr size_t uniformAlignment = 16;
+    mInstanceUniformOffset = uint32_t((sizeof(FMaterialInstance) + uniformAlignment - 1) &
+            ~(uniformAlignment - 1));
+    mInstanceAllocator.init(mInstanceUniformOffset + mUniformInterfaceBlock.getSize(),
+            std::max(alignof(FMaterialInstance), uniformAlignment));
+
     if (UTILS_UNLIKELY(parser->getShaderLanguage() == ShaderLanguage::ESSL1)) {
         success = parser->getAttributeInfo(&mAttributeInfo);
         assert_invariant(success);
@@ -391,6 +402,12 @@ void FMaterial::terminate(FEngine& engine) {
             if (UTILS_UNLIKELY(!pos->second.empty())) {
                 slog.e << "destroying material \"" << this->getName().c_str_safe() << "\" but "
                               << pos->second.size() << " instances still alive." << io::endl;
+                // The instances live in our slab and reference our layouts, they must go first.
+                // forEach() tolerates the removal of the current element.
+                pos->second.forEach([&engine](FMaterialInstance const* mi) {
+                    engine.destroy(mi);
+                });
+                assert_invariant(pos->second.empty());
             }
         }
     }
@@ -426,13 +443,13 @@ void FMaterial::compile(CompilerPriorityQueue const priority,
     if (UTILS_LIKELY(mEngine.getDriverApi().isParallelShaderCompileSupported())) {
         auto const& variants = isVariantLit() ?
                 VariantUtils::getLitVariants() : VariantUtils::getUnlitVariants();
+        auto filtered = FixedCapacityVector<Variant>::with_capacity(variants.size());
         for (auto const variant: variants) {
             if (!variantFilter || variant == Variant::filterUserVariant(variant, variantFilter)) {
-                if (hasVariant(variant)) {
-                    prepareProgram(variant, priority);
-                }
+                filtered.push_back(variant);
             }
         }
+        prepareProgramsParallel({ filtered.data(), filtered.size() }, priority);
     }
 
     if (callback) {
@@ -471,13 +488,68 @@ FMaterialInstance* FMaterial::getDefaultInstance() noexcept {
 }
 
 bool FMaterial::hasParameter(const char* name) const noexcept {
-    return mUniformInterfaceBlock.hasField(name) ||
-           mSamplerInterfaceBlock.hasSampler(name) ||
+    return getParameterHandle(name).isValid() ||
             mSubpassInfo.name == CString(name);
 }
 
 bool FMaterial::isSampler(const char* name) const noexcept {
-    return mSamplerInterfaceBlock.hasSampler(name);
+    return getParameterHandle(name).isSampler();
+}
+
+void FMaterial::buildParameterTable() noexcept {
+    auto const& uniforms = mUniformInterfaceBlock.getFieldInfoList();
+    auto const& samplers = mSamplerInterfaceBlock.getSamplerInfoList();
+    mParameterTable = FixedCapacityVector<ParameterTableEntry>::with_capacity(
+            uniforms.size() + samplers.size());
+
+    std::hash<std::string_view> const hasher;
+    for (auto const& info : uniforms) {
+        std::string_view const name{ info.name.c_str(), info.name.size() };
+        ParameterHandle handle;
+        handle.mMaterial = this;
+        handle.mOffset = uint32_t(mUniformInterfaceBlock.getFieldOffset(name, 0));
+        handle.mCount = uint16_t(std::max(1u, info.size));
+        handle.mType = info.type;
+        handle.mKind = ParameterHandle::Kind::UNIFORM;
+        mParameterTable.push_back({ hasher(name), name, handle });
+    }
+    for (auto const& info : samplers) {
+        std::string_view const name{ info.name.c_str(), info.name.size() };
+        ParameterHandle handle;
+        handle.mMaterial = this;
+        handle.mOffset = info.binding;
+        handle.mCount = 1;
+        handle.mKind = ParameterHandle::Kind::SAMPLER;
+        mParameterTable.push_back({ hasher(name), name, handle });
+    }
+
+    std::sort(mParameterTable.begin(), mParameterTable.end(),
+            [](ParameterTableEntry const& lhs, ParameterTableEntry const& rhs) {
+                return lhs.hash < rhs.hash;
+            });
+}
+
+FMaterial::ParameterHandle FMaterial::getParameterHandle(std::string_view const name) const noexcept {
+    size_t const hash = std::hash<std::string_view>{}(name);
+    auto pos = std::lower_bound(mParameterTable.begin(), mParameterTable.end(), hash,
+            [](ParameterTableEntry const& entry, size_t const h) {
+                return entry.hash < h;
+            });
+    for (; pos != mParameterTable.end() && pos->hash == hash; ++pos) {
+        if (pos->name == name) {
+            return pos->handle;
+        }
+    }
+    return {};
+}
+
+ssize_t FMaterial::getUniformOffset(std::string_view const name) const {
+    ParameterHandle const handle = getParameterHandle(name);
+    if (UTILS_LIKELY(handle.mKind == ParameterHandle::Kind::UNIFORM)) {
+        return handle.mOffset;
+    }
+    // let the interface block report the error
+    return mUniformInterfaceBlock.getFieldOffset(name, 0);
 }
 
 BufferInterfaceBlock::FieldInfo const* FMaterial::reflect(
@@ -512,12 +584,16 @@ bool FMaterial::hasVariant(Variant const variant) const noexcept {
 void FMaterial::prepareProgramSlow(Variant const variant,
         backend::CompilerPriorityQueue const priorityQueue) const noexcept {
     assert_invariant(mEngine.hasFeatureLevel(mFeatureLevel));
+    ShaderContent& vsBuilder = mEngine.getVertexShaderContent();
+    ShaderContent& fsBuilder = mEngine.getFragmentShaderContent();
     switch (getMaterialDomain()) {
         case MaterialDomain::SURFACE:
-            getSurfaceProgramSlow(variant, priorityQueue);
+            createAndCacheProgram(
+                    getSurfaceProgram(variant, priorityQueue, vsBuilder, fsBuilder), variant);
             break;
         case MaterialDomain::POST_PROCESS:
-            getPostProcessProgramSlow(variant, priorityQueue);
+            createAndCacheProgram(
+                    getPostProcessProgram(variant, priorityQueue, vsBuilder, fsBuilder), variant);
             break;
         case MaterialDomain::COMPUTE:
             // TODO: implement MaterialDomain::COMPUTE
@@ -525,8 +601,66 @@ void FMaterial::prepareProgramSlow(Variant const variant,
     }
 }
 
-void FMaterial::getSurfaceProgramSlow(Variant const variant,
+void FMaterial::prepareProgramsParallel(Slice<const Variant> const variants,
         CompilerPriorityQueue const priorityQueue) const noexcept {
+    assert_invariant(mEngine.hasFeatureLevel(mFeatureLevel));
+
+    MaterialDomain const domain = getMaterialDomain();
+    if (domain == MaterialDomain::COMPUTE) {
+        // TODO: implement MaterialDomain::COMPUTE
+        return;
+    }
+
+    auto pending = FixedCapacityVector<Variant>::with_capacity(variants.size());
+    for (auto const variant: variants) {
+        if (!isCached(variant) && hasVariant(variant)) {
+            pending.push_back(variant);
+        }
+    }
+    if (pending.empty()) {
+        return;
+    }
+
+    // Extracting the shaders (dictionary lookups, decompression, text assembly) is where the
+    // time goes, and it only reads from the MaterialParser, so it can run on all cores.
+    // createProgram() must be issued from this thread, so it happens serially afterward, in
+    // variant order, which keeps the resulting handles deterministic.
+    std::unique_ptr<std::optional<Program>[]> const programs{
+            new(std::nothrow) std::optional<Program>[pending.size()] };
+    FILAMENT_CHECK_POSTCONDITION(programs) << "out of memory";
+
+    struct {
+        Variant const* variants;
+        std::optional<Program>* programs;
+        CompilerPriorityQueue priorityQueue;
+        MaterialDomain domain;
+    } const ctx{ pending.data(), programs.get(), priorityQueue, domain };
+
+    JobSystem& js = mEngine.getJobSystem();
+    auto* const job = jobs::parallel_for(js, nullptr, 0, uint32_t(pending.size()),
+            [this, &ctx](uint32_t const start, uint32_t const count) {
+                // per-job scratch space, reused for all the variants of this slice
+                ShaderContent vsBuilder;
+                ShaderContent fsBuilder;
+                for (uint32_t i = start, e = start + count; i < e; i++) {
+                    Variant const variant = ctx.variants[i];
+                    ctx.programs[i].emplace(ctx.domain == MaterialDomain::SURFACE ?
+                            getSurfaceProgram(variant, ctx.priorityQueue, vsBuilder, fsBuilder) :
+                            getPostProcessProgram(variant, ctx.priorityQueue, vsBuilder, fsBuilder));
+                }
+            }, jobs::CountSplitter<1, 8>());
+    js.runAndWait(job);
+
+    for (size_t i = 0, c = pending.size(); i < c; i++) {
+        createAndCacheProgram(std::move(*programs[i]), pending[i]);
+        // the programs' sources are large, don't let them all pile up in the command buffer
+        mEngine.flushIfNeeded();
+    }
+}
+
+Program FMaterial::getSurfaceProgram(Variant const variant,
+        CompilerPriorityQueue const priorityQueue,
+        ShaderContent& vsBuilder, ShaderContent& fsBuilder) const noexcept {
     // filterVariant() has already been applied in generateCommands(), shouldn't be needed here
     // if we're unlit, we don't have any bits that correspond to lit materials
     assert_invariant(variant == Variant::filterVariant(variant, isVariantLit()) );
@@ -536,25 +670,29 @@ void FMaterial::getSurfaceProgramSlow(Variant const variant,
     Variant const vertexVariant   = Variant::filterVariantVertex(variant);
     Variant const fragmentVariant = Variant::filterVariantFragment(variant);
 
-    Program pb{ getProgramWithVariants(variant, vertexVariant, fragmentVariant) };
+    Program pb{ getProgramWithVariants(variant, vertexVariant, fragmentVariant,
+            vsBuilder, fsBuilder) };
     pb.priorityQueue(priorityQueue);
     pb.multiview(
             mEngine.getConfig().stereoscopicType == StereoscopicType::MULTIVIEW &&
             Variant::isStereoVariant(variant));
-    createAndCacheProgram(std::move(pb), variant);
+    return pb;
 }
 
-void FMaterial::getPostProcessProgramSlow(Variant const variant,
-        CompilerPriorityQueue const priorityQueue) const noexcept {
-    Program pb{ getProgramWithVariants(variant, variant, variant) };
+Program FMaterial::getPostProcessProgram(Variant const variant,
+        CompilerPriorityQueue const priorityQueue,
+        ShaderContent& vsBuilder, ShaderContent& fsBuilder) const noexcept {
+    Program pb{ getProgramWithVariants(variant, variant, variant, vsBuilder, fsBuilder) };
     pb.priorityQueue(priorityQueue);
-    createAndCacheProgram(std::move(pb), variant);
+    return pb;
 }
 
 Program FMaterial::getProgramWithVariants(
         Variant variant,
         Variant vertexVariant,
-        Variant fragmentVariant) const noexcept {
+        Variant fragmentVariant,
+        ShaderContent& vsBuilder,
+        ShaderContent& fsBuilder) const noexcept {
     FEngine const& engine = mEngine;
     const ShaderModel sm = engine.getShaderModel();
     const bool isNoop = engine.getBackend() == Backend::NOOP;
@@ -562,8 +700,6 @@ Program FMaterial::getProgramWithVariants(
      * Vertex shader
      */
 
-    ShaderContent& vsBuilder = engine.getVertexShaderContent();
-
     UTILS_UNUSED_IN_RELEASE bool const vsOK = mMaterialParser->getShader(vsBuilder, sm,
             vertexVariant, ShaderStage::VERTEX);
 
@@ -577,8 +713,6 @@ Program FMaterial::getProgramWithVariants(
      * Fragment shader
      */
 
-    ShaderContent& fsBuilder = engine.getFragmentShaderContent();
-
     UTILS_UNUSED_IN_RELEASE bool const fsOK = mMaterialParser->getShader(fsBuilder, sm,
             fragmentVariant, ShaderStage::FRAGMENT);
 
@@ -640,8 +774,9 @@ void FMaterial::createAndCacheProgram(Program&& p, Variant const variant) const
         }
     }
 
-    auto const program = driverApi.createProgram(std::move(p));
-    driverApi.setDebugTag(program.getId(), mName);
+    // Materials generated from the same template often end up with byte-identical programs,
+    // the factory shares those across materials.
+    auto const program = mEngine.getProgramFactory().create(driverApi, std::move(p), mName);
     assert_invariant(program);
     mCachedPrograms[variant.key] = program;
 
@@ -651,8 +786,6 @@ void FMaterial::createAndCacheProgram(Program&& p, Variant const variant) const
     if (isShared) {
         FMaterial const* const pDefaultMaterial = engine.getDefaultMaterial();
         if (pDefaultMaterial && !pDefaultMaterial->mCachedPrograms[variant.key]) {
-            // set the tag to the default material name
-            driverApi.setDebugTag(program.getId(), mName);
             pDefaultMaterial->mCachedPrograms[variant.key] = program;
         }
     }
@@ -764,6 +897,7 @@ void FMaterial::destroyPrograms(FEngine& engine,
         Variant::type_t const variantMask, Variant::type_t const variantValue) {
 
     DriverApi& driverApi = engine.getDriverApi();
+    HwProgramFactory& factory = engine.getProgramFactory();
     auto& cachedPrograms = mCachedPrograms;
 
     switch (mMaterialDomain) {
@@ -775,7 +909,7 @@ void FMaterial::destroyPrograms(FEngine& engine,
                         // Only destroy if the handle is valid. Not strictly needed, but we have a lot
                         // of variants, and this generates traffic in the command queue.
                         if (cachedPrograms[k]) {
-                            driverApi.destroyProgram(std::move(cachedPrograms[k]));
+                            factory.destroy(driverApi, std::move(cachedPrograms[k]));
                         }
                     }
                 }
@@ -806,7 +940,7 @@ void FMaterial::destroyPrograms(FEngine& engine,
                                 continue;
                             }
 
-                            driverApi.destroyProgram(std::move(cachedPrograms[k]));
+                            factory.destroy(driverApi, std::move(cachedPrograms[k]));
                         }
                     }
                 }
@@ -819,7 +953,7 @@ void FMaterial::destroyPrograms(FEngine& engine,
                     // Only destroy if the handle is valid. Not strictly needed, but we have a lot
                     // of variant, and this generates traffic in the command queue.
                     if (cachedPrograms[k]) {
-                        driverApi.destroyProgram(std::move(cachedPrograms[k]));
+                        factory.destroy(driverApi, std::move(cachedPrograms[k]));
                     }
                 }
             }
@@ -827,7 +961,7 @@ void FMaterial::destroyPrograms(FEngine& engine,
         }
         case MaterialDomain::COMPUTE: {
             // Compute programs don't have variants
-            driverApi.destroyProgram(std::move(cachedPrograms[0]));
+            factory.destroy(driverApi, std::move(cachedPrograms[0]));
             break;
         }
     }
@@ -1106,16 +1240,17 @@ void FMaterial::precacheDepthVariants(FEngine const& engine) {
     if (UTILS_UNLIKELY(mIsDefaultMaterial)) {
         const bool stereoSupported = mEngine.getDriverApi().isStereoSupported();
         auto const allDepthVariants = VariantUtils::getDepthVariants();
+        auto variants = FixedCapacityVector<Variant>::with_capacity(allDepthVariants.size());
         for (auto const variant: allDepthVariants) {
             // Don't precache any stereo variants if stereo is not supported.
             if (!stereoSupported && Variant::isStereoVariant(variant)) {
                 continue;
             }
             assert_invariant(Variant::isValidDepthVariant(variant));
-            if (hasVariant(variant)) {
-                prepareProgram(variant);
-            }
+            variants.push_back(variant);
         }
+        prepareProgramsParallel({ variants.data(), variants.size() },
+                CompilerPriorityQueue::HIGH);
         return;
     }
 
@@ -1143,6 +1278,14 @@ void FMaterial::processDescriptorSets(FEngine& engine, MaterialParser const* con
     success = parser->getDescriptorSetLayout(&descriptorSetLayout);
     assert_invariant(success);
 
+    // Material instances share buffer objects from the engine's UniformBufferPool, the
+    // uniforms of each instance are selected by a dynamic offset.
+    for (auto& binding : descriptorSetLayout[0].bindings) {
+        if (binding.binding == 0 && binding.type == DescriptorType::UNIFORM_BUFFER) {
+            binding.flags = DescriptorFlags::DYNAMIC_OFFSET;
+        }
+    }
+
     mDescriptorSetLayout = {
             engine.getDescriptorSetLayoutFactory(),
             engine.getDriverApi(), std::move(descriptorSetLayout[0]) };
@@ -1154,6 +1297,11 @@ void FMaterial::processDescriptorSets(FEngine& engine, MaterialParser const* con
 
 descriptor_binding_t FMaterial::getSamplerBinding(
         std::string_view const& name) const {
+    ParameterHandle const handle = getParameterHandle(name);
+    if (UTILS_LIKELY(handle.isSampler())) {
+        return descriptor_binding_t(handle.mOffset);
+    }
+    // let the interface block report the error
     return mSamplerInterfaceBlock.getSamplerInfo(name)->binding;
 }
 
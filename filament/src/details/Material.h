@@ -21,6 +21,8 @@
 
 #include "details/MaterialInstance.h"
 
+#include "SlabAllocator.h"
+
 #include "ds/DescriptorSetLayout.h"
 
 #include <filament/Material.h>
@@ -44,6 +46,7 @@
 #include <utils/FixedCapacityVector.h>
 #include <utils/Invocable.h>
 #include <utils/Mutex.h>
+#include <utils/Slice.h>
 
 #include <array>
 #include <memory>
@@ -123,12 +126,29 @@ public:
 
     BufferInterfaceBlock::FieldInfo const* reflect(std::string_view name) const noexcept;
 
+    // Returns an invalid handle if the material has no such parameter.
+    ParameterHandle getParameterHandle(std::string_view name) const noexcept;
+
+    // Offset in bytes of a uniform in the uniform buffer, as
+    // getUniformInterfaceBlock().getFieldOffset(name, 0) but without going through the block.
+    ssize_t getUniformOffset(std::string_view name) const;
+
     FMaterialInstance const* getDefaultInstance() const noexcept {
         return const_cast<FMaterial*>(this)->getDefaultInstance();
     }
 
     FMaterialInstance* getDefaultInstance() noexcept;
 
+    // Memory for one FMaterialInstance of this material, followed by its uniform storage.
+    // Only FEngine creates and destroys instances.
+    void* allocateInstance() const noexcept { return mInstanceAllocator.alloc(); }
+    void freeInstance(void* p) const noexcept { mInstanceAllocator.free(p); }
+
+    // uniform storage of an instance allocated with allocateInstance()
+    void* getInstanceUniformStorage(FMaterialInstance const* mi) const noexcept {
+        return const_cast<char*>(reinterpret_cast<char const*>(mi)) + mInstanceUniformOffset;
+    }
+
     FEngine& getEngine() const noexcept  { return mEngine; }
 
     bool isCached(Variant const variant) const noexcept {
@@ -281,15 +301,26 @@ public:
 #endif
 
 private:
+    using ShaderContent = utils::FixedCapacityVector<uint8_t>;
+
     bool hasVariant(Variant variant) const noexcept;
     void prepareProgramSlow(Variant variant,
             CompilerPriorityQueue priorityQueue) const noexcept;
-    void getSurfaceProgramSlow(Variant variant,
-            CompilerPriorityQueue priorityQueue) const noexcept;
-    void getPostProcessProgramSlow(Variant variant,
+
+    // Prepares all the given variants that are not cached yet. Shader extraction is spread
+    // over the JobSystem, programs are then created serially on the calling thread.
+    void prepareProgramsParallel(utils::Slice<const Variant> variants,
             CompilerPriorityQueue priorityQueue) const noexcept;
+
+    // Builds the backend::Program for a variant without touching the cache. This is re-entrant
+    // as long as each thread provides its own scratch ShaderContent.
+    backend::Program getSurfaceProgram(Variant variant, CompilerPriorityQueue priorityQueue,
+            ShaderContent& vsBuilder, ShaderContent& fsBuilder) const noexcept;
+    backend::Program getPostProcessProgram(Variant variant, CompilerPriorityQueue priorityQueue,
+            ShaderContent& vsBuilder, ShaderContent& fsBuilder) const noexcept;
     backend::Program getProgramWithVariants(Variant variant,
-            Variant vertexVariant, Variant fragmentVariant) const noexcept;
+            Variant vertexVariant, Variant fragmentVariant,
+            ShaderContent& vsBuilder, ShaderContent& fsBuilder) const noexcept;
 
     void processBlendingMode(MaterialParser const* parser);
 
@@ -349,10 +380,24 @@ private:
     // reserve some space to construct the default material instance
     mutable FMaterialInstance* mDefaultMaterialInstance = nullptr;
 
+    // instances and their uniforms live together in slots of this allocator
+    mutable SlabAllocator mInstanceAllocator;
+    uint32_t mInstanceUniformOffset = 0;
+
     SamplerInterfaceBlock mSamplerInterfaceBlock;
     BufferInterfaceBlock mUniformInterfaceBlock;
     SubpassInfo mSubpassInfo;
 
+    // Uniforms and samplers sorted by the hash of their name, so that a name lookup is a hash
+    // followed by a binary search in a flat array. Names point into the interface blocks.
+    struct ParameterTableEntry {
+        size_t hash;
+        std::string_view name;
+        ParameterHandle handle;
+    };
+    utils::FixedCapacityVector<ParameterTableEntry> mParameterTable;
+    void buildParameterTable() noexcept;
+
     using BindingUniformInfoContainer = utils::FixedCapacityVector<std::tuple<
             uint8_t, utils::CString, backend::Program::UniformInfo>>;
 
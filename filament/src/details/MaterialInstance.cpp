@@ -50,6 +50,9 @@
 #include <string_view>
 #include <utility>
 
+#include <stddef.h>
+#include <string.h>
+
 using namespace filament::math;
 using namespace utils;
 
@@ -131,14 +134,13 @@ FMaterialInstance::FMaterialInstance(FEngine& engine, FMaterial const* material,
     FEngine::DriverApi& driver = engine.getDriverApi();
 
     if (!material->getUniformInterfaceBlock().isEmpty()) {
-        mUniforms = UniformBuffer(material->getUniformInterfaceBlock().getSize());
-        mUbHandle = driver.createBufferObject(mUniforms.getSize(),
-                BufferObjectBinding::UNIFORM, BufferUsage::STATIC);
-        driver.setDebugTag(mUbHandle.getId(), material->getName());
+        mUniforms = UniformBuffer(material->getInstanceUniformStorage(this),
+                material->getUniformInterfaceBlock().getSize());
+        mUbSlice = engine.getMaterialUniformPool().allocate(driver, mUniforms.getSize());
     }
 
-    // set the UBO, always descriptor 0
-    mDescriptorSet.setBuffer(0, mUbHandle, 0, mUniforms.getSize());
+    // set the UBO, always descriptor 0, our slice is selected by the dynamic offset
+    mDescriptorSet.setBuffer(0, mUbSlice.boh, 0, mUniforms.getSize());
 
     const RasterState& rasterState = material->getRasterState();
     // At the moment, only MaterialInstances have a stencil state, but in the future it should be
@@ -172,13 +174,15 @@ FMaterialInstance::FMaterialInstance(FEngine& engine, FMaterial const* material,
     }
 
     setTransparencyMode(material->getTransparencyMode());
+
+    // the uniforms and descriptor set have never been committed
+    markDirty();
 }
 
 FMaterialInstance::FMaterialInstance(FEngine& engine,
         FMaterialInstance const* other, const char* name)
         : mMaterial(other->mMaterial),
           mTextureParameters(other->mTextureParameters),
-          mDescriptorSet(other->mDescriptorSet.duplicate(mMaterial->getDescriptorSetLayout())),
           mPolygonOffset(other->mPolygonOffset),
           mStencilState(other->mStencilState),
           mMaskThreshold(other->mMaskThreshold),
@@ -195,41 +199,98 @@ FMaterialInstance::FMaterialInstance(FEngine& engine,
           mScissorRect(other->mScissorRect),
           mName(name ? CString(name) : other->mName) {
 
-    FEngine::DriverApi& driver = engine.getDriverApi();
     FMaterial const* const material = other->getMaterial();
 
+    // The uniforms (including the ones backing the double-sided, mask threshold and specular
+    // anti-aliasing state copied above) are taken as-is from `other`.
     if (!material->getUniformInterfaceBlock().isEmpty()) {
+        mUniforms = UniformBuffer(material->getInstanceUniformStorage(this),
+                material->getUniformInterfaceBlock().getSize());
         mUniforms.setUniforms(other->getUniformBuffer());
-        mUbHandle = driver.createBufferObject(mUniforms.getSize(),
-                BufferObjectBinding::UNIFORM, BufferUsage::DYNAMIC);
-        driver.setDebugTag(mUbHandle.getId(), material->getName());
+        // they're already on the GPU, in the shared state
+        mUniforms.clean();
     }
 
-    // set the UBO, always descriptor 0
-    mDescriptorSet.setBuffer(0, mUbHandle, 0, mUniforms.getSize());
+    setTransparencyMode(material->getTransparencyMode());
 
-    if (material->hasDoubleSidedCapability()) {
-        setDoubleSided(mIsDoubleSided);
-    }
+    mMaterialSortingKey = RenderPass::makeMaterialSortingKey(
+            material->getId(), material->generateMaterialInstanceId());
 
-    if (material->getBlendingMode() == BlendingMode::MASKED) {
-        setMaskThreshold(mMaskThreshold);
-    }
+    // Copy-on-write: until it's first modified, this instance uses the same uniform buffer slice
+    // and descriptor set as `other` (and all its other unmodified duplicates).
+    mSharedState = other->acquireSharedState(engine);
+    mUsesSharedState = true;
 
-    if (material->hasSpecularAntiAliasing()) {
-        setSpecularAntiAliasingThreshold(mSpecularAntiAliasingThreshold);
-        setSpecularAntiAliasingVariance(mSpecularAntiAliasingVariance);
-    }
+    markDirty();
+}
 
-    setTransparencyMode(material->getTransparencyMode());
+FMaterialInstance::SharedState::SharedState(FEngine& engine, DescriptorSet descriptorSet) noexcept
+        : engine(engine), descriptorSet(std::move(descriptorSet)) {
+}
 
-    mMaterialSortingKey = RenderPass::makeMaterialSortingKey(
-            material->getId(), material->generateMaterialInstanceId());
+FMaterialInstance::SharedState::~SharedState() noexcept {
+    DriverApi& driver = engine.getDriverApi();
+    engine.getMaterialUniformPool().free(driver, ubSlice);
+    descriptorSet.terminate(driver);
+}
 
-    // If the original descriptor set has been commited, the copy needs to commit as well.
-    if (other->mDescriptorSet.getHandle()) {
-        mDescriptorSet.commitSlow(mMaterial->getDescriptorSetLayout(), driver);
+std::shared_ptr<FMaterialInstance::SharedState> const& FMaterialInstance::acquireSharedState(
+        FEngine& engine) const {
+    if (!mSharedState) {
+        // Snapshot our current uniforms and descriptors, we keep a reference so that further
+        // duplicates share the same snapshot until we're modified.
+        DriverApi& driver = engine.getDriverApi();
+        DescriptorSetLayout const& layout = mMaterial->getDescriptorSetLayout();
+        auto state = std::make_shared<SharedState>(engine, mDescriptorSet.duplicate(layout));
+        state->owner = this;
+        size_t const size = mUniforms.getSize();
+        if (size) {
+            state->ubSlice = engine.getMaterialUniformPool().allocate(driver, size);
+            void* const staging = driver.allocate(size);
+            memcpy(staging, mUniforms.getBuffer(), size);
+            driver.updateBufferObject(state->ubSlice.boh, { staging, size }, state->ubSlice.offset);
+        }
+        state->descriptorSet.setBuffer(0, state->ubSlice.boh, 0, size);
+        state->descriptorSet.commitSlow(layout, driver);
+        mSharedState = std::move(state);
     }
+    return mSharedState;
+}
+
+void FMaterialInstance::releaseSharedState() const noexcept {
+    assert_invariant(mSharedState);
+    std::shared_ptr<SharedState> const state = std::move(mSharedState);
+    if (mUsesSharedState) {
+        mUsesSharedState = false;
+        // If only the instance the snapshot was taken from is left, it has no use for it until
+        // it's duplicated again, which takes a new snapshot.
+        if (state->owner && state.use_count() == 2) {
+            state->owner->mSharedState.reset();
+        }
+    } else {
+        state->owner = nullptr;
+    }
+}
+
+void FMaterialInstance::detachSharedState() {
+    FEngine& engine = mMaterial->getEngine();
+    if (mUsesSharedState) {
+        // first modification since we were duplicated, make our own copy
+        DriverApi& driver = engine.getDriverApi();
+        DescriptorSetLayout const& layout = mMaterial->getDescriptorSetLayout();
+        size_t const size = mUniforms.getSize();
+        if (size) {
+            mUbSlice = engine.getMaterialUniformPool().allocate(driver, size);
+            mUniforms.invalidate();
+        }
+        mDescriptorSet = mSharedState->descriptorSet.duplicate(layout);
+        mDescriptorSet.setBuffer(0, mUbSlice.boh, 0, size);
+        mDescriptorSet.commitSlow(layout, driver);
+        markDirty();
+    }
+    // otherwise, we're the instance the shared state was taken from, it stays valid for the
+    // duplicates still using it
+    releaseSharedState();
 }
 
 FMaterialInstance* FMaterialInstance::duplicate(
@@ -243,8 +304,16 @@ FMaterialInstance::~FMaterialInstance() noexcept = default;
 
 void FMaterialInstance::terminate(FEngine& engine) {
     FEngine::DriverApi& driver = engine.getDriverApi();
+    if (mCommitPending) {
+        engine.removeDirtyMaterialInstance(this);
+        mCommitPending = false;
+    }
+    if (mSharedState) {
+        releaseSharedState();
+    }
     mDescriptorSet.terminate(driver);
-    driver.destroyBufferObject(mUbHandle);
+    engine.getMaterialUniformPool().free(driver, mUbSlice);
+    mUbSlice = {};
 }
 
 void FMaterialInstance::commitStreamUniformAssociations(FEngine::DriverApi& driver) {
@@ -254,32 +323,74 @@ void FMaterialInstance::commitStreamUniformAssociations(FEngine::DriverApi& driv
         for (auto const& [binding, p]: mTextureParameters) {
             ssize_t offset = mMaterial->getUniformInterfaceBlock().getTransformFieldOffset(binding);
             if (offset >= 0) {
+                // the driver patches the stream transforms in our own uniform buffer
+                if (UTILS_UNLIKELY(mUsesSharedState)) {
+                    detachSharedState();
+                }
                 mHasStreamUniformAssociations = true;
 //                 auto stream = p.texture->getStream()->getHandle();
-//                 descriptor.mStreams.push_back({uint32_t(offset), stream, BufferObjectStreamAssociationType::TRANSFORM_MATRIX});
+//                 descriptor.mStreams.push_back({uint32_t(mUbSlice.offset + offset), stream, BufferObjectStreamAssociationType::TRANSFORM_MATRIX});
             }
         }
         if (descriptor.mStreams.size() > 0) {
-            driver.registerBufferObjectStreams(mUbHandle, std::move(descriptor));
+            driver.registerBufferObjectStreams(mUbSlice.boh, std::move(descriptor));
         }
     }
 }
 
+void FMaterialInstance::enqueueCommit() const noexcept {
+    assert_invariant(!mCommitPending);
+    mCommitPending = true;
+    mMaterial->getEngine().addDirtyMaterialInstance(this);
+}
+
+size_t FMaterialInstance::getCommitSize() const noexcept {
+    if (mUsesSharedState) {
+        // the shared uniforms are immutable
+        return 0;
+    }
+    if (UTILS_UNLIKELY(mHasStreamUniformAssociations)) {
+        // the stream transforms are patched by the driver on each update, upload everything
+        return mUniforms.getSize();
+    }
+    // otherwise, only upload the range that changed, typically a few animated parameters
+    return mUniforms.isDirty() ? mUniforms.getDirtySize() : 0;
+}
+
 void FMaterialInstance::commit(DriverApi& driver) const {
+    // we stay in the engine's dirty list, there will just be nothing left to do there
+    size_t const size = getCommitSize();
+    commitImpl(driver, size ? driver.allocate(size) : nullptr);
+}
+
+void FMaterialInstance::commit(DriverApi& driver, void* staging) const {
+    assert_invariant(mCommitPending);
+    mCommitPending = false;
+    commitImpl(driver, staging);
+}
+
+void FMaterialInstance::commitImpl(DriverApi& driver, void* staging) const {
     // update uniforms if needed
-    if (mUniforms.isDirty() || mHasStreamUniformAssociations) {
-        driver.updateBufferObject(mUbHandle, mUniforms.toBufferDescriptor(driver), 0);
+    size_t const size = getCommitSize();
+    if (size) {
+        size_t const offset = mHasStreamUniformAssociations ? 0 : mUniforms.getDirtyOffset();
+        memcpy(staging, static_cast<char const*>(mUniforms.getBuffer()) + offset, size);
+        mUniforms.clean();
+        // staging is owned by the command stream, no callback needed
+        driver.updateBufferObject(mUbSlice.boh, { staging, size }, mUbSlice.offset + uint32_t(offset));
     }
+    // When shared, every user of the descriptor set has the same texture parameters (any change
+    // would have detached it), so it's fine to update the shared set from here.
+    DescriptorSet& descriptorSet = getDescriptorSet();
     if (!mTextureParameters.empty()) {
+        FEngine const& engine = mMaterial->getEngine();
         for (auto const& [binding, p]: mTextureParameters) {
             assert_invariant(p.texture);
-            // TODO: figure out a way to do this more efficiently (isValid() is a hashmap lookup)
-            FEngine const& engine = mMaterial->getEngine();
-            FILAMENT_CHECK_PRECONDITION(engine.isValid(p.texture))
+            FILAMENT_CHECK_PRECONDITION(engine.isValid(p.texture, p.ref))
                     << "Invalid texture still bound to MaterialInstance: '" << getName() << "'\n";
             Handle<HwTexture> const handle = p.texture->getHwHandleForSampling();
             assert_invariant(handle);
-            mDescriptorSet.setSampler(binding, handle, p.params);
+            descriptorSet.setSampler(binding, handle, p.params);
         }
     }
 
@@ -287,7 +398,7 @@ void FMaterialInstance::commit(DriverApi& driver) const {
     fixMissingSamplers();
 
     // Commit descriptors if needed (e.g. when textures are updated,or the first time)
-    mDescriptorSet.commit(mMaterial->getDescriptorSetLayout(), driver);
+    descriptorSet.commit(mMaterial->getDescriptorSetLayout(), driver);
 }
 
 // ------------------------------------------------------------------------------------------------
@@ -295,11 +406,28 @@ void FMaterialInstance::commit(DriverApi& driver) const {
 void FMaterialInstance::setParameter(std::string_view const name,
         Handle<HwTexture> texture, SamplerParams const params) {
     auto const binding = mMaterial->getSamplerBinding(name);
+    if (UTILS_UNLIKELY(mSharedState)) {
+        detachSharedState();
+    }
     mDescriptorSet.setSampler(binding, texture, params);
+    markDirty();
 }
 
 void FMaterialInstance::setParameterImpl(std::string_view const name,
         FTexture const* texture, TextureSampler const& sampler) {
+    setTextureParameter(mMaterial->getSamplerBinding(name), texture, sampler, name);
+}
+
+void FMaterialInstance::setParameterImpl(ParameterHandle const handle,
+        FTexture const* texture, TextureSampler const& sampler) {
+    FILAMENT_CHECK_PRECONDITION(handle.mMaterial == mMaterial && handle.isSampler())
+            << "Invalid sampler parameter handle for MaterialInstance: '" << getName() << "'";
+    setTextureParameter(descriptor_binding_t(handle.mOffset), texture, sampler, {});
+}
+
+void FMaterialInstance::setTextureParameter(descriptor_binding_t const binding,
+        FTexture const* texture, TextureSampler const& sampler,
+        UTILS_UNUSED_IN_RELEASE std::string_view const name) {
 
 #ifndef NDEBUG
     // Per GLES3.x specification, depth texture can't be filtered unless in compare mode.
@@ -314,16 +442,21 @@ void FMaterialInstance::setParameterImpl(std::string_view const name,
                 minFilter == SamplerMinFilter::NEAREST_MIPMAP_LINEAR) {
                 PANIC_LOG("Depth textures can't be sampled with a linear filter "
                           "unless the comparison mode is set to COMPARE_TO_TEXTURE. "
-                          "(material: \"%s\", parameter: \"%.*s\")",
-                        getMaterial()->getName().c_str(), name.size(), name.data());
+                          "(material: \"%s\", parameter: \"%.*s\", binding: %u)",
+                        getMaterial()->getName().c_str(), name.size(), name.data(),
+                        unsigned(binding));
             }
         }
     }
 #endif
 
-    auto const binding = mMaterial->getSamplerBinding(name);
+    if (UTILS_UNLIKELY(mSharedState)) {
+        detachSharedState();
+    }
+
     if (texture && texture->textureHandleCanMutate()) {
-        mTextureParameters[binding] = { texture, sampler.getSamplerParams() };
+        FEngine const& engine = mMaterial->getEngine();
+        mTextureParameters[binding] = { texture, engine.getRef(texture), sampler.getSamplerParams() };
     } else {
         // Ensure to erase the binding from mTextureParameters since it will not
         // be updated.
@@ -336,6 +469,15 @@ void FMaterialInstance::setParameterImpl(std::string_view const name,
         }
         mDescriptorSet.setSampler(binding, handle, sampler.getSamplerParams());
     }
+    markDirty();
+}
+
+void FMaterialInstance::checkParameterHandle(ParameterHandle const& handle,
+        UniformType const type, size_t const count) const {
+    FILAMENT_CHECK_PRECONDITION(handle.mMaterial == mMaterial &&
+            handle.mKind == ParameterHandle::Kind::UNIFORM &&
+            handle.mType == type && count <= handle.mCount)
+            << "Invalid uniform parameter handle for MaterialInstance: '" << getName() << "'";
 }
 
 void FMaterialInstance::setMaskThreshold(float const threshold) noexcept {
@@ -427,7 +569,8 @@ void FMaterialInstance::use(FEngine::DriverApi& driver) const {
         mMissingSamplerDescriptors.clear();
     }
 
-    mDescriptorSet.bind(driver, DescriptorSetBindingPoints::PER_MATERIAL);
+    getDescriptorSet().bind(driver, DescriptorSetBindingPoints::PER_MATERIAL,
+            getUbSlice().offset);
 }
 
 void FMaterialInstance::fixMissingSamplers() const {
@@ -437,7 +580,8 @@ void FMaterialInstance::fixMissingSamplers() const {
     // texture.
     auto const& layout = mMaterial->getDescriptorSetLayout();
     auto const samplersDescriptors = layout.getSamplerDescriptors();
-    auto const validDescriptors = mDescriptorSet.getValidDescriptors();
+    DescriptorSet& descriptorSet = getDescriptorSet();
+    auto const validDescriptors = descriptorSet.getValidDescriptors();
     auto const missingSamplerDescriptors =
             (validDescriptors & samplersDescriptors) ^ samplersDescriptors;
 
@@ -447,7 +591,7 @@ void FMaterialInstance::fixMissingSamplers() const {
     if (UTILS_UNLIKELY(missingSamplerDescriptors.any())) {
         // here we need to set the samplers that are missing
         auto const& list = mMaterial->getSamplerInterfaceBlock().getSamplerInfoList();
-        missingSamplerDescriptors.forEachSetBit([this, &list](descriptor_binding_t binding) {
+        missingSamplerDescriptors.forEachSetBit([this, &list, &descriptorSet](descriptor_binding_t binding) {
             auto const pos = std::find_if(list.begin(), list.end(), [binding](const auto& item) {
                 return item.binding == binding;
             });
@@ -458,15 +602,15 @@ void FMaterialInstance::fixMissingSamplers() const {
             if (UTILS_LIKELY(pos != list.end())) {
                 switch (pos->type) {
                     case SamplerType::SAMPLER_2D:
-                        mDescriptorSet.setSampler(binding,
+                        descriptorSet.setSampler(binding,
                                 engine.getZeroTexture(), {});
                         break;
                     case SamplerType::SAMPLER_2D_ARRAY:
-                        mDescriptorSet.setSampler(binding,
+                        descriptorSet.setSampler(binding,
                                 engine.getZeroTextureArray(), {});
                         break;
                     case SamplerType::SAMPLER_CUBEMAP:
-                        mDescriptorSet.setSampler(binding,
+                        descriptorSet.setSampler(binding,
                                 engine.getDummyCubemap()->getHwHandle(), {});
                         break;
                     case SamplerType::SAMPLER_EXTERNAL:
@@ -20,6 +20,7 @@
 #include "downcast.h"
 
 #include "UniformBuffer.h"
+#include "UniformBufferPool.h"
 
 #include "ds/DescriptorSet.h"
 
@@ -40,6 +41,7 @@
 
 #include <algorithm>
 #include <limits>
+#include <memory>
 #include <mutex>
 #include <string_view>
 
@@ -69,6 +71,21 @@ public:
     
     void commit(FEngine::DriverApi& driver) const;
 
+    // Same as above, but the uniforms are copied into `staging`, which must be at least
+    // getCommitSize() bytes and live in the command stream. Only called by
+    // FEngine::commitMaterialInstances(), which owns the list of dirty instances.
+    void commit(FEngine::DriverApi& driver, void* staging) const;
+
+    // number of bytes of uniforms the next commit() will upload
+    size_t getCommitSize() const noexcept;
+
+    // records that this instance needs to be committed, see FEngine::commitMaterialInstances()
+    void markDirty() const noexcept {
+        if (UTILS_UNLIKELY(!mCommitPending)) {
+            enqueueCommit();
+        }
+    }
+
     void use(FEngine::DriverApi& driver) const;
 
     FMaterial const* getMaterial() const noexcept { return mMaterial; }
@@ -262,19 +279,90 @@ private:
     template<typename T>
     T getParameterImpl(std::string_view name) const;
 
+    template<size_t Size>
+    void setParameterUntypedImpl(ParameterHandle handle, const void* value,
+            backend::UniformType type);
+
+    template<size_t Size>
+    void setParameterUntypedImpl(ParameterHandle handle, const void* value, size_t count,
+            backend::UniformType type);
+
+    template<typename T>
+    void setParameterImpl(ParameterHandle handle, T const& value);
+
+    template<typename T>
+    void setParameterImpl(ParameterHandle handle, const T* value, size_t count);
+
+    void setParameterImpl(ParameterHandle handle,
+            FTexture const* texture, TextureSampler const& sampler);
+
+    void setTextureParameter(backend::descriptor_binding_t binding,
+            FTexture const* texture, TextureSampler const& sampler, std::string_view name);
+
+    void enqueueCommit() const noexcept;
+
+    // Immutable uniforms and descriptors shared by an instance and its copy-on-write duplicates,
+    // freed with the last reference.
+    struct SharedState {
+        SharedState(FEngine& engine, DescriptorSet descriptorSet) noexcept;
+        ~SharedState() noexcept;
+        SharedState(SharedState const&) = delete;
+        SharedState& operator=(SharedState const&) = delete;
+
+        FEngine& engine;
+        UniformBufferPool::Slice ubSlice;
+        DescriptorSet descriptorSet;
+        // the instance the snapshot was taken from, while it holds a reference
+        FMaterialInstance const* owner = nullptr;
+    };
+
+    std::shared_ptr<SharedState> const& acquireSharedState(FEngine& engine) const;
+    void releaseSharedState() const noexcept;
+
+    // must be called when the uniforms are modified, and before the descriptors are
+    void detachSharedState();
+
+    void markUniformsDirty() {
+        if (UTILS_UNLIKELY(mSharedState)) {
+            detachSharedState();
+        }
+        markDirty();
+    }
+
+    DescriptorSet& getDescriptorSet() const noexcept {
+        return mUsesSharedState ? mSharedState->descriptorSet : mDescriptorSet;
+    }
+
+    UniformBufferPool::Slice const& getUbSlice() const noexcept {
+        return mUsesSharedState ? mSharedState->ubSlice : mUbSlice;
+    }
+
+    void commitImpl(FEngine::DriverApi& driver, void* staging) const;
+
+    // checks that the handle is a uniform of the given type and size of our material
+    void checkParameterHandle(ParameterHandle const& handle, backend::UniformType type,
+            size_t count) const;
+
     // keep these grouped, they're accessed together in the render-loop
     FMaterial const* mMaterial = nullptr;
 
     struct TextureParameter {
         FTexture const* texture;
+        HandleArenaBase::Ref ref;   // detects the texture being destroyed, see FEngine::isValid()
         backend::SamplerParams params;
     };
 
-    backend::Handle<backend::HwBufferObject> mUbHandle;
+    UniformBufferPool::Slice mUbSlice;      // where our uniforms live on the GPU
     tsl::robin_map<backend::descriptor_binding_t, TextureParameter> mTextureParameters;
     mutable DescriptorSet mDescriptorSet;
     UniformBuffer mUniforms;
     bool mHasStreamUniformAssociations = false;
+    mutable bool mCommitPending = false;    // we're in FEngine's list of dirty instances
+    // non-null if we've been duplicated, not modified since and a duplicate still uses it, or if
+    // we're an unmodified duplicate, in which case mUsesSharedState is set and mSharedState replaces mUbSlice and
+    // mDescriptorSet.
+    mutable std::shared_ptr<SharedState> mSharedState;
+    mutable bool mUsesSharedState = false;
 
     backend::PolygonOffset mPolygonOffset{};
     backend::StencilState mStencilState{};
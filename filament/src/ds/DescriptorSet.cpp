@@ -16,6 +16,7 @@
 
 #include "DescriptorSet.h"
 
+#include "DescriptorSetCache.h"
 #include "DescriptorSetLayout.h"
 
 #include "details/Engine.h"
@@ -60,30 +61,78 @@ DescriptorSet& DescriptorSet::operator=(DescriptorSet&& rhs) noexcept {
         mDirty = rhs.mDirty;
         mValid = rhs.mValid;
         mSetAfterCommitWarning = rhs.mSetAfterCommitWarning;
+        mBoundSinceCommit = rhs.mBoundSinceCommit;
+        mDescriptorSetCache = rhs.mDescriptorSetCache;
     }
     return *this;
 }
 
 void DescriptorSet::terminate(FEngine::DriverApi& driver) noexcept {
     if (mDescriptorSetHandle) {
-        driver.destroyDescriptorSet(mDescriptorSetHandle);
+        mDescriptorSetCache->release(driver, mDescriptorSetHandle);
         mDescriptorSetHandle.clear();
     }
 }
 
+DescriptorSetCache::Key DescriptorSet::makeKey(DescriptorSetLayout const& layout) const noexcept {
+    // no allocation, the key has room for all the descriptors of a set
+    DescriptorSetCache::Key key;
+    key.push(layout.getHandle().getId());
+    key.push(uint32_t(mValid.getValue()));
+    key.push(uint32_t(mValid.getValue() >> 32u));
+    mValid.forEachSetBit([&layout, &key, descriptors = mDescriptors.data()]
+            (backend::descriptor_binding_t const binding) {
+        // only the members that are written to the backend, the handle id first
+        if (layout.isSampler(binding)) {
+            key.push(descriptors[binding].texture.th.getId());
+            key.push(backend::SamplerParams::Hasher{}(descriptors[binding].texture.params));
+            key.push(0);
+        } else {
+            key.push(descriptors[binding].buffer.boh.getId());
+            key.push(descriptors[binding].buffer.offset);
+            key.push(descriptors[binding].buffer.size);
+        }
+    });
+    static_assert(DescriptorSetCache::Key::DESCRIPTOR_WORDS == 3);
+    key.computeHash();
+    return key;
+}
+
 void DescriptorSet::commitSlow(DescriptorSetLayout const& layout,
         FEngine::DriverApi& driver) noexcept {
-    mDirty.clear();
-    // if we have a dirty descriptor set,
-    // we need to allocate a new one and reset all the descriptors
-    if (UTILS_LIKELY(mDescriptorSetHandle)) {
-        // note: if the descriptor-set is bound, doing this will essentially make it dangling.
-        // This can result in a use-after-free in the driver if the new one isn't bound at some
-        // point later.
-        driver.destroyDescriptorSet(mDescriptorSetHandle);
+    // Layouts get their cache from the HwDescriptorSetLayoutFactory, which also creates their
+    // handle. Every bind goes through the cache, so that it knows what's bound.
+    DescriptorSetCache* const cache = layout.getDescriptorSetCache();
+    assert_invariant(cache);
+    assert_invariant(!mDescriptorSetCache || mDescriptorSetCache == cache);
+
+    // By default, we need a new descriptor set and to reset all the descriptors.
+    utils::bitset64 updated = mValid;
+    DescriptorSetCache::Key key = makeKey(layout);
+    if (mDescriptorSetHandle && !mBoundSinceCommit &&
+            cache->rekey(mDescriptorSetHandle, key)) {
+        // We're the only user of the descriptor set and the GPU has never seen the current
+        // descriptors, so it's safe to update only the dirty ones in place. Dirty
+        // descriptors that became invalid are left as-is, they can't be used.
+        updated = mDirty & mValid;
+    } else {
+        // Share a descriptor set with identical contents if there is one. The current one
+        // may be used by a frame in flight, so it can't be modified.
+        bool created;
+        backend::DescriptorSetHandle const dsh =
+                cache->acquire(driver, layout.getHandle(), std::move(key), created);
+        if (mDescriptorSetHandle) {
+            cache->release(driver, mDescriptorSetHandle);
+        }
+        mDescriptorSetHandle = dsh;
+        if (!created) {
+            updated.clear();
+        }
     }
-    mDescriptorSetHandle = driver.createDescriptorSet(layout.getHandle());
-    mValid.forEachSetBit([&layout, &driver,
+    mDescriptorSetCache = cache;
+    mDirty.clear();
+    mBoundSinceCommit = false;
+    updated.forEachSetBit([&layout, &driver,
             dsh = mDescriptorSetHandle, descriptors = mDescriptors.data()]
             (backend::descriptor_binding_t const binding) {
         if (layout.isSampler(binding)) {
@@ -99,15 +148,8 @@ void DescriptorSet::commitSlow(DescriptorSetLayout const& layout,
     });
 }
 
-void DescriptorSet::bind(FEngine::DriverApi& driver, DescriptorSetBindingPoints const set) const noexcept {
-    bind(driver, set, {});
-}
-
-void DescriptorSet::bind(FEngine::DriverApi& driver, DescriptorSetBindingPoints const set,
-        backend::DescriptorSetOffsetArray dynamicOffsets) const noexcept {
-    // TODO: on debug check that dynamicOffsets is large enough
-
-    assert_invariant(mDescriptorSetHandle);
+void DescriptorSet::checkCommitted() const noexcept {
+    assert_invariant(mDescriptorSetHandle && mDescriptorSetCache);
 
     // TODO: Make sure clients do the right thing and not change material instance parameters
     // within the renderpass. We have to comment the assert out since it crashed a client's debug
@@ -121,6 +163,35 @@ void DescriptorSet::bind(FEngine::DriverApi& driver, DescriptorSetBindingPoints
         });
         mSetAfterCommitWarning = true;
     }
+}
+
+void DescriptorSet::bind(FEngine::DriverApi& driver, DescriptorSetBindingPoints const set) const noexcept {
+    checkCommitted();
+    mBoundSinceCommit = true;
+    if (!mDescriptorSetCache->needsBind(+set, mDescriptorSetHandle,
+            DescriptorSetCache::NO_DYNAMIC_OFFSET)) {
+        return;
+    }
+    driver.bindDescriptorSet(mDescriptorSetHandle, +set, {});
+}
+
+void DescriptorSet::bind(FEngine::DriverApi& driver, DescriptorSetBindingPoints const set,
+        uint32_t const dynamicOffset) const noexcept {
+    checkCommitted();
+    mBoundSinceCommit = true;
+    if (!mDescriptorSetCache->needsBind(+set, mDescriptorSetHandle, dynamicOffset)) {
+        return;
+    }
+    driver.bindDescriptorSet(mDescriptorSetHandle, +set, { { dynamicOffset }, driver });
+}
+
+void DescriptorSet::bind(FEngine::DriverApi& driver, DescriptorSetBindingPoints const set,
+        backend::DescriptorSetOffsetArray dynamicOffsets) const noexcept {
+    // TODO: on debug check that dynamicOffsets is large enough
+    checkCommitted();
+    mBoundSinceCommit = true;
+    // we can't compare the offsets
+    mDescriptorSetCache->invalidateBinding(+set);
     driver.bindDescriptorSet(mDescriptorSetHandle, +set, std::move(dynamicOffsets));
 }
 
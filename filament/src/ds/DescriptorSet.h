@@ -17,6 +17,7 @@
 #ifndef TNT_FILAMENT_DETAILS_DESCRIPTORSET_H
 #define TNT_FILAMENT_DETAILS_DESCRIPTORSET_H
 
+#include "DescriptorSetCache.h"
 #include "DescriptorSetLayout.h"
 
 #include <private/filament/EngineEnums.h>
@@ -46,7 +47,9 @@ public:
 
     void terminate(backend::DriverApi& driver) noexcept;
 
-    // update the descriptors if needed
+    // Update the descriptors if needed. A descriptor set that hasn't been bound since it was
+    // last committed, and isn't shared, is updated in place. Otherwise it is replaced by a set
+    // with identical contents from the cache, or by a new one from the layout's pool.
     void commit(DescriptorSetLayout const& layout, backend::DriverApi& driver) noexcept {
         if (UTILS_UNLIKELY(mDirty.any())) {
             commitSlow(layout, driver);
@@ -55,9 +58,13 @@ public:
 
     void commitSlow(DescriptorSetLayout const& layout, backend::DriverApi& driver) noexcept;
 
-    // bind the descriptor set
+    // bind the descriptor set, this is skipped if it's already bound
     void bind(backend::DriverApi& driver, DescriptorSetBindingPoints set) const noexcept;
 
+    // same as above, for a descriptor set with a single dynamic offset
+    void bind(backend::DriverApi& driver, DescriptorSetBindingPoints set,
+            uint32_t dynamicOffset) const noexcept;
+
     void bind(backend::DriverApi& driver, DescriptorSetBindingPoints set,
             backend::DescriptorSetOffsetArray dynamicOffsets) const noexcept;
 
@@ -83,6 +90,10 @@ public:
     }
 
 private:
+    DescriptorSetCache::Key makeKey(DescriptorSetLayout const& layout) const noexcept;
+
+    void checkCommitted() const noexcept;
+
     struct Desc {
         Desc() noexcept { }
         union {
@@ -102,8 +113,10 @@ private:
     utils::FixedCapacityVector<Desc> mDescriptors;          // 16
     mutable utils::bitset64 mDirty;                         //  8
     mutable utils::bitset64 mValid;                         //  8
+    DescriptorSetCache* mDescriptorSetCache = nullptr;      //  8
     backend::DescriptorSetHandle mDescriptorSetHandle;      //  4
     mutable bool mSetAfterCommitWarning = false;            //  1
+    mutable bool mBoundSinceCommit = false;                 //  1
 };
 
 } // namespace filament
@@ -0,0 +1,168 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "DescriptorSetCache.h"
+
+#include "DescriptorSetPool.h"
+
+#include <private/backend/DriverApi.h>
+
+#include <backend/Handle.h>
+
+#include <utils/compiler.h>
+#include <utils/debug.h>
+#include <utils/Hash.h>
+#include <utils/Log.h>
+#include <utils/ostream.h>
+
+#include <utility>
+
+#include <stdint.h>
+
+namespace filament {
+
+using namespace utils;
+using namespace backend;
+
+DescriptorSetCache::DescriptorSetCache(DescriptorSetPool& pool) noexcept
+        : mPool(pool) {
+}
+
+DescriptorSetCache::~DescriptorSetCache() noexcept = default;
+
+void DescriptorSetCache::terminate() noexcept {
+    if (UTILS_UNLIKELY(!mEntries.empty())) {
+        slog.w << "DescriptorSetCache: " << mEntries.size()
+               << " descriptor sets still referenced at terminate()" << io::endl;
+    }
+    mEntries.clear();
+    mKeys.clear();
+    mStats.sets = 0;
+    invalidateBindings();
+}
+
+void DescriptorSetCache::Key::computeHash() noexcept {
+    hash = hash::murmurSlow(
+            reinterpret_cast<uint8_t const*>(words.data()), size * sizeof(uint32_t), 0);
+}
+
+DescriptorSetHandle DescriptorSetCache::acquire(DriverApi& driver,
+        DescriptorSetLayoutHandle const dslh, Key&& key, bool& created) noexcept {
+    mStats.lookups++;
+    auto pos = mEntries.find(key);
+    if (pos != mEntries.end()) {
+        Entry& entry = pos->second;
+        entry.refs++;
+        entry.shared = true;
+        mStats.hits++;
+        created = false;
+        return entry.dsh;
+    }
+
+    DescriptorSetHandle const dsh = mPool.acquire(driver, dslh);
+    // the pool recycles descriptor sets, and the backend reuses the ids of destroyed ones
+    forgetBinding(dsh);
+    pos = mEntries.emplace(std::move(key), Entry{ dslh, dsh, 1, false }).first;
+    mKeys[dsh.getId()] = &pos->first;
+    mStats.sets++;
+    created = true;
+    return dsh;
+}
+
+void DescriptorSetCache::release(DriverApi& driver, DescriptorSetHandle const dsh) noexcept {
+    auto const key = mKeys.find(dsh.getId());
+    if (UTILS_UNLIKELY(key == mKeys.end())) {
+        // the set was purged or evicted while it was still alive
+        forgetBinding(dsh);
+        driver.destroyDescriptorSet(dsh);
+        return;
+    }
+    auto const pos = mEntries.find(*key->second);
+    assert_invariant(pos != mEntries.end());
+    Entry& entry = pos->second;
+    if (--entry.refs == 0) {
+        // the set may still be used by a frame in flight
+        mPool.retire(entry.layout, entry.dsh);
+        mKeys.erase(key);
+        mEntries.erase(pos);
+        mStats.sets--;
+    }
+}
+
+bool DescriptorSetCache::rekey(DescriptorSetHandle const dsh, Key& key) noexcept {
+    auto const k = mKeys.find(dsh.getId());
+    if (UTILS_UNLIKELY(k == mKeys.end())) {
+        return false;
+    }
+    auto const pos = mEntries.find(*k->second);
+    assert_invariant(pos != mEntries.end());
+    if (pos->second.shared) {
+        // another DescriptorSet could have bound it
+        return false;
+    }
+    if (pos->first == key) {
+        return true;
+    }
+    if (mEntries.find(key) != mEntries.end()) {
+        return false;
+    }
+    // the node (and therefore the address of its key) doesn't change
+    auto node = mEntries.extract(pos);
+    node.key() = std::move(key);
+    mEntries.insert(std::move(node));
+    return true;
+}
+
+template<typename Predicate>
+void DescriptorSetCache::forgetEntries(Predicate&& predicate) noexcept {
+    for (auto pos = mEntries.begin(); pos != mEntries.end();) {
+        if (predicate(pos->first, pos->second)) {
+            // still referenced, these sets are destroyed when released
+            mKeys.erase(pos->second.dsh.getId());
+            pos = mEntries.erase(pos);
+            mStats.sets--;
+        } else {
+            ++pos;
+        }
+    }
+}
+
+void DescriptorSetCache::purge(DescriptorSetLayoutHandle const dslh) noexcept {
+    forgetEntries([dslh](Key const&, Entry const& entry) {
+        return entry.layout == dslh;
+    });
+}
+
+void DescriptorSetCache::evict(HandleBase::HandleId const id) noexcept {
+    forgetEntries([id](Key const& key, Entry const&) {
+        for (size_t i = Key::HEADER_WORDS; i < key.size; i += Key::DESCRIPTOR_WORDS) {
+            if (key.words[i] == id) {
+                return true;
+            }
+        }
+        return false;
+    });
+}
+
+void DescriptorSetCache::forgetBinding(DescriptorSetHandle const dsh) noexcept {
+    for (Binding& binding : mBindings) {
+        if (binding.dsh == dsh) {
+            binding = {};
+        }
+    }
+}
+
+} // namespace filament
@@ -0,0 +1,180 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_FILAMENT_DESCRIPTORSETCACHE_H
+#define TNT_FILAMENT_DESCRIPTORSETCACHE_H
+
+#include <backend/DriverApiForward.h>
+#include <backend/DriverEnums.h>
+#include <backend/Handle.h>
+
+#include <utils/debug.h>
+
+#include <algorithm>
+#include <array>
+#include <unordered_map>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace filament {
+
+class DescriptorSetPool;
+
+/*
+ * Shares backend descriptor sets between DescriptorSets with identical contents.
+ *
+ * Descriptor sets are looked up by their layout and descriptors, and are refcounted. When the
+ * last reference goes away, the set is retired to the DescriptorSetPool.
+ *
+ * The cache also remembers what's bound at each binding point, so that consecutive draws using
+ * the same descriptor set don't bind it again.
+ *
+ * Keys contain handle ids, which the backend reuses as soon as the handle is destroyed. Sets
+ * referencing a buffer object or a texture must be evicted before it's destroyed, see evict().
+ */
+class DescriptorSetCache {
+public:
+    static constexpr uint32_t NO_DYNAMIC_OFFSET = 0xFFFFFFFFu;
+
+    // The layout and the descriptors of a set, as a list of words: the layout's handle id and
+    // the mask of valid descriptors, followed by DESCRIPTOR_WORDS words per valid descriptor, the
+    // first of which is the handle id of its buffer object or texture.
+    // See DescriptorSet::makeKey().
+    struct Key {
+        static constexpr size_t HEADER_WORDS = 3;
+        static constexpr size_t DESCRIPTOR_WORDS = 3;
+        static constexpr size_t CAPACITY =
+                HEADER_WORDS + DESCRIPTOR_WORDS * backend::MAX_DESCRIPTOR_COUNT;
+
+        std::array<uint32_t, CAPACITY> words{}; // only the first `size` are used
+        uint32_t size = 0;
+        size_t hash = 0;
+
+        void push(uint32_t const word) noexcept {
+            assert_invariant(size < CAPACITY);
+            words[size++] = word;
+        }
+
+        // must be called once all the words are pushed
+        void computeHash() noexcept;
+
+        bool operator==(Key const& rhs) const noexcept {
+            return hash == rhs.hash && size == rhs.size &&
+                   std::equal(words.begin(), words.begin() + size, rhs.words.begin());
+        }
+    };
+
+    struct Stats {
+        uint32_t lookups = 0;       // calls to acquire()
+        uint32_t hits = 0;          // calls to acquire() that returned an existing set
+        uint32_t sets = 0;          // live descriptor sets
+        uint32_t bindsSkipped = 0;  // redundant binds filtered out by needsBind()
+    };
+
+    explicit DescriptorSetCache(DescriptorSetPool& pool) noexcept;
+    ~DescriptorSetCache() noexcept;
+
+    DescriptorSetCache(DescriptorSetCache const& rhs) = delete;
+    DescriptorSetCache(DescriptorSetCache&& rhs) noexcept = delete;
+    DescriptorSetCache& operator=(DescriptorSetCache const& rhs) = delete;
+    DescriptorSetCache& operator=(DescriptorSetCache&& rhs) noexcept = delete;
+
+    void terminate() noexcept;
+
+    // Returns a reference to a descriptor set with the given contents. `created` is set if the
+    // descriptor set is new, in which case the caller must write its descriptors.
+    backend::DescriptorSetHandle acquire(backend::DriverApi& driver,
+            backend::DescriptorSetLayoutHandle dslh, Key&& key, bool& created) noexcept;
+
+    // releases a reference acquired with acquire()
+    void release(backend::DriverApi& driver, backend::DescriptorSetHandle dsh) noexcept;
+
+    // Changes the contents of a descriptor set, so that it can be updated in place. This fails
+    // if the set has ever been shared or if a set with these contents already exists. On
+    // success, `key` is moved into the cache.
+    bool rekey(backend::DescriptorSetHandle dsh, Key& key) noexcept;
+
+    // forgets all descriptor sets of this layout, must be called before the layout is destroyed
+    void purge(backend::DescriptorSetLayoutHandle dslh) noexcept;
+
+    // Forgets all descriptor sets referencing this buffer object or texture, must be called
+    // before it's destroyed. The sets still referenced are destroyed when they're released.
+    void evict(backend::HandleBase::HandleId id) noexcept;
+
+    // Returns false if `dsh` is already bound at `set` with the same dynamic offset, otherwise
+    // records it as bound.
+    bool needsBind(backend::descriptor_set_t set, backend::DescriptorSetHandle dsh,
+            uint32_t dynamicOffset) noexcept {
+        Binding& binding = mBindings[set];
+        if (binding.dsh == dsh && binding.dynamicOffset == dynamicOffset) {
+            mStats.bindsSkipped++;
+            return false;
+        }
+        binding = { dsh, dynamicOffset };
+        return true;
+    }
+
+    // what's bound at `set` is unknown
+    void invalidateBinding(backend::descriptor_set_t set) noexcept {
+        mBindings[set] = {};
+    }
+
+    // Must be called whenever the backend's bindings are reset: when a render pass begins, when
+    // a pipeline is bound and at the end of a frame.
+    void invalidateBindings() noexcept {
+        mBindings = {};
+    }
+
+    Stats const& getStats() const noexcept { return mStats; }
+
+private:
+    struct KeyHasher {
+        size_t operator()(Key const& key) const noexcept {
+            return key.hash;
+        }
+    };
+
+    struct Entry {
+        backend::DescriptorSetLayoutHandle layout;
+        backend::DescriptorSetHandle dsh;
+        uint32_t refs;
+        bool shared;    // has had more than one reference at some point
+    };
+
+    struct Binding {
+        backend::DescriptorSetHandle dsh;
+        uint32_t dynamicOffset = NO_DYNAMIC_OFFSET;
+    };
+
+    // the id of `dsh` is about to designate another descriptor set
+    void forgetBinding(backend::DescriptorSetHandle dsh) noexcept;
+
+    // removes the entries matching `predicate`, they may still be referenced, see release()
+    template<typename Predicate>
+    void forgetEntries(Predicate&& predicate) noexcept;
+
+    DescriptorSetPool& mPool;
+    std::unordered_map<Key, Entry, KeyHasher> mEntries;
+    // key of each live descriptor set, the keys live in mEntries
+    std::unordered_map<backend::DescriptorSetHandle::HandleId, Key const*> mKeys;
+    std::array<Binding, backend::MAX_DESCRIPTOR_SET_COUNT> mBindings{};
+    Stats mStats;
+};
+
+} // namespace filament
+
+#endif // TNT_FILAMENT_DESCRIPTORSETCACHE_H
@@ -44,6 +44,8 @@ DescriptorSetLayout::DescriptorSetLayout(
 
     mDescriptorSetLayoutHandle = factory.create(driver,
             std::move(descriptorSetLayout));
+    mDescriptorSetPool = &factory.getDescriptorSetPool();
+    mDescriptorSetCache = &factory.getDescriptorSetCache();
 }
 
 void DescriptorSetLayout::terminate(
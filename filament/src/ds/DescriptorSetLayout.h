@@ -29,6 +29,8 @@
 
 namespace filament {
 
+class DescriptorSetCache;
+class DescriptorSetPool;
 class HwDescriptorSetLayoutFactory;
 
 class DescriptorSetLayout {
@@ -68,8 +70,20 @@ public:
         return mUniformBuffers;
     }
 
+    // pool recycling descriptor sets of this layout, null for a default-constructed layout
+    DescriptorSetPool* getDescriptorSetPool() const noexcept {
+        return mDescriptorSetPool;
+    }
+
+    // cache sharing descriptor sets of this layout, null for a default-constructed layout
+    DescriptorSetCache* getDescriptorSetCache() const noexcept {
+        return mDescriptorSetCache;
+    }
+
 private:
     backend::DescriptorSetLayoutHandle mDescriptorSetLayoutHandle;
+    DescriptorSetPool* mDescriptorSetPool = nullptr;
+    DescriptorSetCache* mDescriptorSetCache = nullptr;
     utils::bitset64 mSamplers;
     utils::bitset64 mUniformBuffers;
     uint8_t mMaxDescriptorBinding = 0;
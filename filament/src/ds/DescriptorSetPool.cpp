@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "DescriptorSetPool.h"
+
+#include <private/backend/DriverApi.h>
+
+#include <backend/Handle.h>
+
+#include <utils/compiler.h>
+#include <utils/debug.h>
+
+#include <algorithm>
+
+#include <stdint.h>
+
+namespace filament {
+
+using namespace backend;
+
+DescriptorSetPool::DescriptorSetPool() noexcept = default;
+
+DescriptorSetPool::~DescriptorSetPool() noexcept = default;
+
+void DescriptorSetPool::terminate(DriverApi& driver) noexcept {
+    for (auto& [layout, sets] : mFreeSets) {
+        for (DescriptorSetHandle const dsh : sets) {
+            driver.destroyDescriptorSet(dsh);
+        }
+    }
+    for (Retired const& retired : mRetired) {
+        driver.destroyDescriptorSet(retired.dsh);
+    }
+    mFreeSets.clear();
+    mRetired.clear();
+    mStats.retired = 0;
+}
+
+DescriptorSetHandle DescriptorSetPool::acquire(DriverApi& driver,
+        DescriptorSetLayoutHandle const dslh) noexcept {
+    auto const pos = mFreeSets.find(dslh.getId());
+    if (pos != mFreeSets.end() && !pos->second.empty()) {
+        DescriptorSetHandle const dsh = pos->second.back();
+        pos->second.pop_back();
+        mStats.recycled++;
+        return dsh;
+    }
+    mStats.created++;
+    return driver.createDescriptorSet(dslh);
+}
+
+void DescriptorSetPool::retire(DescriptorSetLayoutHandle const dslh,
+        DescriptorSetHandle const dsh) noexcept {
+    assert_invariant(dsh);
+    mRetired.push_back({ dslh.getId(), dsh, mFrameId });
+    mStats.retired++;
+}
+
+void DescriptorSetPool::purge(DriverApi& driver, DescriptorSetLayoutHandle const dslh) noexcept {
+    LayoutId const layout = dslh.getId();
+    auto const pos = mFreeSets.find(layout);
+    if (pos != mFreeSets.end()) {
+        for (DescriptorSetHandle const dsh : pos->second) {
+            driver.destroyDescriptorSet(dsh);
+        }
+        mFreeSets.erase(pos);
+    }
+    // Retired sets may still be used by the GPU, but so could the layout, destroying them is
+    // no different from destroying the layout.
+    auto const last = std::remove_if(mRetired.begin(), mRetired.end(),
+            [&driver, layout](Retired const& retired) {
+                if (retired.layout == layout) {
+                    driver.destroyDescriptorSet(retired.dsh);
+                    return true;
+                }
+                return false;
+            });
+    mRetired.erase(last, mRetired.end());
+    mStats.retired = uint32_t(mRetired.size());
+}
+
+void DescriptorSetPool::endFrame() noexcept {
+    mFrameId++;
+    // sets retired during frame N can be reused once frame N + FRAME_LATENCY has started
+    while (!mRetired.empty() && mRetired.front().frame + FRAME_LATENCY <= mFrameId) {
+        Retired const& retired = mRetired.front();
+        mFreeSets[retired.layout].push_back(retired.dsh);
+        mRetired.pop_front();
+        mStats.retired--;
+    }
+}
+
+} // namespace filament
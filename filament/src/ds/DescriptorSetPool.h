@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_FILAMENT_DESCRIPTORSETPOOL_H
+#define TNT_FILAMENT_DESCRIPTORSETPOOL_H
+
+#include <backend/DriverApiForward.h>
+#include <backend/Handle.h>
+
+#include <deque>
+#include <unordered_map>
+#include <vector>
+
+#include <stdint.h>
+
+namespace filament {
+
+/*
+ * Recycles descriptor set handles, per descriptor set layout.
+ *
+ * A descriptor set that may have been used by the GPU can't be modified or reused right away.
+ * Instead of being destroyed, it is retired: it becomes available again to descriptor sets of
+ * the same layout FRAME_LATENCY frames later, when the frame that used it has completed.
+ */
+class DescriptorSetPool {
+public:
+    // maximum number of frames the GPU can be behind the engine
+    static constexpr uint32_t FRAME_LATENCY = 3;
+
+    struct Stats {
+        uint32_t created = 0;   // descriptor sets created by the pool
+        uint32_t recycled = 0;  // descriptor sets handed out again
+        uint32_t retired = 0;   // descriptor sets waiting for their frame to complete
+    };
+
+    DescriptorSetPool() noexcept;
+    ~DescriptorSetPool() noexcept;
+
+    DescriptorSetPool(DescriptorSetPool const& rhs) = delete;
+    DescriptorSetPool(DescriptorSetPool&& rhs) noexcept = delete;
+    DescriptorSetPool& operator=(DescriptorSetPool const& rhs) = delete;
+    DescriptorSetPool& operator=(DescriptorSetPool&& rhs) noexcept = delete;
+
+    // destroys all descriptor sets owned by the pool
+    void terminate(backend::DriverApi& driver) noexcept;
+
+    // returns a descriptor set of the given layout, its descriptors are undefined
+    backend::DescriptorSetHandle acquire(backend::DriverApi& driver,
+            backend::DescriptorSetLayoutHandle dslh) noexcept;
+
+    // gives back a descriptor set that may still be in use by the GPU
+    void retire(backend::DescriptorSetLayoutHandle dslh,
+            backend::DescriptorSetHandle dsh) noexcept;
+
+    // destroys all descriptor sets of this layout, must be called before the layout is destroyed
+    void purge(backend::DriverApi& driver, backend::DescriptorSetLayoutHandle dslh) noexcept;
+
+    // must be called once per frame, after the frame's commands have been submitted
+    void endFrame() noexcept;
+
+    Stats const& getStats() const noexcept { return mStats; }
+
+private:
+    using LayoutId = backend::DescriptorSetLayoutHandle::HandleId;
+
+    struct Retired {
+        LayoutId layout;
+        backend::DescriptorSetHandle dsh;
+        uint64_t frame;
+    };
+
+    // descriptor sets ready to be reused, per layout
+    std::unordered_map<LayoutId, std::vector<backend::DescriptorSetHandle>> mFreeSets;
+    // in retirement order, and therefore frame order
+    std::deque<Retired> mRetired;
+    uint64_t mFrameId = 0;
+    Stats mStats;
+};
+
+} // namespace filament
+
+#endif // TNT_FILAMENT_DESCRIPTORSETPOOL_H
@@ -121,7 +121,6 @@ void ShadowMapDescriptorSet::prepareShadowMapping(Transaction const& transaction
 
 ShadowMapDescriptorSet::Transaction ShadowMapDescriptorSet::open(DriverApi& driver) noexcept {
     Transaction transaction;
-    // TODO: use out-of-line buffer if too large
     transaction.uniforms = (PerViewUib *)driver.allocate(sizeof(PerViewUib), 16);
     assert_invariant(transaction.uniforms);
     return transaction;
@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_TOOLS_BENCHMARKS_BENCHMARK_H
+#define TNT_TOOLS_BENCHMARKS_BENCHMARK_H
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace filament::benchmark {
+
+// Runs `run` `iterations` times and returns the fastest run in seconds, which is the least
+// disturbed by the rest of the system.
+template<typename F>
+double measure(int const iterations, F&& run) {
+    double best = 0.0;
+    for (int i = 0; i < iterations; i++) {
+        auto const start = std::chrono::steady_clock::now();
+        run();
+        std::chrono::duration<double> const elapsed = std::chrono::steady_clock::now() - start;
+        best = i ? std::min(best, elapsed.count()) : elapsed.count();
+    }
+    return best;
+}
+
+// prints "<name> <ns per item> <items per second>"
+inline void report(char const* name, double const seconds, size_t const items) {
+    std::cout << std::left << std::setw(40) << name << std::right << std::fixed
+              << std::setprecision(2) << std::setw(12) << seconds * 1e9 / double(items) << " ns"
+              << std::setprecision(0) << std::setw(16) << double(items) / seconds << " /s"
+              << std::endl;
+}
+
+// parses "[-n iterations]", returns false on an unknown argument
+inline bool parseIterations(int const argc, char** argv, int& iterations) {
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-n") && i + 1 < argc) {
+            iterations = std::max(1, atoi(argv[++i]));
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [-n iterations]" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+// keeps the compiler from optimizing away a computation
+template<typename T>
+inline void doNotOptimize(T const& value) {
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    static volatile T sink;
+    sink = value;
+#endif
+}
+
+} // namespace filament::benchmark
+
+#endif // TNT_TOOLS_BENCHMARKS_BENCHMARK_H
@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Command recording throughput: records commands into a CircularBuffer and executes them on the
+ * noop driver, flushing as CommandBufferQueue does, with a mirrored buffer (wraps without a copy)
+ * and with a soft-wrap buffer (twice as large, restarts at the beginning past the first half).
+ *
+ *     benchmark_circular_buffer [-n iterations]
+ */
+
+#include "Benchmark.h"
+
+#include "noop/NoopDriver.h"
+
+#include "private/backend/CircularBuffer.h"
+#include "private/backend/CommandStream.h"
+#include "private/backend/Driver.h"
+
+#include <backend/Handle.h>
+
+#include <iostream>
+#include <memory>
+#include <new>
+
+#include <stddef.h>
+
+using namespace filament;
+using namespace filament::backend;
+using namespace filament::benchmark;
+
+namespace {
+
+// sizes used by the engine with its default config
+constexpr size_t REQUIRED_SIZE = 1 * 1024 * 1024;
+constexpr size_t BUFFER_SIZE = 3 * REQUIRED_SIZE;
+
+// commands recorded between two flushes, a busy frame
+constexpr size_t COMMANDS_PER_FLUSH = 20'000;
+constexpr size_t FLUSH_COUNT = 200;
+
+void record(Driver& driver, CircularBuffer& buffer) {
+    CommandStream stream(driver, buffer);
+    // the stream asserts it is only recorded from the thread set here
+    stream.debugThreading();
+    for (size_t i = 0; i < FLUSH_COUNT; i++) {
+        for (size_t j = 0; j < COMMANDS_PER_FLUSH; j++) {
+            // a null handle is accepted by the driver and the command has no payload
+            stream.destroyBufferObject(BufferObjectHandle{});
+        }
+        // what CommandBufferQueue::flush() and the render thread do
+        new(buffer.allocate(sizeof(NoopCommand))) NoopCommand(nullptr);
+        auto const [tail, head] = buffer.getBuffer();
+        stream.execute(tail);
+    }
+}
+
+void run(char const* name, Driver& driver, bool const mirror, int const iterations) {
+    CircularBuffer buffer(BUFFER_SIZE, mirror);
+    if (buffer.isMirrored() != mirror) {
+        std::cout << name << ": not supported on this platform" << std::endl;
+        return;
+    }
+    double const seconds = measure(iterations, [&] { record(driver, buffer); });
+    report(name, seconds, FLUSH_COUNT * COMMANDS_PER_FLUSH);
+}
+
+} // anonymous namespace
+
+int main(int argc, char** argv) {
+    int iterations = 10;
+    if (!parseIterations(argc, argv, iterations)) {
+        return 1;
+    }
+
+    std::unique_ptr<Driver> const driver{ NoopDriver::create() };
+    run("record+execute, mirrored", *driver, true, iterations);
+    run("record+execute, soft wrap", *driver, false, iterations);
+    return 0;
+}
@@ -0,0 +1,140 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Queued closures: records closures into a CircularBuffer and executes them, stored in place
+ * (CommandStream::queueCommand()) and through a std::function (what queueCommand() used to do),
+ * with a small capture and with one too large for std::function's inline storage.
+ *
+ *     benchmark_custom_command [-n iterations]
+ */
+
+#include "Benchmark.h"
+
+#include "noop/NoopDriver.h"
+
+#include "private/backend/CircularBuffer.h"
+#include "private/backend/CommandStream.h"
+#include "private/backend/Driver.h"
+
+#include <array>
+#include <functional>
+#include <memory>
+#include <new>
+#include <utility>
+
+#include <stddef.h>
+#include <stdint.h>
+
+using namespace filament;
+using namespace filament::backend;
+using namespace filament::benchmark;
+
+namespace {
+
+constexpr size_t BUFFER_SIZE = 3 * 1024 * 1024;
+
+// closures recorded between two flushes
+constexpr size_t COMMANDS_PER_FLUSH = 10'000;
+constexpr size_t FLUSH_COUNT = 100;
+
+// The command queueCommand() recorded before closures were stored in place.
+class LegacyCustomCommand : public CommandBase {
+    std::function<void()> mCommand;
+    static void execute(Driver&, CommandBase* base, intptr_t* next) {
+        *next = align(sizeof(LegacyCustomCommand));
+        static_cast<LegacyCustomCommand*>(base)->mCommand();
+        static_cast<LegacyCustomCommand*>(base)->~LegacyCustomCommand();
+    }
+public:
+    inline explicit LegacyCustomCommand(std::function<void()> cmd)
+            : CommandBase(execute), mCommand(std::move(cmd)) { }
+};
+
+// what CommandBufferQueue::flush() and the render thread do
+void flush(CircularBuffer& buffer, CommandStream& stream) {
+    new(buffer.allocate(sizeof(NoopCommand))) NoopCommand(nullptr);
+    auto const [tail, head] = buffer.getBuffer();
+    stream.execute(tail);
+}
+
+template<typename MakeClosure>
+void recordInPlace(Driver& driver, CircularBuffer& buffer, MakeClosure&& makeClosure) {
+    CommandStream stream(driver, buffer);
+    stream.debugThreading();
+    for (size_t i = 0; i < FLUSH_COUNT; i++) {
+        for (size_t j = 0; j < COMMANDS_PER_FLUSH; j++) {
+            stream.queueCommand(makeClosure(j));
+        }
+        flush(buffer, stream);
+    }
+}
+
+template<typename MakeClosure>
+void recordLegacy(Driver& driver, CircularBuffer& buffer, MakeClosure&& makeClosure) {
+    CommandStream stream(driver, buffer);
+    stream.debugThreading();
+    for (size_t i = 0; i < FLUSH_COUNT; i++) {
+        for (size_t j = 0; j < COMMANDS_PER_FLUSH; j++) {
+            new(buffer.allocate(CommandBase::align(sizeof(LegacyCustomCommand))))
+                    LegacyCustomCommand(makeClosure(j));
+        }
+        flush(buffer, stream);
+    }
+}
+
+} // anonymous namespace
+
+int main(int argc, char** argv) {
+    int iterations = 10;
+    if (!parseIterations(argc, argv, iterations)) {
+        return 1;
+    }
+
+    std::unique_ptr<Driver> const driver{ NoopDriver::create() };
+    CircularBuffer buffer(BUFFER_SIZE);
+    constexpr size_t count = FLUSH_COUNT * COMMANDS_PER_FLUSH;
+
+    uint64_t sum = 0;
+
+    // a pointer and an index, like most closures queued by the engine
+    auto const makeSmall = [&sum](size_t const j) {
+        return [&sum, j]() { sum += j; };
+    };
+
+    // larger than std::function's inline storage, like a closure owning a few handles
+    auto const makeLarge = [&sum](size_t const j) {
+        std::array<uint64_t, 8> data{};
+        data[j % data.size()] = j;
+        return [&sum, data]() {
+            for (uint64_t const v : data) {
+                sum += v;
+            }
+        };
+    };
+
+    double seconds = measure(iterations, [&] { recordInPlace(*driver, buffer, makeSmall); });
+    report("small capture, in place", seconds, count);
+    seconds = measure(iterations, [&] { recordLegacy(*driver, buffer, makeSmall); });
+    report("small capture, std::function", seconds, count);
+    seconds = measure(iterations, [&] { recordInPlace(*driver, buffer, makeLarge); });
+    report("large capture, in place", seconds, count);
+    seconds = measure(iterations, [&] { recordLegacy(*driver, buffer, makeLarge); });
+    report("large capture, std::function", seconds, count);
+
+    doNotOptimize(sum);
+    return 0;
+}
@@ -0,0 +1,170 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Parallel recording: records chunks of commands on the JobSystem into SecondaryCommandStreams
+ * (what FEngine::getSecondaryDriverApi() and submitSecondaryDriverApis() do) and executes them
+ * on the noop driver, compared with recording all the chunks into the primary stream on one
+ * thread. Each chunk ends with a closure noting its index, the run fails if the chunks didn't
+ * execute in index order.
+ *
+ *     benchmark_secondary_streams [-n iterations]
+ */
+
+#include "Benchmark.h"
+
+#include "noop/NoopDriver.h"
+
+#include "private/backend/CircularBuffer.h"
+#include "private/backend/CommandStream.h"
+#include "private/backend/Driver.h"
+#include "private/backend/SecondaryCommandStreams.h"
+
+#include <backend/Handle.h>
+
+#include <utils/JobSystem.h>
+
+#include <array>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+
+using namespace filament;
+using namespace filament::backend;
+using namespace filament::benchmark;
+
+namespace {
+
+// sizes used by the engine with its default config
+constexpr size_t REQUIRED_SIZE = 1 * 1024 * 1024;
+constexpr size_t BUFFER_SIZE = 3 * REQUIRED_SIZE;
+
+// a frame is split in chunks, e.g. the renderables of one job
+constexpr size_t CHUNK_COUNT = 64;
+constexpr size_t COMMANDS_PER_CHUNK = 500;
+constexpr size_t FRAME_COUNT = 100;
+
+// what CommandBufferQueue::flush() and the render thread do
+void flush(CircularBuffer& buffer, CommandStream& stream) {
+    new(buffer.allocate(sizeof(NoopCommand))) NoopCommand(nullptr);
+    auto const [tail, head] = buffer.getBuffer();
+    stream.execute(tail);
+}
+
+void recordChunk(CommandStream& stream, size_t const chunk, std::vector<size_t>& executed) {
+    for (size_t i = 0; i < COMMANDS_PER_CHUNK; i++) {
+        // a null handle is accepted by the driver and the command has no payload
+        stream.destroyBufferObject(BufferObjectHandle{});
+    }
+    // executed on the render thread, one chunk after the other
+    stream.queueCommand([&executed, chunk]() { executed.push_back(chunk); });
+}
+
+// returns false if the chunks didn't execute in index order
+bool checkOrder(std::vector<size_t>& executed) {
+    bool ordered = executed.size() == CHUNK_COUNT;
+    for (size_t i = 0; ordered && i < CHUNK_COUNT; i++) {
+        ordered = executed[i] == i;
+    }
+    executed.clear();
+    return ordered;
+}
+
+bool recordSerial(Driver& driver, CircularBuffer& buffer) {
+    std::vector<size_t> executed;
+    executed.reserve(CHUNK_COUNT);
+    CommandStream stream(driver, buffer);
+    stream.debugThreading();
+    bool ordered = true;
+    for (size_t i = 0; i < FRAME_COUNT; i++) {
+        for (size_t chunk = 0; chunk < CHUNK_COUNT; chunk++) {
+            recordChunk(stream, chunk, executed);
+        }
+        flush(buffer, stream);
+        ordered = checkOrder(executed) && ordered;
+    }
+    return ordered;
+}
+
+bool recordParallel(Driver& driver, CircularBuffer& buffer, utils::JobSystem& js) {
+    std::vector<size_t> executed;
+    executed.reserve(CHUNK_COUNT);
+    CommandStream stream(driver, buffer);
+    stream.debugThreading();
+    SecondaryCommandStreams secondary(driver, REQUIRED_SIZE / 16, REQUIRED_SIZE / 4);
+    bool ordered = true;
+    for (size_t i = 0; i < FRAME_COUNT; i++) {
+        // acquired on this thread before the jobs start, like getSecondaryDriverApi()
+        std::array<CommandStream*, CHUNK_COUNT> streams;
+        for (size_t chunk = 0; chunk < CHUNK_COUNT; chunk++) {
+            streams[chunk] = &secondary.acquire(chunk);
+        }
+
+        auto* const job = utils::jobs::parallel_for(js, nullptr, 0, uint32_t(CHUNK_COUNT),
+                [&streams, &executed](uint32_t const start, uint32_t const count) {
+                    for (uint32_t chunk = start, e = start + count; chunk < e; chunk++) {
+                        CommandStream& s = *streams[chunk];
+                        s.debugThreading();
+                        recordChunk(s, chunk, executed);
+                    }
+                }, utils::jobs::CountSplitter<1, 8>());
+        js.runAndWait(job);
+
+        // the jobs finished in any order, the chunks are submitted in index order
+        secondary.submit(stream);
+        flush(buffer, stream);
+        ordered = checkOrder(executed) && ordered;
+    }
+    return ordered;
+}
+
+} // anonymous namespace
+
+int main(int argc, char** argv) {
+    int iterations = 10;
+    if (!parseIterations(argc, argv, iterations)) {
+        return 1;
+    }
+
+    std::unique_ptr<Driver> const driver{ NoopDriver::create() };
+    CircularBuffer buffer(BUFFER_SIZE);
+    utils::JobSystem js;
+    js.adopt();
+
+    constexpr size_t count = FRAME_COUNT * CHUNK_COUNT * COMMANDS_PER_CHUNK;
+    bool ordered = true;
+
+    double seconds = measure(iterations, [&] {
+        ordered = recordSerial(*driver, buffer) && ordered;
+    });
+    report("one thread, primary stream", seconds, count);
+    seconds = measure(iterations, [&] {
+        ordered = recordParallel(*driver, buffer, js) && ordered;
+    });
+    report("jobs, secondary streams", seconds, count);
+
+    js.emancipate();
+
+    if (!ordered) {
+        std::cerr << "the chunks didn't execute in submission order" << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,162 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Material instance churn: creates and destroys 100k instances, with a slab per material (what
+ * FEngine does) and with one heap allocation for the instance and one for its uniforms (what it
+ * used to do).
+ *
+ *     benchmark_slab_allocator [-n iterations]
+ */
+
+#include "Benchmark.h"
+
+#include "SlabAllocator.h"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace filament;
+using namespace filament::benchmark;
+
+namespace {
+
+constexpr size_t INSTANCE_COUNT = 100'000;
+
+// roughly an FMaterialInstance, followed by the uniforms of a typical lit material
+constexpr size_t INSTANCE_SIZE = 320;
+constexpr size_t UNIFORMS_SIZE = 256;
+
+// the instances are created in order, but destroyed in any order
+std::vector<uint32_t> makeDestroyOrder() {
+    std::vector<uint32_t> order(INSTANCE_COUNT);
+    for (uint32_t i = 0; i < INSTANCE_COUNT; i++) {
+        order[i] = i;
+    }
+    std::shuffle(order.begin(), order.end(), std::mt19937{ 42 });
+    return order;
+}
+
+struct HeapInstance {
+    void* instance;
+    void* uniforms;
+};
+
+void churnHeap(std::vector<uint32_t> const& order, std::vector<HeapInstance>& instances) {
+    for (auto& mi : instances) {
+        mi.instance = malloc(INSTANCE_SIZE);
+        mi.uniforms = malloc(UNIFORMS_SIZE);
+        memset(mi.instance, 0, INSTANCE_SIZE);
+        memset(mi.uniforms, 0, UNIFORMS_SIZE);
+    }
+    for (uint32_t const i : order) {
+        free(instances[i].uniforms);
+        free(instances[i].instance);
+    }
+}
+
+void churnSlab(std::vector<uint32_t> const& order, std::vector<void*>& instances) {
+    // one allocator per material, as in FMaterial
+    SlabAllocator allocator;
+    allocator.init(INSTANCE_SIZE + UNIFORMS_SIZE, 16);
+    for (auto& mi : instances) {
+        mi = allocator.alloc();
+        memset(mi, 0, INSTANCE_SIZE + UNIFORMS_SIZE);
+    }
+    for (uint32_t const i : order) {
+        allocator.free(instances[i]);
+    }
+}
+
+// walks all the instances' uniforms, as a batched commit does
+template<typename F>
+uint64_t sumUniforms(size_t const count, F&& getUniforms) {
+    uint64_t sum = 0;
+    for (size_t i = 0; i < count; i++) {
+        void const* const uniforms = getUniforms(i);
+        uint64_t const* const p = static_cast<uint64_t const*>(uniforms);
+        for (size_t j = 0; j < UNIFORMS_SIZE / sizeof(uint64_t); j++) {
+            sum += p[j];
+        }
+    }
+    return sum;
+}
+
+} // anonymous namespace
+
+int main(int argc, char** argv) {
+    int iterations = 10;
+    if (!parseIterations(argc, argv, iterations)) {
+        return 1;
+    }
+
+    std::vector<uint32_t> const order = makeDestroyOrder();
+
+    {
+        std::vector<HeapInstance> instances(INSTANCE_COUNT);
+        double const seconds = measure(iterations, [&] { churnHeap(order, instances); });
+        report("create+destroy, heap", seconds, INSTANCE_COUNT);
+    }
+    {
+        std::vector<void*> instances(INSTANCE_COUNT);
+        double const seconds = measure(iterations, [&] { churnSlab(order, instances); });
+        report("create+destroy, slab", seconds, INSTANCE_COUNT);
+    }
+
+    // iteration over live instances
+    {
+        std::vector<HeapInstance> instances(INSTANCE_COUNT);
+        for (auto& mi : instances) {
+            mi.instance = malloc(INSTANCE_SIZE);
+            mi.uniforms = calloc(1, UNIFORMS_SIZE);
+        }
+        double const seconds = measure(iterations, [&] {
+            doNotOptimize(sumUniforms(INSTANCE_COUNT, [&](size_t i) {
+                return instances[i].uniforms;
+            }));
+        });
+        report("walk uniforms, heap", seconds, INSTANCE_COUNT);
+        for (auto& mi : instances) {
+            free(mi.uniforms);
+            free(mi.instance);
+        }
+    }
+    {
+        SlabAllocator allocator;
+        allocator.init(INSTANCE_SIZE + UNIFORMS_SIZE, 16);
+        std::vector<void*> instances(INSTANCE_COUNT);
+        for (auto& mi : instances) {
+            mi = allocator.alloc();
+            memset(mi, 0, INSTANCE_SIZE + UNIFORMS_SIZE);
+        }
+        double const seconds = measure(iterations, [&] {
+            doNotOptimize(sumUniforms(INSTANCE_COUNT, [&](size_t i) {
+                return static_cast<char*>(instances[i]) + INSTANCE_SIZE;
+            }));
+        });
+        report("walk uniforms, slab", seconds, INSTANCE_COUNT);
+        for (void* mi : instances) {
+            allocator.free(mi);
+        }
+    }
+    return 0;
+}
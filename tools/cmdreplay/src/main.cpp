@@ -0,0 +1,115 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Replays a command trace recorded with FILAMENT_CAPTURE_COMMANDS=<file> into the no-op driver,
+ * and prints how long each command took.
+ *
+ *     cmdreplay [-n iterations] trace.bin
+ */
+
+#include "noop/NoopDriver.h"
+#include "trace/CommandTrace.h"
+#include "trace/TraceReplayer.h"
+
+#include "private/backend/Driver.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <vector>
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace filament::backend;
+
+static void printUsage(char const* name) {
+    std::cerr << "Usage: " << name << " [-n iterations] trace" << std::endl
+              << "Replays a command trace recorded with FILAMENT_CAPTURE_COMMANDS=<trace>" << std::endl
+              << "into the no-op driver and prints the duration of each command." << std::endl;
+}
+
+static void printStats(TraceReplayer::Stats const& stats) {
+    std::vector<size_t> commands;
+    for (size_t i = 0; i < stats.size(); i++) {
+        if (stats[i].count) {
+            commands.push_back(i);
+        }
+    }
+    std::sort(commands.begin(), commands.end(), [&stats](size_t lhs, size_t rhs) {
+        return stats[lhs].total > stats[rhs].total;
+    });
+
+    // durations in ns, except the total in us
+    std::cout << std::left << std::setw(32) << "command" << std::right
+              << std::setw(10) << "count" << std::setw(12) << "total(us)"
+              << std::setw(10) << "mean" << std::setw(10) << "min"
+              << std::setw(10) << "p50" << std::setw(10) << "p90"
+              << std::setw(10) << "p99" << std::setw(10) << "max" << std::endl;
+    for (size_t const i : commands) {
+        TraceReplayer::Histogram const& h = stats[i];
+        std::cout << std::left << std::setw(32) << getTraceCommandName(TraceCommand(i))
+                  << std::right
+                  << std::setw(10) << h.count << std::setw(12) << h.total / 1000
+                  << std::setw(10) << h.total / h.count << std::setw(10) << h.min
+                  << std::setw(10) << h.percentile(0.5) << std::setw(10) << h.percentile(0.9)
+                  << std::setw(10) << h.percentile(0.99) << std::setw(10) << h.max << std::endl;
+    }
+}
+
+int main(int argc, char** argv) {
+    int iterations = 1;
+    char const* path = nullptr;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-n") && i + 1 < argc) {
+            iterations = std::max(1, atoi(argv[++i]));
+        } else if (!path && argv[i][0] != '-') {
+            path = argv[i];
+        } else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+    if (!path) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    // the whole trace is loaded first, so that reading it isn't measured
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        std::cerr << "couldn't open " << path << std::endl;
+        return 1;
+    }
+    std::vector<char> const trace{ std::istreambuf_iterator<char>(in),
+            std::istreambuf_iterator<char>() };
+
+    std::unique_ptr<Driver> const driver(NoopDriver::create());
+    TraceReplayer replayer(*driver);
+    auto stats = std::make_unique<TraceReplayer::Stats>();
+    for (int i = 0; i < iterations; i++) {
+        replayer.replay(trace.data(), trace.size(), *stats);
+        driver->purge();
+    }
+
+    printStats(*stats);
+    return 0;
+}